@@ -0,0 +1,100 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <fstream>
+
+BenchResult &BenchSuite::record(const std::string &name, std::vector<std::pair<std::string, std::string>> params, uint64_t ops, double seconds)
+{
+    BenchResult r;
+    r.name = name;
+    r.params = std::move(params);
+    r.ops = ops;
+    r.nsPerOp = ops ? seconds * 1e9 / (double)ops : 0.0;
+    r.opsPerSec = seconds > 0.0 ? (double)ops / seconds : 0.0;
+    results.push_back(r);
+
+    std::string p;
+    for (const auto &kv : results.back().params)
+        p += kv.first + "=" + kv.second + " ";
+    std::printf("%-28s %-44s %14.1f ns/op %12.3f Mop/s\n", name.c_str(), p.c_str(), r.nsPerOp, r.opsPerSec * 1e-6);
+    std::fflush(stdout);
+    return results.back();
+}
+
+void BenchSuite::printSummary() const
+{
+    std::printf("%zu measurements\n", results.size());
+}
+
+static std::string jsonEscape(const std::string &s)
+{
+    std::string out;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+bool BenchSuite::writeJson(const std::string &path) const
+{
+    std::ofstream f(path);
+    if (!f)
+        return false;
+    f << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &r = results[i];
+        f << "    {\"name\": \"" << jsonEscape(r.name) << "\", \"params\": {";
+        for (size_t k = 0; k < r.params.size(); k++)
+            f << (k ? ", " : "") << "\"" << jsonEscape(r.params[k].first) << "\": \"" << jsonEscape(r.params[k].second) << "\"";
+        f << "}, \"ops\": " << r.ops << ", \"ns_per_op\": " << r.nsPerOp << ", \"ops_per_sec\": " << r.opsPerSec << "}";
+        f << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    f << "  ]\n}\n";
+    return (bool)f;
+}
+
+std::vector<std::string> randomGrid(int size, double wallChance, std::mt19937 &rng)
+{
+    std::bernoulli_distribution wall(wallChance);
+    std::vector<std::string> grid(size, std::string(size, '.'));
+    for (int r = 0; r < size; r++)
+        for (int c = 0; c < size; c++)
+            if (r == 0 || c == 0 || r == size - 1 || c == size - 1 || wall(rng))
+                grid[r][c] = '#';
+    return grid;
+}
+
+std::vector<std::string> tiledGameGrid(int tiles)
+{
+    static const std::vector<std::string> kTile = {
+        "#################",
+        "#.######........#",
+        "#.######.###.####",
+        "#.##.....#......#",
+        "#.######.#......#",
+        "#.###....#......#",
+        "#.######.########",
+        "#...............#",
+        "#.######.######.#",
+        "#.######.######.#",
+        "#.######.######.#",
+        "#.######.######.#",
+        "#.######.######.#",
+        "#...............#",
+        "#################",
+    };
+    std::vector<std::string> grid;
+    for (int ty = 0; ty < tiles; ty++)
+        for (const auto &row : kTile)
+        {
+            std::string line;
+            for (int tx = 0; tx < tiles; tx++)
+                line += row;
+            grid.push_back(line);
+        }
+    return grid;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal benchmark harness shared by the SimpleFPS_bench suites.
+inline double secondsSince(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+struct BenchResult
+{
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> params;
+    uint64_t ops = 0;
+    double nsPerOp = 0.0;
+    double opsPerSec = 0.0;
+};
+
+class BenchSuite
+{
+public:
+    double minSeconds = 0.2;
+    bool quick = false;
+    // set by a suite when a correctness check fails; main exits non-zero
+    int failures = 0;
+
+    // Runs op(i) for i = 0, 1, 2, ... until at least minSeconds have passed.
+    // op returns a value that is folded into a sink so the work is not elided.
+    template <typename Op>
+    BenchResult &run(const std::string &name, std::vector<std::pair<std::string, std::string>> params, Op op)
+    {
+        uint64_t done = 0;
+        uint64_t chunk = 1;
+        double sink = 0.0;
+        auto t0 = std::chrono::steady_clock::now();
+        double elapsed = 0.0;
+        while (elapsed < minSeconds)
+        {
+            for (uint64_t i = 0; i < chunk; i++)
+                sink += (double)op(done + i);
+            done += chunk;
+            chunk *= 2;
+            elapsed = secondsSince(t0);
+        }
+        sinkValue += sink;
+        return record(name, std::move(params), done, elapsed);
+    }
+
+    // Runs pass(p) for p = 0, 1, 2, ... until at least minSeconds have passed
+    // and at least two passes are done, records opsPerPass ops per pass and
+    // returns the seconds per pass. For work too large to time one op at a time.
+    template <typename Pass>
+    double runPasses(const std::string &name, std::vector<std::pair<std::string, std::string>> params, uint64_t opsPerPass, Pass pass)
+    {
+        uint64_t passes = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        double elapsed = 0.0;
+        while (elapsed < minSeconds || passes < 2)
+        {
+            pass(passes);
+            passes++;
+            elapsed = secondsSince(t0);
+        }
+        record(name, std::move(params), passes * opsPerPass, elapsed);
+        return elapsed / (double)passes;
+    }
+
+    // Records an externally timed measurement.
+    BenchResult &record(const std::string &name, std::vector<std::pair<std::string, std::string>> params, uint64_t ops, double seconds);
+
+    void printSummary() const;
+    bool writeJson(const std::string &path) const;
+
+private:
+    std::vector<BenchResult> results;
+    volatile double sinkValue = 0.0;
+};
+
+// Test maps: random noise with a solid border, and the game's 17x15 layout tiled.
+std::vector<std::string> randomGrid(int size, double wallChance, std::mt19937 &rng);
+std::vector<std::string> tiledGameGrid(int tiles);
+
+template <typename T>
+std::string benchParam(const T &v)
+{
+    return std::to_string(v);
+}
+
+inline std::string benchParam(double v)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%g", v);
+    return buf;
+}
+
+void runCollisionBench(BenchSuite &suite);
+void runTargetsBench(BenchSuite &suite);
+void runJobsBench(BenchSuite &suite);
+void runFrustumBench(BenchSuite &suite);
+void runPvsBench(BenchSuite &suite);
+void runBvhBench(BenchSuite &suite);
+void runMapBench(BenchSuite &suite);
+void runMazeGenBench(BenchSuite &suite);
+void runChunkStreamBench(BenchSuite &suite);
+void runBitGridBench(BenchSuite &suite);
+void runPathfindBench(BenchSuite &suite);
+void runFlowFieldBench(BenchSuite &suite);
+void runRegionsBench(BenchSuite &suite);
@@ -0,0 +1,59 @@
+// SimpleFPS_bench: microbenchmarks for the hot gameplay kernels.
+//
+//   SimpleFPS_bench [--quick] [--json results.json] [--min-time seconds]
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    BenchSuite suite;
+    std::string jsonPath;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--quick") == 0)
+        {
+            suite.quick = true;
+            suite.minSeconds = 0.05;
+        }
+        else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            suite.minSeconds = std::atof(argv[++i]);
+        else
+        {
+            std::printf("usage: %s [--quick] [--json file] [--min-time seconds]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    runCollisionBench(suite);
+    runTargetsBench(suite);
+    runJobsBench(suite);
+    runFrustumBench(suite);
+    runPvsBench(suite);
+    runBvhBench(suite);
+    runMapBench(suite);
+    runMazeGenBench(suite);
+    runChunkStreamBench(suite);
+    runBitGridBench(suite);
+    runPathfindBench(suite);
+    runFlowFieldBench(suite);
+    runRegionsBench(suite);
+
+    suite.printSummary();
+    if (!jsonPath.empty() && !suite.writeJson(jsonPath))
+    {
+        std::printf("cannot write %s\n", jsonPath.c_str());
+        return 1;
+    }
+    if (suite.failures)
+    {
+        std::printf("FAILED: %d correctness checks\n", suite.failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Bit-packed occupancy: memory per cell against the byte grid and vec3 empty
+// list it replaced, then whole-grid scans (popcount counting, exposed-face
+// masks) and 3x3 area probes in the row-major and Morton layouts, each next
+// to the same work on a byte-per-cell grid. Every variant is cross-checked.
+#include "bench.h"
+
+#include "bit_grid.h"
+#include "maze.h"
+#include "maze_gen.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    static std::vector<unsigned char> byteGrid(const BitGrid &g)
+    {
+        std::vector<unsigned char> bytes((size_t)g.width() * (size_t)g.height());
+        for (int r = 0; r < g.height(); r++)
+            for (int c = 0; c < g.width(); c++)
+                bytes[(size_t)r * g.width() + c] = g.get(c, r) ? 1 : 0;
+        return bytes;
+    }
+
+    // wall faces next to an open cell or the grid edge, one side at a time
+    static size_t exposedFacesBits(const BitGrid &g)
+    {
+        std::vector<uint64_t> mask(g.wordsPerRow());
+        size_t faces = 0;
+        for (int r = 0; r < g.height(); r++)
+        {
+            const uint64_t *row = g.rowWords(r);
+            for (GridSide side : {GridSide::PosX, GridSide::NegX, GridSide::PosZ, GridSide::NegZ})
+            {
+                neighbourMask(g, r, side, mask.data());
+                for (size_t i = 0; i < mask.size(); i++)
+                    faces += (size_t)popcount64(row[i] & ~mask[i]);
+            }
+        }
+        return faces;
+    }
+
+    static size_t exposedFacesBytes(const std::vector<unsigned char> &b, int w, int h)
+    {
+        auto at = [&](int c, int r)
+        { return c >= 0 && r >= 0 && c < w && r < h && b[(size_t)r * w + c]; };
+        size_t faces = 0;
+        for (int r = 0; r < h; r++)
+            for (int c = 0; c < w; c++)
+                if (b[(size_t)r * w + c])
+                    faces += (size_t)(!at(c + 1, r) + !at(c - 1, r) + !at(c, r + 1) + !at(c, r - 1));
+        return faces;
+    }
+
+    static int verifyMasks(const BitGrid &g, std::mt19937 &rng)
+    {
+        std::vector<uint64_t> mask(g.wordsPerRow());
+        const int dc[4] = {1, -1, 0, 0}, dr[4] = {0, 0, 1, -1};
+        std::uniform_int_distribution<int> row(0, g.height() - 1);
+        int bad = 0;
+        for (int k = 0; k < 64 && !bad; k++)
+        {
+            int r = k < 2 ? (k == 0 ? 0 : g.height() - 1) : row(rng);
+            for (int s = 0; s < 4; s++)
+            {
+                neighbourMask(g, r, (GridSide)s, mask.data());
+                // the padding past the last column stays clear
+                for (int c = 0; c < (int)(mask.size() * 64); c++)
+                {
+                    bool expected = c < g.width() && g.contains(c + dc[s], r + dr[s]) && g.get(c + dc[s], r + dr[s]);
+                    if (((mask[(size_t)c >> 6] >> (c & 63)) & 1u) != (uint64_t)expected)
+                    {
+                        std::printf("MISMATCH: neighbour mask side %d row %d col %d\n", s, r, c);
+                        bad++;
+                        break;
+                    }
+                }
+            }
+        }
+        // word ranges, as chunks bake them, against the whole row
+        std::vector<uint64_t> part(mask.size());
+        std::uniform_int_distribution<size_t> word(0, mask.size() - 1);
+        for (int k = 0; k < 256 && !bad; k++)
+        {
+            size_t a = word(rng), b = word(rng);
+            if (k < 2)
+                a = k == 0 ? 0 : mask.size() - 1;
+            const size_t w0 = std::min(a, b), w1 = std::max(a, b) + 1;
+            const int r = row(rng), s = k % 4;
+            neighbourMask(g, r, (GridSide)s, mask.data());
+            neighbourMask(g, r, (GridSide)s, part.data(), w0, w1);
+            if (!std::equal(part.begin(), part.begin() + (long)(w1 - w0), mask.begin() + (long)w0))
+            {
+                std::printf("MISMATCH: neighbour mask side %d row %d words [%zu, %zu)\n", s, r, w0, w1);
+                bad++;
+            }
+        }
+        return bad;
+    }
+} // namespace
+
+void runBitGridBench(BenchSuite &suite)
+{
+    std::vector<int> sizes = {1025, 4097};
+    if (!suite.quick)
+        sizes.push_back(8193);
+
+    std::mt19937 rng(99);
+    // keeps the passes' results alive
+    volatile size_t sink = 0;
+    for (int size : sizes)
+    {
+        MazeGenParams params;
+        params.algorithm = MazeAlgorithm::Rooms;
+        params.width = params.height = size;
+        Maze maze = buildMazeFromGrid(generateMaze(params), 1.0f, 1.75f);
+        const BitGrid &g = maze.solid;
+        const MortonBitGrid morton(g);
+        const std::vector<unsigned char> bytes = byteGrid(g);
+        const size_t cells = (size_t)size * size;
+        auto p = [&](const char *layout)
+        { return std::vector<std::pair<std::string, std::string>>{{"size", benchParam(size)}, {"layout", layout}}; };
+        // whole-grid passes, recorded per cell so sizes and layouts compare directly
+        auto perCell = [&](const char *name, const char *layout, auto pass)
+        {
+            suite.runPasses(name, p(layout), cells, [&](uint64_t)
+                            { sink = sink + pass(); });
+        };
+
+        // what one cell used to cost (a byte of occupancy, a vec3 per open
+        // cell) against a bit and an int16 pair per open cell
+        const double before = (double)cells + (double)maze.emptyCells.size() * sizeof(glm::vec3);
+        const double after = (double)g.bytes() + (double)maze.emptyCells.size() * sizeof(CellCoord);
+        std::printf("bitgrid %5dx%-5d occupancy %.1f -> %.1f MB (%.0fx, Morton %.1f MB); with empty cells %.1f -> %.1f MB (%.1fx)\n", size,
+                    size, (double)cells / (1 << 20), (double)g.bytes() / (1 << 20), (double)cells / (double)g.bytes(),
+                    (double)morton.bytes() / (1 << 20), before / (1 << 20), after / (1 << 20), before / after);
+
+        // counting: popcount over words against a byte sum
+        if (g.count() != maze.wallCellCount || morton.count() != maze.wallCellCount)
+        {
+            std::printf("MISMATCH: bitgrid %d counts %zu / %zu walls, maze has %zu\n", size, g.count(), morton.count(), (size_t)maze.wallCellCount);
+            suite.failures++;
+        }
+        perCell("count", "bits", [&]
+                { return g.count(); });
+        perCell("count", "bytes", [&]
+                {
+                    size_t n = 0;
+                    for (unsigned char b : bytes)
+                        n += b;
+                    return n; });
+
+        // exposed wall faces, the wall mesh's inner test
+        suite.failures += verifyMasks(g, rng);
+        size_t facesBits = exposedFacesBits(g), facesBytes = exposedFacesBytes(bytes, size, size);
+        if (facesBits != facesBytes)
+        {
+            std::printf("MISMATCH: bitgrid %d finds %zu exposed faces, byte grid %zu\n", size, facesBits, facesBytes);
+            suite.failures++;
+        }
+        perCell("exposedFaces", "bits", [&]
+                { return exposedFacesBits(g); });
+        perCell("exposedFaces", "bytes", [&]
+                { return exposedFacesBytes(bytes, size, size); });
+
+        // 3x3 probes around random cells, like a collision query
+        std::vector<std::pair<int, int>> probes(1 << 16);
+        std::uniform_int_distribution<int> cell(0, size - 1);
+        for (auto &q : probes)
+            q = {cell(rng), cell(rng)};
+        for (size_t i = 0; i < 256; i++)
+        {
+            auto [c, r] = probes[i];
+            if (g.countRect(c - 1, r - 1, c + 2, r + 2) != morton.countRect(c - 1, r - 1, c + 2, r + 2))
+            {
+                std::printf("MISMATCH: bitgrid %d 3x3 count at %d,%d differs between layouts\n", size, c, r);
+                suite.failures++;
+                break;
+            }
+        }
+        const size_t mask = probes.size() - 1;
+        suite.run("probe3x3", p("rowmajor"), [&](uint64_t i)
+                  {
+                      auto [c, r] = probes[i & mask];
+                      return g.countRect(c - 1, r - 1, c + 2, r + 2); });
+        suite.run("probe3x3", p("morton"), [&](uint64_t i)
+                  {
+                      auto [c, r] = probes[i & mask];
+                      return morton.countRect(c - 1, r - 1, c + 2, r + 2); });
+        suite.run("probe3x3", p("bytes"), [&](uint64_t i)
+                  {
+                      auto [c, r] = probes[i & mask];
+                      size_t n = 0;
+                      for (int y = std::max(r - 1, 0); y < std::min(r + 2, size); y++)
+                          for (int x = std::max(c - 1, 0); x < std::min(c + 2, size); x++)
+                              n += bytes[(size_t)y * size + x];
+                      return n; });
+    }
+}
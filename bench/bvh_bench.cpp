@@ -0,0 +1,160 @@
+// BVH over wall boxes: build cost, and closest-hit / any-hit / circle-overlap
+// queries against the linear scans (and the occupancy grid where it applies),
+// on grid mazes with and without merged walls and on scattered non-grid boxes.
+// Every query is cross-checked against the linear result.
+#include "bench.h"
+
+#include "bvh.h"
+#include "collision.h"
+#include "maze.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    static constexpr float kPlayerRadius = 0.22f;
+
+    struct Query
+    {
+        glm::vec3 origin;
+        glm::vec3 dir;
+        float maxT;
+    };
+
+    static glm::vec3 randomDir(std::mt19937 &rng)
+    {
+        std::normal_distribution<float> n(0.0f, 1.0f);
+        glm::vec3 d;
+        do
+            d = {n(rng), 0.1f * n(rng), n(rng)};
+        while (glm::length(d) < 1e-3f);
+        return glm::normalize(d);
+    }
+
+    static std::vector<Query> makeQueries(const Maze &maze, float half, size_t count, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> coord(-half, half);
+        std::uniform_real_distribution<float> jitter(-0.45f, 0.45f);
+        std::uniform_real_distribution<float> length(0.5f, 20.0f);
+        std::vector<Query> q(count);
+        for (auto &e : q)
+        {
+            if (!maze.emptyCells.empty())
+            {
+                std::uniform_int_distribution<size_t> cell(0, maze.emptyCells.size() - 1);
+                e.origin = cellCenter(maze, maze.emptyCells[cell(rng)]) + glm::vec3(jitter(rng), 1.0f, jitter(rng)) * maze.cellSize;
+            }
+            else
+                e.origin = {coord(rng), 1.0f, coord(rng)};
+            e.dir = randomDir(rng);
+            e.maxT = length(rng);
+        }
+        return q;
+    }
+
+    // non-grid geometry: overlapping boxes of random size and position
+    static Maze scatteredBoxes(size_t count, std::mt19937 &rng)
+    {
+        float half = std::sqrt((float)count) * 2.0f;
+        std::uniform_real_distribution<float> coord(-half, half);
+        std::uniform_real_distribution<float> size(0.1f, 3.0f);
+        std::vector<AABB> boxes(count);
+        for (auto &b : boxes)
+        {
+            glm::vec3 c(coord(rng), 0.875f, coord(rng));
+            glm::vec3 e(size(rng), 1.75f, size(rng));
+            b = {c - e * 0.5f, c + e * 0.5f};
+        }
+        Maze m;
+        m.walls = std::move(boxes);
+        return m;
+    }
+
+    static void benchGeometry(BenchSuite &suite, const std::string &name, const Maze &maze, bool grid, std::mt19937 &rng)
+    {
+        const std::vector<std::pair<std::string, std::string>> params = {{"map", name}, {"boxes", benchParam(maze.walls.size())}};
+
+        // build: repeated until minSeconds, reported per box
+        Bvh bvh;
+        suite.runPasses("buildBvh", params, maze.walls.size(), [&](uint64_t)
+                        { bvh = buildBvh(maze.walls); });
+
+        float half = 0.0f;
+        for (const auto &w : maze.walls)
+            half = std::max({half, std::fabs(w.min.x), std::fabs(w.max.x), std::fabs(w.min.z), std::fabs(w.max.z)});
+
+        // equivalence with the linear scans
+        size_t checks = std::min<size_t>(5000, std::max<size_t>(100, 50000000 / (maze.walls.size() + 1)));
+        int bad = 0;
+        for (const auto &q : makeQueries(maze, half, checks, rng))
+        {
+            float linear = nearestWallTLinear(maze, q.origin, q.dir);
+            int index = -1;
+            float t = bvhClosestHit(bvh, q.origin, q.dir, &index);
+            if (t != linear)
+                bad++;
+            float ti = 0.0f;
+            if (index >= 0 && !(rayAABB(q.origin, q.dir, maze.walls[(size_t)index], ti) && ti == t))
+                bad++;
+            if (bvhAnyHit(bvh, q.origin, q.dir, q.maxT) != (linear < q.maxT))
+                bad++;
+            if (bvhOverlapsCircleXZ(bvh, q.origin, kPlayerRadius) != isBlockedLinear(maze, q.origin, kPlayerRadius))
+                bad++;
+        }
+        if (bad)
+            std::printf("MISMATCH: %d BVH/linear disagreements (%s)\n", bad, name.c_str());
+        suite.failures += bad;
+
+        const size_t n = 1024;
+        std::vector<Query> queries = makeQueries(maze, half, n, rng);
+        suite.run("bvhClosestHit", params, [&](uint64_t i)
+                  {
+                      const Query &q = queries[i % n];
+                      float t = bvhClosestHit(bvh, q.origin, q.dir);
+                      return t < 1e30f ? t : 0.0f; });
+        suite.run("bvhAnyHit", params, [&](uint64_t i)
+                  {
+                      const Query &q = queries[i % n];
+                      return bvhAnyHit(bvh, q.origin, q.dir, q.maxT) ? 1 : 0; });
+        suite.run("bvhOverlapsCircleXZ", params, [&](uint64_t i)
+                  { return bvhOverlapsCircleXZ(bvh, queries[i % n].origin, kPlayerRadius) ? 1 : 0; });
+        if (grid)
+        {
+            suite.run("nearestWallT", params, [&](uint64_t i)
+                      {
+                          const Query &q = queries[i % n];
+                          float t = nearestWallT(maze, q.origin, q.dir);
+                          return t < 1e30f ? t : 0.0f; });
+            suite.run("isBlocked", params, [&](uint64_t i)
+                      { return isBlocked(maze, queries[i % n].origin, kPlayerRadius) ? 1 : 0; });
+        }
+        suite.run("nearestWallTLinear", params, [&](uint64_t i)
+                  {
+                      const Query &q = queries[i % n];
+                      float t = nearestWallTLinear(maze, q.origin, q.dir);
+                      return t < 1e30f ? t : 0.0f; });
+        suite.run("isBlockedLinear", params, [&](uint64_t i)
+                  { return isBlockedLinear(maze, queries[i % n].origin, kPlayerRadius) ? 1 : 0; });
+
+        std::printf("BVH %-18s %8zu boxes -> %8zu nodes (%zu KiB)\n", name.c_str(), maze.walls.size(), bvh.nodes.size(),
+                    bvh.nodes.size() * sizeof(BvhNode) / 1024);
+    }
+} // namespace
+
+void runBvhBench(BenchSuite &suite)
+{
+    std::mt19937 rng(31337);
+    std::vector<int> sizes = {17, 64, 256, 1024};
+    if (suite.quick)
+        sizes = {17, 64, 256};
+    for (int size : sizes)
+    {
+        std::vector<std::string> grid = randomGrid(size, 0.35, rng);
+        benchGeometry(suite, "random " + benchParam(size), buildMazeFromGrid(grid, 1.0f, 1.75f), true, rng);
+        benchGeometry(suite, "random " + benchParam(size) + " merged", buildMazeFromGrid(grid, 1.0f, 1.75f, true), true, rng);
+    }
+    for (size_t count : {1000, 100000})
+        benchGeometry(suite, "scattered", scatteredBoxes(count, rng), false, rng);
+}
@@ -0,0 +1,257 @@
+// Chunk streaming: cost of building one chunk (mesh + merged walls) from the
+// maze and of loading it from a map file's chunk sections, and of the
+// per-frame ChunkStreamer::update() along a camera walk across generated
+// mazes. Checks that the chunks together give the same geometry as the whole
+// map, that loaded chunks match built ones, that collision through the
+// resident chunks matches the whole grid, that the resident count never
+// exceeds the budget, and that every chunk around the camera is resident once
+// the loader catches up.
+#include "bench.h"
+
+#include "chunk_stream.h"
+#include "collision.h"
+#include "map_file.h"
+#include "maze_gen.h"
+#include "wall_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+    static Maze generatedMaze(int size)
+    {
+        MazeGenParams params;
+        params.width = params.height = size;
+        params.seed = 77;
+        return buildMazeFromGrid(generateMaze(params), 1.0f, 1.75f, false);
+    }
+
+    // every chunk baked and merged on its own must add up to the whole map
+    static int checkChunksCoverMap(const Maze &maze, int chunkCells)
+    {
+        const int chunksX = (maze.gridWidth + chunkCells - 1) / chunkCells;
+        const int chunksY = (maze.gridHeight + chunkCells - 1) / chunkCells;
+        size_t indices = 0, ranges = 0;
+        double area = 0.0;
+        for (uint32_t id = 0; id < (uint32_t)(chunksX * chunksY); id++)
+        {
+            ChunkData c = buildChunk(maze, chunkCells, id);
+            indices += c.mesh.indices.size();
+            ranges += c.mesh.ranges.size();
+            for (const AABB &b : c.walls)
+                area += (double)(b.max.x - b.min.x) * (double)(b.max.z - b.min.z);
+        }
+        WallMeshData whole = bakeWallMesh(maze);
+        const size_t cells = (size_t)std::llround(area / ((double)maze.cellSize * maze.cellSize));
+
+        int bad = 0;
+        if (indices != whole.indices.size() || ranges != whole.ranges.size())
+        {
+            std::printf("MISMATCH: chunks hold %zu indices in %zu cells, the whole mesh %zu in %zu\n", indices, ranges, whole.indices.size(),
+                        whole.ranges.size());
+            bad++;
+        }
+        if (cells != maze.wallCellCount)
+        {
+            std::printf("MISMATCH: chunk walls cover %zu cells, the maze has %zu wall cells\n", cells, (size_t)maze.wallCellCount);
+            bad++;
+        }
+        return bad;
+    }
+
+    template <typename T>
+    static bool sameBytes(const std::vector<T> &a, const std::vector<T> &b)
+    {
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    // every chunk read back from the map file's chunk sections must equal the
+    // one built from the maze, occupancy border included
+    static int checkLoadedChunks(const MapFile &map, const Maze &maze, int chunkCells)
+    {
+        const uint32_t chunks = (uint32_t)(map.chunksX() * map.chunksY());
+        int bad = 0;
+        for (uint32_t id = 0; id < chunks; id++)
+        {
+            ChunkData built = buildChunk(maze, chunkCells, id);
+            ChunkData loaded = loadChunk(map, maze, id);
+            const MappedArray<uint64_t> &a = built.grid->solid.words(), &b = loaded.grid->solid.words();
+            bad += !sameBytes(built.mesh.vertices, loaded.mesh.vertices) || !sameBytes(built.mesh.indices, loaded.mesh.indices) ||
+                   !sameBytes(built.mesh.ranges, loaded.mesh.ranges) || !sameBytes(built.walls, loaded.walls) ||
+                   built.grid->col0 != loaded.grid->col0 || built.grid->row0 != loaded.grid->row0 || a.size() != b.size() ||
+                   !std::equal(a.begin(), a.end(), b.begin());
+        }
+        if (bad)
+            std::printf("MISMATCH: %d of %u chunks loaded from the map file differ from the built ones\n", bad, chunks);
+        return bad;
+    }
+
+    // Collision through a resident set holding every chunk must match the
+    // whole grid; with only the centre chunk resident, the rest is solid.
+    static int checkChunkCollision(const Maze &maze, int chunkCells, std::mt19937 &rng)
+    {
+        ChunkGridSet all, one;
+        all.chunkCells = one.chunkCells = chunkCells;
+        all.chunksX = one.chunksX = (maze.gridWidth + chunkCells - 1) / chunkCells;
+        const int chunksY = (maze.gridHeight + chunkCells - 1) / chunkCells;
+        for (uint32_t id = 0; id < (uint32_t)(all.chunksX * chunksY); id++)
+            all.grids[id] = buildChunk(maze, chunkCells, id).grid;
+        const uint32_t centre = (uint32_t)(chunksY / 2 * all.chunksX + all.chunksX / 2);
+        one.grids[centre] = all.grids[centre];
+        auto wallAll = [&](int c, int r)
+        { return all.wallAt(c, r); };
+        auto wallOne = [&](int c, int r)
+        { return one.wallAt(c, r); };
+
+        std::uniform_real_distribution<float> x(-0.5f * (float)maze.gridWidth * maze.cellSize, 0.5f * (float)maze.gridWidth * maze.cellSize);
+        std::uniform_real_distribution<float> z(-0.5f * (float)maze.gridHeight * maze.cellSize, 0.5f * (float)maze.gridHeight * maze.cellSize);
+        std::normal_distribution<float> n(0.0f, 1.0f);
+        int bad = 0;
+        for (int i = 0; i < 20000; i++)
+        {
+            const glm::vec3 p{x(rng), 0.9f, z(rng)};
+            const glm::vec3 d = glm::normalize(glm::vec3(n(rng), 0.0f, n(rng)) + glm::vec3(1e-3f, 0.0f, 0.0f));
+            bad += isBlocked(maze, p, 0.3f) != isBlocked(maze, p, 0.3f, wallAll);
+            bad += nearestWallT(maze, p, d) != nearestWallT(maze, p, d, wallAll);
+            // never further than the whole grid allows, and a wall wherever a chunk is missing
+            int col, row;
+            worldToCell(maze, p.x, p.z, col, row);
+            const bool resident = one.grids.count((uint32_t)((row / chunkCells) * one.chunksX + col / chunkCells)) != 0;
+            bad += nearestWallT(maze, p, d, wallOne) > nearestWallT(maze, p, d);
+            bad += !resident && maze.solid.contains(col, row) && !isBlocked(maze, p, 0.3f, wallOne);
+        }
+        if (bad)
+            std::printf("MISMATCH: %d collision queries through resident chunks differ from the whole grid\n", bad);
+        return bad;
+    }
+
+    // Walks the camera diagonally across the maze, one update per step, the
+    // way the render thread calls it once per frame.
+    static void walk(BenchSuite &suite, const Maze &maze, int size, int steps, std::shared_ptr<const MapFile> map = nullptr)
+    {
+        ChunkStreamParams params;
+        const char *source = map ? "map" : "maze";
+        ChunkStreamer streamer(maze, params, std::move(map));
+        std::vector<std::unique_ptr<ChunkData>> loaded;
+        std::vector<uint32_t> evicted;
+        std::unordered_map<uint32_t, size_t> residentBytes;
+        size_t bytes = 0, peakBytes = 0, peakResident = 0, loads = 0;
+        double seconds = 0.0, worst = 0.0;
+
+        auto step = [&](const glm::vec3 &eye)
+        {
+            loaded.clear();
+            evicted.clear();
+            auto t0 = std::chrono::steady_clock::now();
+            streamer.update(eye, loaded, evicted);
+            double s = secondsSince(t0);
+            seconds += s;
+            worst = std::max(worst, s);
+            for (const auto &c : loaded)
+            {
+                residentBytes[c->id] = c->bytes();
+                bytes += c->bytes();
+            }
+            for (uint32_t id : evicted)
+            {
+                bytes -= residentBytes[id];
+                residentBytes.erase(id);
+            }
+            loads += loaded.size();
+            peakBytes = std::max(peakBytes, bytes);
+            peakResident = std::max(peakResident, streamer.residentCount());
+        };
+
+        glm::vec3 eye{0.0f};
+        for (int i = 0; i < steps; i++)
+        {
+            float t = (float)i / (float)(steps - 1);
+            int cell = 1 + (int)(t * (float)(size - 3));
+            eye = cellCenter(maze, {(int16_t)cell, (int16_t)cell});
+            step(eye);
+            // about one frame of loader time between updates
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        suite.record("ChunkStreamer::update", {{"size", benchParam(size)}, {"chunk", benchParam(params.chunkCells)}, {"source", source}},
+                     (uint64_t)steps, seconds);
+
+        // standing still, the loader must catch up with the camera's chunks
+        auto t0 = std::chrono::steady_clock::now();
+        while (streamer.pendingCount() > 0 && secondsSince(t0) < 10.0)
+        {
+            step(eye);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        int col, row;
+        worldToCell(maze, eye.x, eye.z, col, row);
+        const int cx = col / params.chunkCells, cy = row / params.chunkCells;
+        const std::shared_ptr<const ChunkGridSet> grids = streamer.residentGrids();
+        size_t missing = 0;
+        for (int y = std::max(0, cy - params.radius); y <= std::min(streamer.chunksY() - 1, cy + params.radius); y++)
+            for (int x = std::max(0, cx - params.radius); x <= std::min(streamer.chunksX() - 1, cx + params.radius); x++)
+            {
+                const uint32_t id = (uint32_t)(y * streamer.chunksX() + x);
+                missing += !streamer.isResident(id) || !grids->grids.count(id);
+            }
+        if (missing > 0)
+        {
+            std::printf("MISMATCH: chunks %d (%s): %zu chunks around the camera never became resident\n", size, source, missing);
+            suite.failures++;
+        }
+        if (peakResident > params.budget)
+        {
+            std::printf("MISMATCH: chunks %d: %zu chunks resident, budget %zu\n", size, peakResident, params.budget);
+            suite.failures++;
+        }
+
+        const size_t chunkCount = (size_t)streamer.chunksX() * (size_t)streamer.chunksY();
+        const double perChunk = residentBytes.empty() ? 0.0 : (double)bytes / (double)residentBytes.size();
+        std::printf("chunks %5dx%-5d %-4s %zu chunks: update avg %.2f us, max %.2f us; %zu loads, peak %zu resident, %.1f MB (whole map ~%.1f "
+                    "MB)\n",
+                    size, size, source, chunkCount, seconds / steps * 1e6, worst * 1e6, loads, peakResident, (double)peakBytes / (1 << 20),
+                    perChunk * (double)chunkCount / (1 << 20));
+    }
+} // namespace
+
+void runChunkStreamBench(BenchSuite &suite)
+{
+    const int chunkCells = ChunkStreamParams{}.chunkCells;
+    Maze small = generatedMaze(1025);
+    suite.failures += checkChunksCoverMap(small, chunkCells);
+
+    const uint32_t chunks = (uint32_t)(((small.gridWidth + chunkCells - 1) / chunkCells) * ((small.gridHeight + chunkCells - 1) / chunkCells));
+    suite.run("buildChunk", {{"chunk", benchParam(chunkCells)}}, [&](uint64_t i)
+              { return buildChunk(small, chunkCells, (uint32_t)(i % chunks)).mesh.indices.size(); });
+
+    std::mt19937 rng(91);
+    suite.failures += checkChunkCollision(small, chunkCells, rng);
+
+    const char *mapPath = "chunk_stream_bench.fmap";
+    auto map = std::make_shared<MapFile>();
+    if (!writeMapFile(mapPath, small, false, nullptr, nullptr, chunkCells) || !map->open(mapPath) || !map->hasChunks())
+    {
+        std::printf("MISMATCH: chunk sections were not written or not read back\n");
+        suite.failures++;
+        map.reset();
+    }
+    if (map)
+    {
+        suite.failures += checkLoadedChunks(*map, small, chunkCells);
+        suite.run("loadChunk", {{"chunk", benchParam(chunkCells)}}, [&](uint64_t i)
+                  { return loadChunk(*map, small, (uint32_t)(i % chunks)).mesh.indices.size(); });
+    }
+
+    walk(suite, small, 1025, suite.quick ? 500 : 2000);
+    if (map)
+        walk(suite, small, 1025, suite.quick ? 500 : 2000, map);
+    map.reset();
+    std::remove(mapPath);
+    Maze large = generatedMaze(4097);
+    walk(suite, large, 4097, suite.quick ? 1000 : 4000);
+}
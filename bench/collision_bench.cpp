@@ -0,0 +1,256 @@
+// Collision and ray-query kernels: primitive tests at controlled hit ratios,
+// and the maze queries (grid vs. linear scan) across wall counts and ray
+// distributions, plus randomized checks that both paths agree.
+#include "bench.h"
+
+#include "collision.h"
+#include "maze.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    static constexpr float kPlayerRadius = 0.22f;
+
+    struct Ray
+    {
+        glm::vec3 origin;
+        glm::vec3 dir;
+    };
+
+    static glm::vec3 randomUnit(std::mt19937 &rng)
+    {
+        std::normal_distribution<float> n(0.0f, 1.0f);
+        glm::vec3 d;
+        do
+            d = {n(rng), n(rng), n(rng)};
+        while (glm::length(d) < 1e-3f);
+        return glm::normalize(d);
+    }
+
+    // Draws candidates until the requested fraction of them hit according to hits().
+    template <typename T, typename Gen, typename Hits>
+    static std::vector<T> withHitRatio(size_t count, double ratio, std::mt19937 &rng, Gen gen, Hits hits)
+    {
+        std::vector<T> out;
+        size_t wantHits = (size_t)(ratio * (double)count + 0.5);
+        size_t haveHits = 0;
+        while (out.size() < count)
+        {
+            T v = gen(rng);
+            bool h = hits(v);
+            if (h && haveHits < wantHits)
+            {
+                out.push_back(v);
+                haveHits++;
+            }
+            else if (!h && out.size() - haveHits < count - wantHits)
+                out.push_back(v);
+        }
+        std::shuffle(out.begin(), out.end(), rng);
+        return out;
+    }
+
+    // uniform: directions over the whole sphere; horizontal: eye-level rays
+    // like hitscan; axis: rays along the grid axes (DDA worst/best cases)
+    static glm::vec3 rayDirection(const std::string &dist, std::mt19937 &rng)
+    {
+        if (dist == "horizontal")
+        {
+            glm::vec3 d = randomUnit(rng);
+            d.y *= 0.05f;
+            return glm::normalize(d);
+        }
+        if (dist == "axis")
+        {
+            static const glm::vec3 kAxes[] = {{1, 0, 0}, {-1, 0, 0}, {0, 0, 1}, {0, 0, -1}};
+            return kAxes[rng() % 4];
+        }
+        return randomUnit(rng);
+    }
+
+    static std::vector<Ray> mazeRays(const Maze &maze, size_t count, const std::string &dist, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> height(0.1f, 1.7f);
+        std::uniform_int_distribution<size_t> cell(0, maze.emptyCells.size() - 1);
+        const float half = std::max(maze.gridWidth, maze.gridHeight) * maze.cellSize * 0.5f;
+
+        std::vector<Ray> rays(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            Ray &r = rays[i];
+            // a few origins outside the grid exercise the entry clipping
+            if (i % 10 == 0)
+                r.origin = {unit(rng) * half * 1.5f, height(rng), unit(rng) * half * 1.5f};
+            else
+                r.origin = cellCenter(maze, maze.emptyCells[cell(rng)]) + glm::vec3(unit(rng) * 0.45f, height(rng), unit(rng) * 0.45f) * maze.cellSize;
+            r.dir = rayDirection(dist, rng);
+        }
+        return rays;
+    }
+
+    static std::vector<glm::vec3> mazePoints(const Maze &maze, size_t count, std::mt19937 &rng)
+    {
+        const float half = std::max(maze.gridWidth, maze.gridHeight) * maze.cellSize * 0.5f;
+        std::uniform_real_distribution<float> coord(-half, half);
+        std::vector<glm::vec3> points(count);
+        for (auto &p : points)
+            p = {coord(rng), 1.0f, coord(rng)};
+        return points;
+    }
+
+    static void benchPrimitives(BenchSuite &suite, std::mt19937 &rng)
+    {
+        const AABB box{{-0.5f, 0.0f, -0.5f}, {0.5f, 1.75f, 0.5f}};
+        const glm::vec3 sphereCenter(0.0f, 0.5f, 0.0f);
+        const float sphereRadius = 0.45f;
+        const size_t n = 4096;
+
+        auto rayGen = [](std::mt19937 &g)
+        {
+            Ray r;
+            r.origin = randomUnit(g) * 6.0f;
+            // aim near the primitive so both outcomes are common
+            glm::vec3 aim = randomUnit(g) * 1.2f;
+            r.dir = glm::normalize(aim - r.origin);
+            return r;
+        };
+
+        for (double ratio : {0.0, 0.5, 1.0})
+        {
+            auto params = std::vector<std::pair<std::string, std::string>>{{"hit_ratio", benchParam(ratio)}};
+
+            auto boxRays = withHitRatio<Ray>(n, ratio, rng, rayGen, [&](const Ray &r)
+                                             { float t; return rayAABB(r.origin, r.dir, box, t); });
+            suite.run("rayAABB", params, [&](uint64_t i)
+                      {
+                          const Ray &r = boxRays[i % n];
+                          float t = 0.0f;
+                          return rayAABB(r.origin, r.dir, box, t) ? t : 0.0f; });
+
+            auto sphereRays = withHitRatio<Ray>(n, ratio, rng, rayGen, [&](const Ray &r)
+                                                { float t; return raySphere(r.origin, r.dir, sphereCenter, sphereRadius, t); });
+            suite.run("raySphere", params, [&](uint64_t i)
+                      {
+                          const Ray &r = sphereRays[i % n];
+                          float t = 0.0f;
+                          return raySphere(r.origin, r.dir, sphereCenter, sphereRadius, t) ? t : 0.0f; });
+
+            auto points = withHitRatio<glm::vec3>(
+                n, ratio, rng, [](std::mt19937 &g)
+                { std::uniform_real_distribution<float> c(-1.0f, 1.0f); return glm::vec3(c(g), 1.0f, c(g)); },
+                [&](const glm::vec3 &p)
+                { return circleIntersectsAABB_XZ(p, kPlayerRadius, box); });
+            suite.run("circleIntersectsAABB_XZ", params, [&](uint64_t i)
+                      { return circleIntersectsAABB_XZ(points[i % n], kPlayerRadius, box) ? 1 : 0; });
+        }
+    }
+
+    static void benchMazeQueries(BenchSuite &suite, const Maze &maze, std::mt19937 &rng)
+    {
+        const std::string walls = benchParam(maze.walls.size());
+        const size_t n = 1024;
+
+        std::vector<glm::vec3> points = mazePoints(maze, n, rng);
+        size_t blocked = 0;
+        for (const auto &p : points)
+            blocked += isBlocked(maze, p, kPlayerRadius) ? 1 : 0;
+        auto params = std::vector<std::pair<std::string, std::string>>{{"walls", walls}, {"hit_ratio", benchParam((double)blocked / n)}};
+        suite.run("isBlocked", params, [&](uint64_t i)
+                  { return isBlocked(maze, points[i % n], kPlayerRadius) ? 1 : 0; });
+        suite.run("isBlockedLinear", params, [&](uint64_t i)
+                  { return isBlockedLinear(maze, points[i % n], kPlayerRadius) ? 1 : 0; });
+
+        for (const char *dist : {"uniform", "horizontal", "axis"})
+        {
+            std::vector<Ray> rays = mazeRays(maze, n, dist, rng);
+            size_t hits = 0;
+            for (const auto &r : rays)
+                hits += nearestWallT(maze, r.origin, r.dir) < 1e30f ? 1 : 0;
+            auto rayParams = std::vector<std::pair<std::string, std::string>>{
+                {"walls", walls}, {"rays", dist}, {"hit_ratio", benchParam((double)hits / n)}};
+            suite.run("nearestWallT", rayParams, [&](uint64_t i)
+                      {
+                          const Ray &r = rays[i % n];
+                          float t = nearestWallT(maze, r.origin, r.dir);
+                          return t < 1e30f ? t : 0.0f; });
+            suite.run("nearestWallTLinear", rayParams, [&](uint64_t i)
+                      {
+                          const Ray &r = rays[i % n];
+                          float t = nearestWallTLinear(maze, r.origin, r.dir);
+                          return t < 1e30f ? t : 0.0f; });
+        }
+    }
+
+    // randomized equivalence: grid paths must agree exactly with the linear scans
+    static void verifyMazeQueries(BenchSuite &suite, const Maze &maze, std::mt19937 &rng)
+    {
+        size_t count = std::min<size_t>(20000, std::max<size_t>(200, 100000000 / (maze.walls.size() + 1)));
+        int bad = 0;
+        for (const auto &p : mazePoints(maze, count, rng))
+            if (isBlocked(maze, p, kPlayerRadius) != isBlockedLinear(maze, p, kPlayerRadius))
+                bad++;
+        for (const char *dist : {"uniform", "horizontal", "axis"})
+            for (const auto &r : mazeRays(maze, count / 3, dist, rng))
+            {
+                float a = nearestWallT(maze, r.origin, r.dir);
+                float b = nearestWallTLinear(maze, r.origin, r.dir);
+                if (a != b)
+                {
+                    if (bad < 10)
+                        std::printf("ray mismatch: origin (%g %g %g) dir (%g %g %g): dda %g linear %g\n",
+                                    r.origin.x, r.origin.y, r.origin.z, r.dir.x, r.dir.y, r.dir.z, a, b);
+                    bad++;
+                }
+            }
+        if (bad)
+            std::printf("MISMATCH: %d grid/linear disagreements on %zu walls\n", bad, maze.walls.size());
+        suite.failures += bad;
+    }
+
+    static void reportMerge(BenchSuite &suite, const char *name, const std::vector<std::string> &grid, std::mt19937 &rng)
+    {
+        Maze cells = buildMazeFromGrid(grid, 1.0f, 1.75f);
+        Maze merged = buildMazeFromGrid(grid, 1.0f, 1.75f, true);
+
+        // merged boxes must cover exactly the same area
+        int bad = 0;
+        for (const auto &p : mazePoints(cells, 2000, rng))
+            if (isBlockedLinear(cells, p, kPlayerRadius) != isBlockedLinear(merged, p, kPlayerRadius))
+                bad++;
+        for (const auto &r : mazeRays(cells, 500, "uniform", rng))
+            if (nearestWallTLinear(cells, r.origin, r.dir) != nearestWallTLinear(merged, r.origin, r.dir))
+                bad++;
+        if (bad)
+            std::printf("MISMATCH: merged walls differ from cell walls in %d queries (%s)\n", bad, name);
+        suite.failures += bad;
+
+        std::printf("wall merging %-12s %10zu -> %8zu boxes (%.1fx fewer)\n", name, cells.walls.size(), merged.walls.size(),
+                    (double)cells.walls.size() / std::max<size_t>(1, merged.walls.size()));
+    }
+} // namespace
+
+void runCollisionBench(BenchSuite &suite)
+{
+    std::mt19937 rng(1234);
+
+    benchPrimitives(suite, rng);
+
+    std::vector<int> sizes = {17, 64, 256, 1024, 2048};
+    if (suite.quick)
+        sizes = {17, 64, 256};
+    for (int size : sizes)
+    {
+        Maze maze = buildMazeFromGrid(randomGrid(size, 0.35, rng), 1.0f, 1.75f);
+        verifyMazeQueries(suite, maze, rng);
+        benchMazeQueries(suite, maze, rng);
+    }
+
+    reportMerge(suite, "game 17x15", tiledGameGrid(1), rng);
+    reportMerge(suite, "game x8", tiledGameGrid(8), rng);
+    if (!suite.quick)
+        reportMerge(suite, "game x32", tiledGameGrid(32), rng);
+    reportMerge(suite, "random 256", randomGrid(256, 0.35, rng), rng);
+}
@@ -0,0 +1,234 @@
+// Flow fields toward a moving goal on room mazes up to 8193^2: the cost of a
+// whole-grid field, of a field bounded to a radius around the goal (and the
+// size of its window), and of the worst single update when the wavefront is
+// spread over ticks; then the per-agent direction lookup. Fields are checked
+// cell by cell against a plain BFS, including fields whose goal moved while
+// they were being built.
+#include "bench.h"
+
+#include "flow_field.h"
+#include "jobs.h"
+#include "maze_gen.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    // only the occupancy grid; wall boxes would dominate memory at 8193^2
+    static Maze generatedGrid(int size, JobSystem &jobs)
+    {
+        MazeGenParams params;
+        params.algorithm = MazeAlgorithm::Rooms;
+        params.width = params.height = size;
+        params.seed = 53;
+        Maze maze;
+        maze.solid = gridFromText(generateMaze(params, &jobs));
+        maze.gridWidth = maze.solid.width();
+        maze.gridHeight = maze.solid.height();
+        return maze;
+    }
+
+    static CellCoord randomOpenCell(const Maze &maze, std::mt19937 &rng)
+    {
+        std::uniform_int_distribution<int> col(0, maze.gridWidth - 1), row(0, maze.gridHeight - 1);
+        for (;;)
+        {
+            CellCoord c{(int16_t)col(rng), (int16_t)row(rng)};
+            if (!maze.solid.get(c.col, c.row))
+                return c;
+        }
+    }
+
+    // the goal wandering from cell to neighbouring cell, like the player
+    static std::vector<CellCoord> goalWalk(const Maze &maze, size_t steps, std::mt19937 &rng)
+    {
+        const int dc[4] = {1, -1, 0, 0}, dr[4] = {0, 0, 1, -1};
+        std::vector<CellCoord> walk{randomOpenCell(maze, rng)};
+        while (walk.size() < steps)
+        {
+            CellCoord c = walk.back();
+            int k = (int)(rng() % 4u);
+            CellCoord n{(int16_t)(c.col + dc[k]), (int16_t)(c.row + dr[k])};
+            if (maze.solid.contains(n.col, n.row) && !maze.solid.get(n.col, n.row))
+                walk.push_back(n);
+        }
+        return walk;
+    }
+
+    static std::vector<uint32_t> bfs(const Maze &maze, CellCoord goal)
+    {
+        const int w = maze.gridWidth;
+        std::vector<uint32_t> dist((size_t)w * (size_t)maze.gridHeight, FlowField::kUnreached);
+        std::vector<CellCoord> queue{goal};
+        dist[(size_t)goal.row * w + goal.col] = 0;
+        const int dc[4] = {1, -1, 0, 0}, dr[4] = {0, 0, 1, -1};
+        for (size_t head = 0; head < queue.size(); head++)
+        {
+            CellCoord c = queue[head];
+            for (int k = 0; k < 4; k++)
+            {
+                CellCoord n{(int16_t)(c.col + dc[k]), (int16_t)(c.row + dr[k])};
+                if (!maze.solid.contains(n.col, n.row) || maze.solid.get(n.col, n.row))
+                    continue;
+                uint32_t &d = dist[(size_t)n.row * w + n.col];
+                if (d == FlowField::kUnreached)
+                {
+                    d = dist[(size_t)c.row * w + c.col] + 1;
+                    queue.push_back(n);
+                }
+            }
+        }
+        return dist;
+    }
+
+    // the field against a BFS from its goal, and every step one cell closer
+    static int checkField(const FlowField &field, const Maze &maze, const char *what)
+    {
+        const std::vector<uint32_t> ref = bfs(maze, field.goal());
+        const uint32_t limit = field.params().maxDistance;
+        for (int r = 0; r < maze.gridHeight; r++)
+            for (int c = 0; c < maze.gridWidth; c++)
+            {
+                uint32_t expected = ref[(size_t)r * maze.gridWidth + c];
+                if (limit && expected != FlowField::kUnreached && expected > limit)
+                    expected = FlowField::kUnreached;
+                const uint32_t d = field.distance(c, r);
+                CellCoord next;
+                const bool stepped = field.step(c, r, next);
+                bool ok = d == expected && stepped == (d != FlowField::kUnreached && d > 0);
+                if (ok && stepped)
+                    ok = std::abs(next.col - c) + std::abs(next.row - r) == 1 && field.distance(next.col, next.row) == d - 1;
+                if (!ok)
+                {
+                    std::printf("MISMATCH: flow field (%s) at %d,%d: distance %u, BFS %u\n", what, c, r, d, expected);
+                    return 1;
+                }
+            }
+        return 0;
+    }
+
+    static int verify(const Maze &maze, std::mt19937 &rng)
+    {
+        int bad = 0;
+        const std::vector<CellCoord> walk = goalWalk(maze, 40, rng);
+
+        FlowField whole(maze);
+        FlowField bounded(maze, {64, 0});
+        // a window smaller than the grid on one axis only
+        FlowField narrow(maze, {(uint32_t)maze.gridWidth / 2, 0});
+        // small slices, with the goal moving before most fields are done
+        FlowField sliced(maze, {0, 5000});
+        for (size_t i = 0; i < walk.size() && bad == 0; i++)
+        {
+            for (FlowField *f : {&whole, &bounded, &narrow, &sliced})
+            {
+                f->setGoal(walk[i]);
+                f->update();
+            }
+            if (i % 8 == 7)
+            {
+                while (!sliced.update())
+                {
+                }
+                bad += checkField(whole, maze, "whole");
+                bad += checkField(bounded, maze, "bounded");
+                bad += checkField(narrow, maze, "narrow");
+                bad += checkField(sliced, maze, "sliced");
+            }
+        }
+        // a far jump, and a goal in a pocket the rest cannot reach
+        whole.setGoal(randomOpenCell(maze, rng));
+        whole.update();
+        bad += checkField(whole, maze, "jump");
+        return bad;
+    }
+
+    static void bench(BenchSuite &suite, JobSystem &jobs, int size, std::mt19937 &rng)
+    {
+        const Maze maze = generatedGrid(size, jobs);
+        const size_t cells = (size_t)size * size;
+        const std::vector<CellCoord> walk = goalWalk(maze, 4096, rng);
+        auto p = [&](const char *field)
+        { return std::vector<std::pair<std::string, std::string>>{{"size", benchParam(size)}, {"field", field}}; };
+
+        // one field per goal step, each finished before the next step
+        auto timeFields = [&](const char *name, FlowField &f)
+        {
+            size_t i = 0, reached = 0;
+            double worst = 0.0;
+            auto t0 = std::chrono::steady_clock::now();
+            double elapsed = 0.0;
+            while (elapsed < suite.minSeconds || i < 2)
+            {
+                auto u0 = std::chrono::steady_clock::now();
+                f.setGoal(walk[i++ % walk.size()]);
+                while (!f.update())
+                {
+                }
+                worst = std::max(worst, secondsSince(u0));
+                reached += f.reachedCells();
+                elapsed = secondsSince(t0);
+            }
+            suite.record("FlowField::update", p(name), i, elapsed);
+            std::printf("flow %5dx%-5d %-8s %.2f ms per field (max %.2f), %.0f cells reached, %.1f ns per cell\n", size, size, name,
+                        elapsed / i * 1e3, worst * 1e3, (double)reached / i, elapsed / (double)reached * 1e9);
+        };
+
+        FlowField whole(maze);
+        std::printf("flow %5dx%-5d field %.0f MB (%.0f bytes per cell)\n", size, size, (double)whole.bytes() / (1 << 20),
+                    (double)whole.bytes() / (double)cells);
+        timeFields("whole", whole);
+        FlowField bounded(maze, {128, 0});
+        std::printf("flow %5dx%-5d r128 field %.2f MB\n", size, size, (double)bounded.bytes() / (1 << 20));
+        timeFields("r128", bounded);
+
+        // whole fields spread over ticks: the worst single update is what a
+        // tick pays, the updates per field how far behind the goal it runs
+        FlowField sliced(maze, {0, 1 << 16});
+        size_t updates = 0, fields = 0;
+        double worst = 0.0, total = 0.0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; secondsSince(t0) < suite.minSeconds || fields < 2; i++)
+        {
+            auto u0 = std::chrono::steady_clock::now();
+            sliced.setGoal(walk[fields % walk.size()]);
+            fields += sliced.update();
+            const double s = secondsSince(u0);
+            worst = std::max(worst, s);
+            total += s;
+            updates++;
+        }
+        suite.record("FlowField::update", p("sliced64k"), updates, total);
+        std::printf("flow %5dx%-5d sliced   %zu updates per field, avg %.2f ms, max %.2f ms per update\n", size, size, updates / fields,
+                    total / updates * 1e3, worst * 1e3);
+
+        // agents steering: one lookup each, scattered over the field
+        std::vector<CellCoord> agents(1 << 16);
+        for (auto &a : agents)
+            a = randomOpenCell(maze, rng);
+        const size_t mask = agents.size() - 1;
+        suite.run("FlowField::step", p("whole"), [&](uint64_t i)
+                  {
+                      const CellCoord a = agents[i & mask];
+                      CellCoord next;
+                      return whole.step(a.col, a.row, next) ? next.col : 0; });
+    }
+} // namespace
+
+void runFlowFieldBench(BenchSuite &suite)
+{
+    JobSystem jobs;
+    std::mt19937 rng(321);
+
+    suite.failures += verify(generatedGrid(257, jobs), rng);
+    // the game's layout, tiled: isolated pockets stay out of the field
+    suite.failures += verify(buildMazeFromGrid(tiledGameGrid(3), 1.0f, 1.75f), rng);
+
+    std::vector<int> sizes = {1025, 2049, 4097};
+    if (!suite.quick)
+        sizes.push_back(8193);
+    for (int size : sizes)
+        bench(suite, jobs, size, rng);
+}
@@ -0,0 +1,104 @@
+// Frustum culling: plane extraction checked against clip space, the batch box
+// test (SIMD vs. scalar, identical lists required) over maze walls of
+// increasing size seen from random eye-level cameras.
+#include "bench.h"
+
+#include "frustum.h"
+#include "maze.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    static glm::mat4 randomCamera(const Maze &maze, std::mt19937 &rng)
+    {
+        std::uniform_int_distribution<size_t> cell(0, maze.emptyCells.size() - 1);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        std::uniform_real_distribution<float> pitch(-0.4f, 0.4f);
+        glm::vec3 eye = cellCenter(maze, maze.emptyCells[cell(rng)]) + glm::vec3(0.0f, 1.6f, 0.0f);
+        float yaw = angle(rng), p = pitch(rng);
+        glm::vec3 front(std::cos(yaw) * std::cos(p), std::sin(p), std::sin(yaw) * std::cos(p));
+        glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        return proj * glm::lookAt(eye, eye + front, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    // points well inside or well outside the clip volume must agree with the planes
+    static int verifyPlanes(const Maze &maze, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> coord(-60.0f, 60.0f);
+        int bad = 0;
+        for (int c = 0; c < 100; c++)
+        {
+            glm::mat4 vp = randomCamera(maze, rng);
+            Frustum f = frustumFromMatrix(vp);
+            for (int k = 0; k < 200; k++)
+            {
+                glm::vec3 p(coord(rng), coord(rng) * 0.1f, coord(rng));
+                glm::vec4 clip = vp * glm::vec4(p, 1.0f);
+                float margin = std::min({clip.w - std::fabs(clip.x), clip.w - std::fabs(clip.y), clip.w - std::fabs(clip.z)});
+                if (std::fabs(margin) < 1e-2f)
+                    continue;
+                bool inside = true;
+                for (const auto &pl : f.planes)
+                    inside = inside && pl.x * p.x + pl.y * p.y + pl.z * p.z + pl.w >= 0.0f;
+                if (inside != (margin > 0.0f))
+                    bad++;
+            }
+        }
+        return bad;
+    }
+
+    static void benchCulling(BenchSuite &suite, int size, std::mt19937 &rng)
+    {
+        Maze maze = buildMazeFromGrid(randomGrid(size, 0.35, rng), 1.0f, 1.75f);
+        BoxArray boxes;
+        for (const auto &w : maze.walls)
+            boxes.add(w);
+
+        const size_t n = 64;
+        std::vector<Frustum> frusta(n);
+        for (auto &f : frusta)
+            f = frustumFromMatrix(randomCamera(maze, rng));
+
+        int bad = verifyPlanes(maze, rng);
+        std::vector<uint32_t> a, b;
+        size_t visible = 0;
+        for (const auto &f : frusta)
+        {
+            cullBoxes(f, boxes, a);
+            cullBoxesScalar(f, boxes, b);
+            if (a != b)
+                bad++;
+            visible += a.size();
+        }
+        if (bad)
+            std::printf("MISMATCH: %d frustum culling checks failed on %zu boxes\n", bad, boxes.size());
+        suite.failures += bad;
+
+        auto params = std::vector<std::pair<std::string, std::string>>{
+            {"boxes", benchParam(boxes.size())}, {"visible", benchParam((double)visible / (double)(n * boxes.size()))}};
+        // per-box cost, so sizes compare directly
+        auto perBox = [&](const char *name, size_t (*cull)(const Frustum &, const BoxArray &, std::vector<uint32_t> &))
+        {
+            std::vector<uint32_t> out;
+            suite.runPasses(name, params, boxes.size(), [&](uint64_t pass)
+                            { cull(frusta[pass % n], boxes, out); });
+        };
+        perBox("cullBoxesScalar", cullBoxesScalar);
+        perBox("cullBoxes", cullBoxes);
+    }
+} // namespace
+
+void runFrustumBench(BenchSuite &suite)
+{
+    std::mt19937 rng(99);
+    std::vector<int> sizes = {17, 64, 256, 1024};
+    if (suite.quick)
+        sizes = {17, 64, 256};
+    for (int size : sizes)
+        benchCulling(suite, size, rng);
+}
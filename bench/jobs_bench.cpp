@@ -0,0 +1,162 @@
+// Job system: correctness of dependencies and parallelFor coverage, and how a
+// parallelFor over real per-frame work scales with the number of threads.
+#include "bench.h"
+
+#include "collision.h"
+#include "jobs.h"
+#include "maze.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    static void verifyJobs(BenchSuite &suite)
+    {
+        JobSystem jobs(3);
+        int bad = 0;
+
+        // diamond: a -> (b, c) -> d
+        for (int round = 0; round < 200; round++)
+        {
+            std::atomic<int> step{0};
+            int a = -1, b = -1, c = -1, d = -1;
+            JobHandle ha = jobs.submit([&]
+                                       { a = step++; });
+            JobHandle hb = jobs.submit([&]
+                                       { b = step++; }, {ha});
+            JobHandle hc = jobs.submit([&]
+                                       { c = step++; }, {ha});
+            JobHandle hd = jobs.submit([&]
+                                       { d = step++; }, {hb, hc});
+            jobs.wait(hd);
+            if (!(a == 0 && b > a && c > a && d == 3))
+                bad++;
+        }
+
+        // every index exactly once, for ragged sizes and grains
+        for (size_t count : {1, 7, 1000, 65537})
+            for (size_t grain : {1, 64, 5000})
+            {
+                std::vector<std::atomic<int>> seen(count);
+                for (auto &v : seen)
+                    v = 0;
+                jobs.parallelFor(count, grain, [&](size_t begin, size_t end)
+                                 {
+                                     for (size_t i = begin; i < end; i++)
+                                         seen[i]++; });
+                for (auto &v : seen)
+                    if (v != 1)
+                        bad++;
+            }
+
+        // nested parallelFor from inside jobs must not deadlock
+        std::atomic<size_t> total{0};
+        jobs.parallelFor(16, 1, [&](size_t, size_t)
+                         { jobs.parallelFor(1000, 10, [&](size_t begin, size_t end)
+                                            { total += end - begin; }); });
+        if (total != 16000)
+            bad++;
+
+        // with the only worker busy, a wait from outside the pool runs the
+        // awaited chain but leaves an unrelated job queued before it alone
+        {
+            JobSystem one(1);
+            std::atomic<bool> started{false}, release{false};
+            JobHandle gate = one.submit([&]
+                                        {
+                                            started = true;
+                                            while (!release)
+                                                std::this_thread::yield(); });
+            while (!started)
+                std::this_thread::yield();
+            bool other = false, first = false, second = false;
+            JobHandle ho = one.submit([&]
+                                      { other = true; });
+            JobHandle h1 = one.submit([&]
+                                      { first = true; });
+            JobHandle h2 = one.submit([&]
+                                      { second = first; }, {h1});
+            one.wait(h2);
+            if (!second || other)
+                bad++;
+            release = true;
+            one.wait(ho);
+            one.wait(gate);
+        }
+
+        if (bad)
+            std::printf("MISMATCH: %d job system checks failed\n", bad);
+        suite.failures += bad;
+    }
+
+    // Times whole passes of work(begin, end) over count items; reports per-item cost.
+    template <typename Work>
+    static double timePasses(BenchSuite &suite, JobSystem &jobs, const std::string &name, size_t count, size_t grain, Work work)
+    {
+        auto params = std::vector<std::pair<std::string, std::string>>{
+            {"threads", benchParam(jobs.workerCount() + 1)}, {"items", benchParam(count)}, {"grain", benchParam(grain)}};
+        return suite.runPasses(name, std::move(params), count, [&](uint64_t)
+                               { jobs.parallelFor(count, grain, work); });
+    }
+
+    static void benchScaling(BenchSuite &suite, std::mt19937 &rng)
+    {
+        Maze maze = buildMazeFromGrid(randomGrid(suite.quick ? 128 : 512, 0.35, rng), 1.0f, 1.75f);
+        std::uniform_int_distribution<size_t> cell(0, maze.emptyCells.size() - 1);
+        std::normal_distribution<float> n(0.0f, 1.0f);
+
+        const size_t rayCount = suite.quick ? 16384 : 65536;
+        std::vector<glm::vec3> origins(rayCount), dirs(rayCount);
+        for (size_t i = 0; i < rayCount; i++)
+        {
+            origins[i] = cellCenter(maze, maze.emptyCells[cell(rng)]) + glm::vec3(0.0f, 1.0f, 0.0f);
+            dirs[i] = glm::normalize(glm::vec3(n(rng), 0.05f * n(rng), n(rng)) + glm::vec3(1e-3f));
+        }
+        std::vector<float> rayT(rayCount);
+
+        const size_t targetCount = 1 << 16;
+        std::vector<glm::vec3> prev(targetCount), cur(targetCount);
+        for (size_t i = 0; i < targetCount; i++)
+        {
+            prev[i] = {n(rng), 0.5f, n(rng)};
+            cur[i] = prev[i] + glm::vec3(0.01f);
+        }
+        std::vector<glm::mat4> models(targetCount);
+
+        unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned> threadCounts;
+        for (unsigned t = 1; t < hw; t *= 2)
+            threadCounts.push_back(t);
+        threadCounts.push_back(hw);
+
+        double rayBase = 0.0, instBase = 0.0;
+        for (unsigned t : threadCounts)
+        {
+            JobSystem jobs(t - 1);
+            double ray = timePasses(suite, jobs, "parallelFor nearestWallT", rayCount, 256, [&](size_t begin, size_t end)
+                                    {
+                                        for (size_t i = begin; i < end; i++)
+                                            rayT[i] = nearestWallT(maze, origins[i], dirs[i]); });
+            double inst = timePasses(suite, jobs, "parallelFor target instances", targetCount, 1024, [&](size_t begin, size_t end)
+                                     {
+                                         for (size_t i = begin; i < end; i++)
+                                             models[i] = glm::translate(glm::mat4(1.0f), glm::mix(prev[i], cur[i], 0.5f)); });
+            if (t == 1)
+            {
+                rayBase = ray;
+                instBase = inst;
+            }
+            std::printf("job scaling %2u threads: rays %.2fx, target instances %.2fx\n", t, rayBase / ray, instBase / inst);
+        }
+    }
+} // namespace
+
+void runJobsBench(BenchSuite &suite)
+{
+    std::mt19937 rng(777);
+    verifyJobs(suite);
+    benchScaling(suite, rng);
+}
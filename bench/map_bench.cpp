@@ -0,0 +1,237 @@
+// Map startup: text grid -> buildMazeFromGrid -> buildBvh -> buildPathGraph
+// against mapping the binary map and using its arrays in place. The mapped
+// maze, BVH and path graph are compared byte for byte with the built ones, and queried once to show what
+// the first touch of the mapped pages costs. Damaged files, one broken index
+// per section, must be refused at open.
+#include "bench.h"
+
+#include "bvh.h"
+#include "map_file.h"
+#include "maze.h"
+#include "pathfind.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    template <typename T>
+    static bool sameBytes(const MappedArray<T> &a, const MappedArray<T> &b)
+    {
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    static bool sameMaze(const Maze &a, const Maze &b)
+    {
+        return a.gridWidth == b.gridWidth && a.gridHeight == b.gridHeight && a.cellSize == b.cellSize && a.wallHeight == b.wallHeight &&
+               a.wallCellCount == b.wallCellCount && sameBytes(a.solid.words(), b.solid.words()) && sameBytes(a.walls, b.walls) &&
+               sameBytes(a.emptyCells, b.emptyCells) && sameBytes(a.cellRegion, b.cellRegion) && sameBytes(a.regionFirst, b.regionFirst) &&
+               sameBytes(a.regionCells, b.regionCells);
+    }
+
+    static bool samePaths(const PathGraph &a, const PathGraph &b)
+    {
+        return a.gridWidth == b.gridWidth && a.gridHeight == b.gridHeight && a.clusterSize == b.clusterSize && a.clustersX == b.clustersX &&
+               a.clustersY == b.clustersY && sameBytes(a.nodes, b.nodes) && sameBytes(a.clusterFirstNode, b.clusterFirstNode) &&
+               sameBytes(a.edgeFirst, b.edgeFirst) && sameBytes(a.edges, b.edges) && b.nodes.isView();
+    }
+
+    // Damaged files must be rejected by open(), not crash a later query: the
+    // header and section table, and one index in each index section.
+    static int checkRejects(std::mt19937 &rng)
+    {
+        const char *path = "map_bench_damaged.tmp";
+        Maze maze = buildMazeFromGrid(randomGrid(64, 0.35, rng), 1.0f, 1.75f);
+        Bvh bvh = buildBvh(maze.walls);
+        PathGraph paths = buildPathGraph(maze, {8});
+        if (!writeMapFile(path, maze, false, &bvh, &paths, 64))
+            return 1;
+        std::vector<char> bytes;
+        {
+            std::ifstream in(path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        auto rejects = [&](const std::vector<char> &data)
+        {
+            {
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                out.write(data.data(), (std::streamsize)data.size());
+            }
+            MapFile map;
+            return !map.open(path);
+        };
+        // the first element of the section with this tag
+        auto element = [&](std::vector<char> &data, const char *tag) -> char *
+        {
+            MapHeader h;
+            std::memcpy(&h, data.data(), sizeof(h));
+            for (uint32_t i = 0; i < h.sectionCount; i++)
+            {
+                MapSection sec;
+                std::memcpy(&sec, data.data() + sizeof(MapHeader) + i * sizeof(MapSection), sizeof(sec));
+                if (std::memcmp(&sec.tag, tag, 4) == 0)
+                    return data.data() + sec.offset;
+            }
+            return nullptr;
+        };
+        auto put = [](char *at, uint32_t value)
+        { std::memcpy(at, &value, sizeof(value)); };
+        const uint32_t walls = (uint32_t)maze.walls.size();
+        const uint32_t cells = (uint32_t)maze.emptyCells.size();
+        const uint32_t regions = (uint32_t)regionCount(maze);
+        const uint32_t pathNodes = (uint32_t)paths.nodes.size();
+
+        int bad = rejects(bytes); // the undamaged file opens
+        std::vector<char> copy(bytes.begin(), bytes.begin() + (std::ptrdiff_t)(bytes.size() / 2));
+        bad += !rejects(copy); // truncated
+        copy = bytes;
+        copy[4]++; // version
+        bad += !rejects(copy);
+        copy = bytes;
+        copy[sizeof(MapHeader) + 8] ^= 0x01; // first section offset, misaligned
+        bad += !rejects(copy);
+        copy = bytes;
+        std::memset(copy.data() + offsetof(MapHeader, cellSize), 0, sizeof(float));
+        bad += !rejects(copy);
+
+        copy = bytes;
+        const int16_t offGrid = (int16_t)maze.gridWidth;
+        std::memcpy(element(copy, "EMPT") + offsetof(CellCoord, col), &offGrid, sizeof(offGrid));
+        bad += !rejects(copy);
+        copy = bytes;
+        put(element(copy, "BVHN") + offsetof(BvhNode, offset), (uint32_t)bvh.nodes.size()); // root's right child
+        bad += !rejects(copy);
+        copy = bytes;
+        for (size_t i = 0; i < bvh.nodes.size(); i++)
+            if (bvh.nodes[i].count > 0)
+            {
+                put(element(copy, "BVHN") + i * sizeof(BvhNode) + offsetof(BvhNode, offset), walls); // first leaf's boxes
+                break;
+            }
+        bad += !rejects(copy);
+        copy = bytes;
+        put(element(copy, "BVHI"), walls);
+        bad += !rejects(copy);
+        copy = bytes;
+        put(element(copy, "REGN"), regions);
+        bad += !rejects(copy);
+        copy = bytes;
+        put(element(copy, "RGNF") + sizeof(uint32_t), 0); // an empty first region
+        bad += !rejects(copy);
+        copy = bytes;
+        put(element(copy, "RGNC"), cells);
+        bad += !rejects(copy);
+        copy = bytes;
+        const CellCoord otherCluster{(int16_t)((paths.nodes[0].col + 8) % maze.gridWidth), paths.nodes[0].row};
+        std::memcpy(element(copy, "PTHN"), &otherCluster, sizeof(otherCluster));
+        bad += !rejects(copy);
+        copy = bytes;
+        put(element(copy, "PTHC"), 1); // offsets must start at 0
+        bad += !rejects(copy);
+        copy = bytes;
+        put(element(copy, "PTHF") + sizeof(uint32_t), (uint32_t)paths.edges.size() + 1); // past the edges
+        bad += !rejects(copy);
+        copy = bytes;
+        put(element(copy, "PTHE") + offsetof(PathGraph::Edge, to), pathNodes);
+        bad += !rejects(copy);
+        copy = bytes;
+        put(element(copy, "CHKF") + sizeof(uint32_t), walls + 1); // the only chunk's walls run past the section
+        bad += !rejects(copy);
+        copy = bytes;
+        put(copy.data() + offsetof(MapHeader, chunkCells), 32); // chunk rows must be whole words
+        bad += !rejects(copy);
+        std::remove(path);
+        return bad;
+    }
+} // namespace
+
+void runMapBench(BenchSuite &suite)
+{
+    std::mt19937 rng(4242);
+    std::vector<int> sizes = {256, 1024, 4096};
+    if (suite.quick)
+        sizes = {256, 1024};
+    const char *textPath = "map_bench.txt";
+    const char *mapPath = "map_bench.fmap";
+
+    for (int size : sizes)
+    {
+        for (bool merge : {false, true})
+        {
+            std::vector<std::string> grid = randomGrid(size, 0.35, rng);
+            {
+                std::ofstream out(textPath, std::ios::trunc);
+                for (const auto &row : grid)
+                    out << row << '\n';
+            }
+            const size_t cells = (size_t)size * size;
+            const std::vector<std::pair<std::string, std::string>> params = {{"grid", benchParam(size)}, {"merged", merge ? "yes" : "no"}};
+
+            // the path main used to take: parse text, derive walls, build the BVH
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<std::string> parsed;
+            bool ok = loadTextGrid(textPath, parsed);
+            Maze built = buildMazeFromGrid(parsed, 1.0f, 1.75f, merge);
+            Bvh builtBvh = buildBvh(built.walls);
+            double textSeconds = secondsSince(t0);
+            suite.record("textGridStartup", params, cells, textSeconds);
+            t0 = std::chrono::steady_clock::now();
+            PathGraph builtPaths = buildPathGraph(built);
+            double pathSeconds = secondsSince(t0);
+            suite.record("buildPathGraph", params, cells, pathSeconds);
+
+            t0 = std::chrono::steady_clock::now();
+            ok = ok && writeMapFile(mapPath, built, merge, &builtBvh, &builtPaths);
+            double writeSeconds = secondsSince(t0);
+
+            // just after writing, the file is in the page cache, as it is for a
+            // map that was played recently
+            t0 = std::chrono::steady_clock::now();
+            auto map = std::make_shared<MapFile>();
+            Maze loaded;
+            Bvh loadedBvh;
+            PathGraph loadedPaths;
+            ok = ok && map->open(mapPath) && mazeFromMapFile(map, loaded, &loadedBvh) && pathGraphFromMapFile(map, loadedPaths);
+            double openSeconds = secondsSince(t0);
+            suite.record("mapFileStartup", params, cells, openSeconds);
+
+            // a batch of rays through the mapped BVH faults in the pages it needs
+            std::uniform_int_distribution<size_t> cell(0, std::max<size_t>(1, built.emptyCells.size()) - 1);
+            std::normal_distribution<float> n(0.0f, 1.0f);
+            int rayMismatches = 0;
+            t0 = std::chrono::steady_clock::now();
+            for (int i = 0; ok && i < 1000 && !built.emptyCells.empty(); i++)
+            {
+                glm::vec3 o = cellCenter(built, built.emptyCells[cell(rng)]) + glm::vec3(0.0f, 1.0f, 0.0f);
+                glm::vec3 d = glm::normalize(glm::vec3(n(rng), 0.0f, n(rng)) + glm::vec3(1e-3f, 0.0f, 0.0f));
+                rayMismatches += bvhClosestHit(loadedBvh, o, d) != bvhClosestHit(builtBvh, o, d);
+            }
+            double raySeconds = secondsSince(t0);
+
+            if (!ok || !loaded.walls.isView() || !sameMaze(built, loaded) || !sameBytes(builtBvh.nodes, loadedBvh.nodes) ||
+                !sameBytes(builtBvh.boxes, loadedBvh.boxes) || !sameBytes(builtBvh.ids, loadedBvh.ids) || rayMismatches ||
+                !samePaths(builtPaths, loadedPaths))
+            {
+                std::printf("MISMATCH: map file round trip differs (%dx%d)\n", size, size);
+                suite.failures++;
+            }
+            std::printf("map %4dx%-4d %-3s text %8.1f ms + paths %7.1f ms | write %7.1f ms | map %6.3f ms, first 1000 rays %6.2f ms | "
+                        "%6.1f MiB\n",
+                        size, size, merge ? "mrg" : "", textSeconds * 1e3, pathSeconds * 1e3, writeSeconds * 1e3, openSeconds * 1e3,
+                        raySeconds * 1e3,
+                        map->isOpen() ? (double)map->header().fileSize / (1024.0 * 1024.0) : 0.0);
+        }
+    }
+
+    int bad = checkRejects(rng);
+    if (bad)
+    {
+        std::printf("MISMATCH: %d damaged map files were accepted\n", bad);
+        suite.failures += bad;
+    }
+    std::remove(textPath);
+    std::remove(mapPath);
+}
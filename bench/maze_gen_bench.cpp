@@ -0,0 +1,143 @@
+// Maze generation: cells per second for each algorithm, serial and on the job
+// system at 1, 2, 4, ... threads. Every grid is checked: the parallel output
+// equals the serial one, the whole floor is connected, and Backtracker and
+// Wilson mazes are perfect (as many passages as cells minus one).
+#include "bench.h"
+
+#include "jobs.h"
+#include "maze_gen.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    struct GridShape
+    {
+        size_t floor = 0;
+        size_t reached = 0;
+        size_t cells = 0;    // odd (col, row) floor characters
+        size_t passages = 0; // floor characters between two cells
+    };
+
+    static GridShape inspect(const std::vector<std::string> &grid)
+    {
+        GridShape s;
+        const int h = (int)grid.size(), w = h ? (int)grid[0].size() : 0;
+        std::vector<unsigned char> seen((size_t)w * h, 0);
+        std::vector<std::pair<int, int>> stack;
+        for (int r = 0; r < h; r++)
+            for (int c = 0; c < w; c++)
+            {
+                if (grid[(size_t)r][(size_t)c] != '.')
+                    continue;
+                s.floor++;
+                if ((r & 1) && (c & 1))
+                    s.cells++;
+                else
+                    s.passages++;
+                if (stack.empty() && s.reached == 0)
+                {
+                    stack.push_back({c, r});
+                    seen[(size_t)r * w + c] = 1;
+                }
+            }
+        while (!stack.empty())
+        {
+            auto [c, r] = stack.back();
+            stack.pop_back();
+            s.reached++;
+            const int dc[4] = {1, -1, 0, 0}, dr[4] = {0, 0, 1, -1};
+            for (int d = 0; d < 4; d++)
+            {
+                int nc = c + dc[d], nr = r + dr[d];
+                if (nc < 0 || nr < 0 || nc >= w || nr >= h || grid[(size_t)nr][(size_t)nc] != '.' || seen[(size_t)nr * w + nc])
+                    continue;
+                seen[(size_t)nr * w + nc] = 1;
+                stack.push_back({nc, nr});
+            }
+        }
+        return s;
+    }
+
+    static int verify(const std::vector<std::string> &grid, const std::vector<std::string> &serial, MazeAlgorithm algorithm, int size)
+    {
+        int bad = 0;
+        GridShape s = inspect(grid);
+        if (grid != serial)
+        {
+            std::printf("MISMATCH: %s %d parallel output differs from serial\n", mazeAlgorithmName(algorithm), size);
+            bad++;
+        }
+        if (s.reached != s.floor)
+        {
+            std::printf("MISMATCH: %s %d reaches %zu of %zu floor cells\n", mazeAlgorithmName(algorithm), size, s.reached, s.floor);
+            bad++;
+        }
+        const size_t cellsPerSide = (size_t)(size - 1) / 2;
+        if (algorithm != MazeAlgorithm::Rooms && (s.cells != cellsPerSide * cellsPerSide || s.passages + 1 != s.cells))
+        {
+            std::printf("MISMATCH: %s %d is not a perfect maze (%zu cells, %zu passages)\n", mazeAlgorithmName(algorithm), size, s.cells,
+                        s.passages);
+            bad++;
+        }
+        return bad;
+    }
+} // namespace
+
+void runMazeGenBench(BenchSuite &suite)
+{
+    const std::vector<MazeAlgorithm> algorithms = {MazeAlgorithm::Backtracker, MazeAlgorithm::Wilson, MazeAlgorithm::Rooms};
+    std::vector<int> sizes = {257, 2049};
+    if (!suite.quick)
+        sizes.push_back(4097);
+
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threadCounts;
+    for (unsigned t = 1; t < hw; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(hw);
+
+    for (MazeAlgorithm algorithm : algorithms)
+    {
+        for (int size : sizes)
+        {
+            MazeGenParams params;
+            params.algorithm = algorithm;
+            params.width = params.height = size;
+            params.seed = 2024;
+            const size_t cells = (size_t)size * size;
+
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<std::string> serial = generateMaze(params);
+            double serialSeconds = secondsSince(t0);
+            suite.record("generateMaze", {{"algo", mazeAlgorithmName(algorithm)}, {"size", benchParam(size)}, {"threads", "serial"}}, cells,
+                         serialSeconds);
+
+            for (unsigned t : threadCounts)
+            {
+                JobSystem jobs(t - 1);
+                t0 = std::chrono::steady_clock::now();
+                std::vector<std::string> grid = generateMaze(params, &jobs);
+                double seconds = secondsSince(t0);
+                suite.record("generateMaze", {{"algo", mazeAlgorithmName(algorithm)}, {"size", benchParam(size)}, {"threads", benchParam(t)}},
+                             cells, seconds);
+                std::printf("mazegen %-11s %5dx%-5d %2u threads: %7.1f Mcells/s (%.2fx serial)\n", mazeAlgorithmName(algorithm), size, size, t,
+                            (double)cells / seconds * 1e-6, serialSeconds / seconds);
+                // the large grids take long to walk; check the last run only
+                if (t == threadCounts.back() || size < 1000)
+                    suite.failures += verify(grid, serial, algorithm, size);
+            }
+        }
+    }
+
+    // a different seed must give a different maze
+    MazeGenParams a, b;
+    b.seed = a.seed + 1;
+    if (generateMaze(a) == generateMaze(b))
+    {
+        std::printf("MISMATCH: maze generation ignores the seed\n");
+        suite.failures++;
+    }
+}
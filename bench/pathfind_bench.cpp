@@ -0,0 +1,244 @@
+// Hierarchical pathfinding on generated mazes up to 8193^2: graph build time
+// and size, single-query latency (abstract plan only, full path without and
+// with the segment cache, next to a flat grid BFS) and batched throughput on
+// the job system. Every path is checked cell by cell and its length compared
+// with the BFS optimum; batched, cached and serial results must match.
+#include "bench.h"
+
+#include "jobs.h"
+#include "maze_gen.h"
+#include "pathfind.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+
+namespace
+{
+    // only the occupancy grid; wall boxes would dominate memory at 8193^2
+    static Maze generatedGrid(int size, MazeAlgorithm algorithm, JobSystem &jobs)
+    {
+        MazeGenParams params;
+        params.algorithm = algorithm;
+        params.width = params.height = size;
+        params.seed = 31;
+        Maze maze;
+        maze.solid = gridFromText(generateMaze(params, &jobs));
+        maze.gridWidth = maze.solid.width();
+        maze.gridHeight = maze.solid.height();
+        return maze;
+    }
+
+    static CellCoord randomOpenCell(const Maze &maze, std::mt19937 &rng)
+    {
+        std::uniform_int_distribution<int> col(0, maze.gridWidth - 1), row(0, maze.gridHeight - 1);
+        for (;;)
+        {
+            CellCoord c{(int16_t)col(rng), (int16_t)row(rng)};
+            if (!maze.solid.get(c.col, c.row))
+                return c;
+        }
+    }
+
+    // Steps of the shortest path, or -1; the flat search HPA* replaces.
+    static long gridBfs(const Maze &maze, CellCoord start, CellCoord goal, std::vector<uint32_t> &dist)
+    {
+        const int w = maze.gridWidth;
+        dist.assign((size_t)w * (size_t)maze.gridHeight, 0xffffffffu);
+        std::deque<CellCoord> queue{start};
+        dist[(size_t)start.row * w + start.col] = 0;
+        const int dc[4] = {1, -1, 0, 0}, dr[4] = {0, 0, 1, -1};
+        while (!queue.empty())
+        {
+            CellCoord c = queue.front();
+            queue.pop_front();
+            const uint32_t d = dist[(size_t)c.row * w + c.col];
+            if (c.col == goal.col && c.row == goal.row)
+                return (long)d;
+            for (int k = 0; k < 4; k++)
+            {
+                CellCoord n{(int16_t)(c.col + dc[k]), (int16_t)(c.row + dr[k])};
+                if (!maze.solid.contains(n.col, n.row) || maze.solid.get(n.col, n.row))
+                    continue;
+                uint32_t &nd = dist[(size_t)n.row * w + n.col];
+                if (nd == 0xffffffffu)
+                {
+                    nd = d + 1;
+                    queue.push_back(n);
+                }
+            }
+        }
+        return -1;
+    }
+
+    static bool validPath(const Maze &maze, const std::vector<CellCoord> &path, CellCoord start, CellCoord goal)
+    {
+        if (path.empty() || path.front().col != start.col || path.front().row != start.row || path.back().col != goal.col ||
+            path.back().row != goal.row)
+            return false;
+        for (size_t i = 0; i < path.size(); i++)
+        {
+            if (!maze.solid.contains(path[i].col, path[i].row) || maze.solid.get(path[i].col, path[i].row))
+                return false;
+            if (i > 0 && std::abs(path[i].col - path[i - 1].col) + std::abs(path[i].row - path[i - 1].row) != 1)
+                return false;
+        }
+        return true;
+    }
+
+    static bool samePath(const std::vector<CellCoord> &a, const std::vector<CellCoord> &b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](CellCoord x, CellCoord y)
+                                                  { return x.col == y.col && x.row == y.row; });
+    }
+
+    // HPA* paths against the BFS optimum; returns the failures
+    static int verify(const PathGraph &graph, const Maze &maze, int size, int queries, std::mt19937 &rng)
+    {
+        std::vector<uint32_t> dist;
+        PathCache cache;
+        double ratio = 0.0;
+        int found = 0, bad = 0;
+        for (int q = 0; q < queries && bad == 0; q++)
+        {
+            CellCoord a = randomOpenCell(maze, rng), b = randomOpenCell(maze, rng);
+            std::vector<CellCoord> path, cached;
+            const bool ok = findPath(graph, maze, a, b, path);
+            const long best = gridBfs(maze, a, b, dist);
+            if (ok != (best >= 0))
+            {
+                std::printf("MISMATCH: path %d: (%d,%d)->(%d,%d) found %d, reachable %d\n", size, a.col, a.row, b.col, b.row, ok, best >= 0);
+                bad++;
+                continue;
+            }
+            if (!ok)
+                continue;
+            // twice through the cache: the second run is served from it
+            findPath(graph, maze, a, b, cached, &cache);
+            findPath(graph, maze, a, b, cached, &cache);
+            if (!validPath(maze, path, a, b) || (long)path.size() - 1 < best || !samePath(path, cached))
+            {
+                std::printf("MISMATCH: path %d: (%d,%d)->(%d,%d) invalid, %zu steps for optimum %ld\n", size, a.col, a.row, b.col, b.row,
+                            path.size() - 1, best);
+                bad++;
+                continue;
+            }
+            found++;
+            ratio += best > 0 ? (double)(path.size() - 1) / (double)best : 1.0;
+        }
+        if (found > 0)
+            std::printf("path %5dx%-5d %d queries checked, HPA* paths %.2f%% longer than optimal on average\n", size, size, found,
+                        (ratio / found - 1.0) * 100.0);
+        return bad;
+    }
+
+    static void bench(BenchSuite &suite, JobSystem &jobs, int size, MazeAlgorithm algorithm, std::mt19937 &rng)
+    {
+        const Maze maze = generatedGrid(size, algorithm, jobs);
+        auto p = [&](std::vector<std::pair<std::string, std::string>> extra = {})
+        {
+            std::vector<std::pair<std::string, std::string>> params = {{"size", benchParam(size)}, {"maze", mazeAlgorithmName(algorithm)}};
+            params.insert(params.end(), extra.begin(), extra.end());
+            return params;
+        };
+
+        auto t0 = std::chrono::steady_clock::now();
+        const PathGraph graph = buildPathGraph(maze, {}, &jobs);
+        const double build = secondsSince(t0);
+        suite.record("buildPathGraph", p(), 1, build);
+        std::printf("path %5dx%-5d %s: %zu nodes, %zu edges, %.1f MB, built in %.0f ms\n", size, size, mazeAlgorithmName(algorithm),
+                    graph.nodes.size(), graph.edges.size(), (double)graph.bytes() / (1 << 20), build * 1e3);
+
+        if (size <= 1025)
+            suite.failures += verify(graph, maze, size, 300, rng);
+        else if (size <= 4097)
+            suite.failures += verify(graph, maze, size, suite.quick ? 10 : 40, rng);
+
+        std::vector<PathRequest> requests(suite.quick ? 64 : 256);
+        for (auto &r : requests)
+            r = {randomOpenCell(maze, rng), randomOpenCell(maze, rng)};
+        const size_t mask = requests.size() - 1;
+
+        PathPlan plan;
+        suite.run("planPath", p(), [&](uint64_t i)
+                  {
+                      const PathRequest &r = requests[i & mask];
+                      planPath(graph, maze, r.start, r.goal, plan);
+                      return plan.length; });
+
+        // full paths, one at a time: per-query latency percentiles
+        std::vector<CellCoord> path;
+        std::vector<double> latency;
+        for (const PathRequest &r : requests)
+        {
+            auto q0 = std::chrono::steady_clock::now();
+            findPath(graph, maze, r.start, r.goal, path);
+            latency.push_back(secondsSince(q0));
+        }
+        std::sort(latency.begin(), latency.end());
+        std::printf("path %5dx%-5d findPath latency p50 %.1f us, p99 %.1f us, max %.1f us\n", size, size, latency[latency.size() / 2] * 1e6,
+                    latency[latency.size() * 99 / 100] * 1e6, latency.back() * 1e6);
+        suite.run("findPath", p({{"cache", "off"}}), [&](uint64_t i)
+                  {
+                      const PathRequest &r = requests[i & mask];
+                      findPath(graph, maze, r.start, r.goal, path);
+                      return path.size(); });
+        PathCache cache;
+        suite.run("findPath", p({{"cache", "on"}}), [&](uint64_t i)
+                  {
+                      const PathRequest &r = requests[i & mask];
+                      findPath(graph, maze, r.start, r.goal, path, &cache);
+                      return path.size(); });
+        std::printf("path %5dx%-5d cache: %zu segments, %.1f%% hits\n", size, size, cache.size(),
+                    100.0 * (double)cache.hits() / (double)std::max<uint64_t>(1, cache.hits() + cache.misses()));
+
+        // the flat search, on the sizes where its full-grid arrays are reasonable
+        if (size <= 4097)
+        {
+            std::vector<uint32_t> dist;
+            suite.run("gridBfs", p(), [&](uint64_t i)
+                      {
+                          const PathRequest &r = requests[i & mask];
+                          return gridBfs(maze, r.start, r.goal, dist); });
+        }
+
+        // batches of agents replanning at once, inline and on the job system
+        const size_t refineCells = 32;
+        std::vector<PathPlan> serial, batched;
+        auto batch = [&](const char *mode, JobSystem *js, std::vector<PathPlan> &plans)
+        {
+            suite.runPasses("planPaths", p({{"mode", mode}, {"threads", benchParam(js ? js->workerCount() + 1 : 1u)}}), requests.size(),
+                            [&](uint64_t)
+                            { planPaths(graph, maze, requests, plans, refineCells, js, &cache); });
+        };
+        batch("inline", nullptr, serial);
+        batch("jobs", &jobs, batched);
+        for (size_t i = 0; i < requests.size(); i++)
+            if (!samePath(serial[i].cells, batched[i].cells) || serial[i].length != batched[i].length)
+            {
+                std::printf("MISMATCH: path %d: batched plan %zu differs from the inline one\n", size, i);
+                suite.failures++;
+                break;
+            }
+    }
+} // namespace
+
+void runPathfindBench(BenchSuite &suite)
+{
+    JobSystem jobs;
+    std::mt19937 rng(123);
+
+    std::vector<int> sizes = {1025, 4097};
+    if (!suite.quick)
+        sizes.push_back(8193);
+    for (int size : sizes)
+        bench(suite, jobs, size, MazeAlgorithm::Rooms, rng);
+    // a perfect maze: one long winding path between any two cells
+    bench(suite, jobs, 1025, MazeAlgorithm::Backtracker, rng);
+
+    // the game's own layout, where the pocket cells make some goals unreachable
+    Maze game = buildMazeFromGrid(tiledGameGrid(4), 1.0f, 1.75f);
+    PathGraph graph = buildPathGraph(game, {});
+    suite.failures += verify(graph, game, game.gridWidth, 300, rng);
+}
@@ -0,0 +1,116 @@
+// PVS: build time and size across maps, decode cost per lookup, how often a
+// random eye-level ray hits a wall outside its cell's set (the sampling miss
+// rate), and a save/load round trip.
+#include "bench.h"
+
+#include "collision.h"
+#include "jobs.h"
+#include "maze.h"
+#include "pvs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    static double missRate(const Maze &maze, const Pvs &pvs, std::mt19937 &rng)
+    {
+        const size_t cells = (size_t)maze.gridWidth * (size_t)maze.gridHeight;
+        std::vector<uint32_t> wallIndex(cells, 0);
+        uint32_t walls = 0;
+        for (size_t i = 0; i < cells; i++)
+            if (maze.solid.get((int)(i % (size_t)maze.gridWidth), (int)(i / (size_t)maze.gridWidth)))
+                wallIndex[i] = walls++;
+
+        std::uniform_int_distribution<size_t> cell(0, maze.emptyCells.size() - 1);
+        std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        std::vector<uint32_t> visible;
+        size_t hits = 0, misses = 0;
+        for (int k = 0; k < 20000; k++)
+        {
+            glm::vec3 o = cellCenter(maze, maze.emptyCells[cell(rng)]) + glm::vec3(jitter(rng), 1.0f, jitter(rng)) * maze.cellSize;
+            float a = angle(rng);
+            glm::vec3 d(std::cos(a), 0.0f, std::sin(a));
+            float t = nearestWallT(maze, o, d);
+            if (t > 1e30f)
+                continue;
+            int c, r, hc, hr;
+            worldToCell(maze, o.x, o.z, c, r);
+            glm::vec3 p = o + d * (t + 1e-3f * maze.cellSize);
+            worldToCell(maze, p.x, p.z, hc, hr);
+            if (!isWallCell(maze, hc, hr))
+                continue;
+            visible.clear();
+            if (!pvsVisibleWalls(pvs, c, r, visible))
+                continue;
+            hits++;
+            if (!std::binary_search(visible.begin(), visible.end(), wallIndex[(size_t)hr * maze.gridWidth + hc]))
+                misses++;
+        }
+        return (double)misses / (double)std::max<size_t>(1, hits);
+    }
+
+    static void benchMap(BenchSuite &suite, JobSystem &jobs, const char *name, const std::vector<std::string> &grid, std::mt19937 &rng)
+    {
+        Maze maze = buildMazeFromGrid(grid, 1.0f, 1.75f);
+        PvsParams params;
+
+        auto t0 = std::chrono::steady_clock::now();
+        Pvs pvs = buildPvs(maze, params, &jobs);
+        double seconds = secondsSince(t0);
+        auto params0 = std::vector<std::pair<std::string, std::string>>{{"map", name}, {"cells", benchParam((size_t)maze.gridWidth * (size_t)maze.gridHeight)}};
+        suite.record("buildPvs", params0, maze.emptyCells.size(), seconds);
+
+        // round trip through the file format, and a stale key must be rejected
+        int bad = 0;
+        const char *path = "pvs_bench.tmp";
+        Pvs loaded;
+        if (!savePvs(pvs, path) || !loadPvs(loaded, path, pvs.key) || loaded.offsets != pvs.offsets || loaded.data != pvs.data)
+            bad++;
+        if (loadPvs(loaded, path, pvs.key ^ 1))
+            bad++;
+        std::remove(path);
+        if (bad)
+            std::printf("MISMATCH: PVS save/load round trip failed (%s)\n", name);
+        suite.failures += bad;
+
+        std::vector<std::pair<int, int>> cells;
+        size_t total = 0;
+        std::vector<uint32_t> visible;
+        for (int r = 0; r < maze.gridHeight; r++)
+            for (int c = 0; c < maze.gridWidth; c++)
+            {
+                visible.clear();
+                if (pvsVisibleWalls(pvs, c, r, visible))
+                {
+                    cells.emplace_back(c, r);
+                    total += visible.size();
+                }
+            }
+        std::shuffle(cells.begin(), cells.end(), rng);
+        const size_t n = cells.size();
+        suite.run("pvsVisibleWalls", {{"map", name}, {"avg_visible", benchParam((double)total / (double)n)}}, [&](uint64_t i)
+                  {
+                      visible.clear();
+                      pvsVisibleWalls(pvs, cells[i % n].first, cells[i % n].second, visible);
+                      return visible.size(); });
+
+        std::printf("PVS %-12s %6zu empty cells: %.3f s, %8zu bytes (%.1f per cell), %.1f of %u walls visible, %.3f%% sampled misses\n", name,
+                    maze.emptyCells.size(), seconds, pvs.data.size(), (double)pvs.data.size() / (double)n, (double)total / (double)n, pvs.wallCount,
+                    100.0 * missRate(maze, pvs, rng));
+    }
+} // namespace
+
+void runPvsBench(BenchSuite &suite)
+{
+    std::mt19937 rng(2024);
+    JobSystem jobs;
+    benchMap(suite, jobs, "game 17x15", tiledGameGrid(1), rng);
+    benchMap(suite, jobs, "game x4", tiledGameGrid(4), rng);
+    // big enough that a per-cell pass over every wall would dominate the build
+    benchMap(suite, jobs, "game x12", tiledGameGrid(12), rng);
+    if (!suite.quick)
+        benchMap(suite, jobs, "random 64", randomGrid(64, 0.35, rng), rng);
+}
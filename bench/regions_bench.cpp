@@ -0,0 +1,191 @@
+// Connected regions of open cells: labelRegions inline and on the job system
+// on room mazes and random noise grids up to 8193^2, then spawn picks in the
+// player's region against re-rolling uniform cells until one is reachable.
+// Labels are checked against a BFS flood fill, and inline and parallel
+// labels must match exactly.
+#include "bench.h"
+
+#include "jobs.h"
+#include "maze.h"
+#include "maze_gen.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    // the occupancy grid and the empty cells only; wall boxes would dominate
+    // memory at 8193^2
+    static Maze gridMaze(BitGrid solid)
+    {
+        Maze maze;
+        maze.solid = std::move(solid);
+        maze.gridWidth = maze.solid.width();
+        maze.gridHeight = maze.solid.height();
+        for (int r = 0; r < maze.gridHeight; r++)
+            for (int c = 0; c < maze.gridWidth; c++)
+                if (!maze.solid.get(c, r))
+                    maze.emptyCells.push_back({(int16_t)c, (int16_t)r});
+        return maze;
+    }
+
+    static Maze roomsMaze(int size, JobSystem &jobs)
+    {
+        MazeGenParams params;
+        params.algorithm = MazeAlgorithm::Rooms;
+        params.width = params.height = size;
+        params.seed = 71;
+        return gridMaze(gridFromText(generateMaze(params, &jobs)));
+    }
+
+    // walls with the given density: many regions, most of them small
+    static Maze noiseMaze(int width, int height, double walls, std::mt19937 &rng)
+    {
+        std::bernoulli_distribution wall(walls);
+        BitGrid solid(width, height);
+        for (int r = 0; r < height; r++)
+            for (int c = 0; c < width; c++)
+                if (wall(rng))
+                    solid.set(c, r, true);
+        return gridMaze(std::move(solid));
+    }
+
+    // regions by flood fill, numbered in the order of their first cell
+    static std::vector<uint32_t> floodRegions(const Maze &maze, size_t &regions)
+    {
+        std::vector<uint32_t> label(maze.emptyCells.size(), kNoRegion);
+        std::vector<size_t> queue;
+        const int dc[4] = {1, -1, 0, 0}, dr[4] = {0, 0, 1, -1};
+        regions = 0;
+        for (size_t seed = 0; seed < label.size(); seed++)
+        {
+            if (label[seed] != kNoRegion)
+                continue;
+            label[seed] = (uint32_t)regions;
+            queue.assign(1, seed);
+            for (size_t head = 0; head < queue.size(); head++)
+            {
+                const CellCoord c = maze.emptyCells[queue[head]];
+                for (int k = 0; k < 4; k++)
+                {
+                    const long n = emptyCellIndex(maze, c.col + dc[k], c.row + dr[k]);
+                    if (n >= 0 && label[(size_t)n] == kNoRegion)
+                    {
+                        label[(size_t)n] = (uint32_t)regions;
+                        queue.push_back((size_t)n);
+                    }
+                }
+            }
+            regions++;
+        }
+        return label;
+    }
+
+    static bool sameArray(const MappedArray<uint32_t> &a, const MappedArray<uint32_t> &b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+    }
+
+    static int verify(Maze maze, JobSystem &jobs, const char *what)
+    {
+        size_t regions = 0;
+        const std::vector<uint32_t> ref = floodRegions(maze, regions);
+        labelRegions(maze, nullptr);
+        Maze parallel = maze;
+        labelRegions(parallel, &jobs);
+
+        bool ok = regionCount(maze) == regions && maze.cellRegion.size() == ref.size() &&
+                  std::equal(ref.begin(), ref.end(), maze.cellRegion.begin()) && sameArray(maze.cellRegion, parallel.cellRegion) &&
+                  sameArray(maze.regionFirst, parallel.regionFirst) && sameArray(maze.regionCells, parallel.regionCells);
+        // every region's cells listed once, in row-major order
+        for (uint32_t r = 0; ok && r < regions; r++)
+            for (uint32_t k = maze.regionFirst[r]; ok && k < maze.regionFirst[r + 1]; k++)
+                ok = maze.cellRegion[maze.regionCells[k]] == r && (k == maze.regionFirst[r] || maze.regionCells[k - 1] < maze.regionCells[k]);
+        ok = ok && maze.regionFirst.back() == maze.emptyCells.size();
+        for (int r = -1; ok && r <= maze.gridHeight; r++)
+            for (int c = -1; ok && c <= maze.gridWidth; c++)
+            {
+                const long i = emptyCellIndex(maze, c, r);
+                const bool open = maze.solid.contains(c, r) && !maze.solid.get(c, r);
+                ok = open == (i >= 0) && regionAt(maze, c, r) == (open ? ref[(size_t)i] : kNoRegion);
+            }
+        if (!ok)
+            std::printf("MISMATCH: regions (%s %dx%d) differ from the flood fill\n", what, maze.gridWidth, maze.gridHeight);
+        else
+            std::printf("regions %5dx%-5d %-6s %zu regions checked\n", maze.gridWidth, maze.gridHeight, what, regions);
+        return ok ? 0 : 1;
+    }
+
+    static void benchLabel(BenchSuite &suite, JobSystem &jobs, Maze &maze, const char *what)
+    {
+        auto time = [&](JobSystem *js)
+        {
+            return suite.runPasses("labelRegions",
+                                   {{"size", benchParam(maze.gridWidth)}, {"grid", what}, {"threads", benchParam(js ? js->workerCount() + 1 : 1u)}},
+                                   1, [&](uint64_t)
+                                   { labelRegions(maze, js); });
+        };
+        const double serial = time(nullptr);
+        const double parallel = time(&jobs);
+        std::printf("regions %5dx%-5d %-6s %zu regions, %.1f ms inline, %.1f ms on %u threads, %.1f ns per open cell\n", maze.gridWidth,
+                    maze.gridHeight, what, regionCount(maze), serial * 1e3, parallel * 1e3, jobs.workerCount() + 1,
+                    parallel / (double)std::max<size_t>(1, maze.emptyCells.size()) * 1e9);
+    }
+
+    // Spawning in the largest region: one O(1) draw from its cell list, or
+    // uniform open cells re-rolled until one lands in it.
+    static void benchSpawn(BenchSuite &suite, const Maze &maze, const char *what, std::mt19937 &rng)
+    {
+        uint32_t largest = 0;
+        for (uint32_t r = 1; r < regionCount(maze); r++)
+            if (maze.regionFirst[r + 1] - maze.regionFirst[r] > maze.regionFirst[largest + 1] - maze.regionFirst[largest])
+                largest = r;
+        auto p = [&](const char *pick)
+        { return std::vector<std::pair<std::string, std::string>>{{"size", benchParam(maze.gridWidth)}, {"grid", what}, {"pick", pick}}; };
+
+        suite.run("spawnCell", p("region"), [&](uint64_t)
+                  { return randomRegionCell(maze, largest, rng).col; });
+        std::uniform_int_distribution<size_t> any(0, maze.emptyCells.size() - 1);
+        uint64_t rolls = 0, picks = 0;
+        suite.run("spawnCell", p("reroll"), [&](uint64_t)
+                  {
+                      picks++;
+                      for (;;)
+                      {
+                          rolls++;
+                          const CellCoord c = maze.emptyCells[any(rng)];
+                          if (regionAt(maze, c.col, c.row) == largest)
+                              return c.col;
+                      } });
+        std::printf("regions %5dx%-5d %-6s largest region %.1f%% of open cells, %.2f rolls per reachable spawn\n", maze.gridWidth,
+                    maze.gridHeight, what,
+                    100.0 * (double)(maze.regionFirst[largest + 1] - maze.regionFirst[largest]) / (double)maze.emptyCells.size(),
+                    (double)rolls / (double)std::max<uint64_t>(1, picks));
+    }
+} // namespace
+
+void runRegionsBench(BenchSuite &suite)
+{
+    JobSystem jobs;
+    std::mt19937 rng(654);
+
+    // odd sizes so stripes and row words end part way
+    suite.failures += verify(noiseMaze(301, 397, 0.4, rng), jobs, "noise");
+    suite.failures += verify(noiseMaze(130, 260, 0.55, rng), jobs, "noise");
+    suite.failures += verify(roomsMaze(257, jobs), jobs, "rooms");
+    // the game's layout, tiled: its pocket cells are regions of their own
+    suite.failures += verify(buildMazeFromGrid(tiledGameGrid(3), 1.0f, 1.75f), jobs, "game");
+
+    std::vector<int> sizes = {1025, 4097};
+    if (!suite.quick)
+        sizes.push_back(8193);
+    for (int size : sizes)
+    {
+        Maze rooms = roomsMaze(size, jobs);
+        benchLabel(suite, jobs, rooms, "rooms");
+        benchSpawn(suite, rooms, "rooms", rng);
+        Maze noise = noiseMaze(size, size, 0.4, rng);
+        benchLabel(suite, jobs, noise, "noise");
+        benchSpawn(suite, noise, "noise", rng);
+    }
+}
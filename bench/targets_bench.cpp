@@ -0,0 +1,197 @@
+// Hitscan against targets: the old array-of-structs loop over raySphere (which
+// skips dead entries) vs. the densely packed structure-of-arrays pool (scalar
+// and SIMD), with an exact equivalence check; plus the pool's kill/respawn churn.
+#include "bench.h"
+
+#include "collision.h"
+#include "targets.h"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace
+{
+    static constexpr float kEnemyRadius = 0.45f;
+
+    // the layout main.cpp used before the pool
+    struct TargetAoS
+    {
+        glm::vec3 pos{0.0f};
+        glm::vec3 prevPos{0.0f};
+        bool alive = true;
+    };
+
+    struct Ray
+    {
+        glm::vec3 origin;
+        glm::vec3 dir;
+    };
+
+    static int raycastAoS(const std::vector<TargetAoS> &targets, const Ray &r, float maxT, float &tHit)
+    {
+        float bestT = maxT;
+        int best = -1;
+        for (size_t i = 0; i < targets.size(); i++)
+        {
+            const TargetAoS &t = targets[i];
+            if (!t.alive)
+                continue;
+            float th = 0.0f;
+            if (!raySphere(r.origin, r.dir, t.pos, kEnemyRadius, th))
+                continue;
+            if (th < bestT)
+            {
+                bestT = th;
+                best = (int)i;
+            }
+        }
+        if (best >= 0)
+            tHit = bestT;
+        return best;
+    }
+
+    static glm::vec3 randomUnit(std::mt19937 &rng)
+    {
+        std::normal_distribution<float> n(0.0f, 1.0f);
+        glm::vec3 d;
+        do
+            d = {n(rng), n(rng), n(rng)};
+        while (glm::length(d) < 1e-3f);
+        return glm::normalize(d);
+    }
+
+    static void benchTargetCount(BenchSuite &suite, size_t count, double aliveRatio, std::mt19937 &rng)
+    {
+        // keep the density roughly constant so every size has a useful hit ratio
+        const float half = 2.0f * std::cbrt((float)count) + 1.0f;
+        std::uniform_real_distribution<float> coord(-half, half);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        TargetPool pool;
+        std::vector<TargetAoS> aos(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::vec3 p(coord(rng), coord(rng) * 0.1f, coord(rng));
+            aos[i].pos = aos[i].prevPos = p;
+            aos[i].alive = unit(rng) < aliveRatio;
+            pool.add(p, kEnemyRadius);
+        }
+        // kill from the back so the earlier indices stay put while we go
+        for (size_t i = count; i-- > 0;)
+            if (!aos[i].alive)
+                pool.kill(i);
+
+        const size_t n = 1024;
+        std::vector<Ray> rays(n);
+        for (auto &r : rays)
+        {
+            r.origin = {coord(rng), 0.0f, coord(rng)};
+            r.dir = randomUnit(rng);
+            r.dir.y *= 0.1f;
+            r.dir = glm::normalize(r.dir);
+        }
+
+        const float inf = std::numeric_limits<float>::infinity();
+        size_t hits = 0;
+        int bad = 0;
+        for (const auto &r : rays)
+        {
+            float ta = 0.0f, ts = 0.0f, tv = 0.0f;
+            int a = raycastAoS(aos, r, inf, ta);
+            int s = raycastTargetsScalar(pool, r.origin, r.dir, inf, ts);
+            int v = raycastTargets(pool, r.origin, r.dir, inf, tv);
+            hits += a >= 0 ? 1 : 0;
+            // the pool reorders targets, so compare what was hit, not indices
+            bool same = (a >= 0) == (s >= 0) && (a >= 0) == (v >= 0);
+            if (same && a >= 0)
+                same = ta == ts && ta == tv && aos[a].pos == pool.position(s) && aos[a].pos == pool.position(v);
+            if (!same)
+            {
+                if (bad < 10)
+                    std::printf("target mismatch: aos %d (%g) soa %d (%g) simd %d (%g)\n", a, ta, s, ts, v, tv);
+                bad++;
+            }
+        }
+        if (bad)
+            std::printf("MISMATCH: %d hitscan disagreements on %zu targets\n", bad, count);
+        suite.failures += bad;
+
+        auto params = std::vector<std::pair<std::string, std::string>>{
+            {"targets", benchParam(count)}, {"alive", benchParam(aliveRatio)}, {"hit_ratio", benchParam((double)hits / n)}};
+        suite.run("raycastTargetsAoS", params, [&](uint64_t i)
+                  {
+                      float t = 0.0f;
+                      return raycastAoS(aos, rays[i % n], inf, t); });
+        suite.run("raycastTargetsScalar", params, [&](uint64_t i)
+                  {
+                      const Ray &r = rays[i % n];
+                      float t = 0.0f;
+                      return raycastTargetsScalar(pool, r.origin, r.dir, inf, t); });
+        suite.run("raycastTargets", params, [&](uint64_t i)
+                  {
+                      const Ray &r = rays[i % n];
+                      float t = 0.0f;
+                      return raycastTargets(pool, r.origin, r.dir, inf, t); });
+    }
+
+    // one kill + one respawn per op: the old first-dead linear scan vs. the pool
+    static void benchRespawn(BenchSuite &suite, size_t count, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> coord(-50.0f, 50.0f);
+        std::vector<TargetAoS> aos(count);
+        TargetPool pool;
+        for (auto &t : aos)
+        {
+            t.pos = t.prevPos = {coord(rng), 0.0f, coord(rng)};
+            pool.add(t.pos, kEnemyRadius);
+        }
+
+        const size_t n = 4096;
+        std::vector<size_t> victims(n);
+        std::vector<glm::vec3> spawns(n);
+        std::uniform_int_distribution<size_t> pick(0, count - 1);
+        for (size_t i = 0; i < n; i++)
+        {
+            victims[i] = pick(rng);
+            spawns[i] = {coord(rng), 0.0f, coord(rng)};
+        }
+        // start with half of the targets dead, as in a busy fight
+        for (size_t i = 0; i < count; i += 2)
+        {
+            aos[i].alive = false;
+            pool.kill(pool.liveCount - 1);
+        }
+
+        auto params = std::vector<std::pair<std::string, std::string>>{{"targets", benchParam(count)}};
+        suite.run("respawnScanAoS", params, [&](uint64_t i)
+                  {
+                      aos[victims[i % n]].alive = false;
+                      for (size_t j = 0; j < aos.size(); j++)
+                          if (!aos[j].alive)
+                          {
+                              aos[j].pos = aos[j].prevPos = spawns[i % n];
+                              aos[j].alive = true;
+                              return (double)j;
+                          }
+                      return 0.0; });
+        suite.run("respawnPool", params, [&](uint64_t i)
+                  {
+                      pool.kill(victims[i % n] % pool.liveCount);
+                      pool.respawn(spawns[i % n]);
+                      return (double)pool.liveCount; });
+    }
+} // namespace
+
+void runTargetsBench(BenchSuite &suite)
+{
+    std::mt19937 rng(4321);
+    std::vector<size_t> counts = {6, 64, 1024, 16384};
+    if (suite.quick)
+        counts = {6, 64, 1024};
+    for (size_t count : counts)
+        for (double alive : {1.0, 0.5})
+            benchTargetCount(suite, count, alive, rng);
+    for (size_t count : counts)
+        benchRespawn(suite, count, rng);
+}
@@ -1,18 +1,21 @@
 #version 330 core
 
+// baked wall mesh: positions in world space, UVs already in world units
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTex;
 
 out vec2 TexCoord;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec2 uvScale;
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+};
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    TexCoord = aTex * uvScale;
+    gl_Position = viewProjection * vec4(aPos, 1.0);
+    TexCoord = aTex;
 }
-
@@ -0,0 +1,244 @@
+#include "bit_grid.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BITGRID_SSE2 1
+#endif
+
+// bits [lo, hi) of a word, 0 <= lo <= hi <= 64
+static uint64_t bitRange(int lo, int hi)
+{
+    uint64_t upto = hi >= 64 ? ~0ull : (1ull << hi) - 1;
+    return upto & ~((1ull << lo) - 1);
+}
+
+BitGrid::BitGrid(int width, int height)
+    : width_(std::max(0, width)), height_(std::max(0, height)), wordsPerRow_(wordsPerRowFor(std::max(0, width)))
+{
+    words_.assign(wordsPerRow_ * (size_t)height_, 0);
+}
+
+BitGrid BitGrid::view(int width, int height, const uint64_t *words)
+{
+    BitGrid g;
+    g.width_ = std::max(0, width);
+    g.height_ = std::max(0, height);
+    g.wordsPerRow_ = wordsPerRowFor(g.width_);
+    g.words_ = MappedArray<uint64_t>::view(words, g.wordsPerRow_ * (size_t)g.height_);
+    return g;
+}
+
+void BitGrid::set(int col, int row, bool value)
+{
+    uint64_t &w = mutableRowWords(row)[col >> 6];
+    const uint64_t bit = 1ull << (col & 63);
+    w = value ? (w | bit) : (w & ~bit);
+}
+
+size_t BitGrid::count() const
+{
+    size_t n = 0;
+    for (uint64_t w : words_)
+        n += (size_t)popcount64(w);
+    return n;
+}
+
+size_t BitGrid::countRow(int row, int col0, int col1) const
+{
+    col0 = std::max(col0, 0);
+    col1 = std::min(col1, width_);
+    if (row < 0 || row >= height_ || col0 >= col1)
+        return 0;
+    const uint64_t *w = rowWords(row);
+    const int first = col0 >> 6, last = (col1 - 1) >> 6;
+    if (first == last)
+        return (size_t)popcount64(w[first] & bitRange(col0 & 63, ((col1 - 1) & 63) + 1));
+    size_t n = (size_t)popcount64(w[first] & bitRange(col0 & 63, 64));
+    for (int i = first + 1; i < last; i++)
+        n += (size_t)popcount64(w[i]);
+    return n + (size_t)popcount64(w[last] & bitRange(0, ((col1 - 1) & 63) + 1));
+}
+
+size_t BitGrid::countRect(int col0, int row0, int col1, int row1) const
+{
+    size_t n = 0;
+    for (int r = std::max(row0, 0); r < std::min(row1, height_); r++)
+        n += countRow(r, col0, col1);
+    return n;
+}
+
+// Along X a neighbour mask is the row shifted by one bit, carrying across
+// word boundaries: out[i] = w[i] >> 1 | w[i + 1] << 63 for +X, and
+// w[i] << 1 | w[i - 1] >> 63 for -X. The padding bits are clear, so the last
+// column's +X neighbour reads as clear; -X shifts the last column into the
+// padding, which is masked off again.
+void neighbourMask(const BitGrid &grid, int row, GridSide side, uint64_t *out)
+{
+    neighbourMask(grid, row, side, out, 0, grid.wordsPerRow());
+}
+
+void neighbourMask(const BitGrid &grid, int row, GridSide side, uint64_t *out, size_t word0, size_t word1)
+{
+    const size_t n = grid.wordsPerRow();
+    word1 = std::min(word1, n);
+    if (word0 >= word1)
+        return;
+    const size_t count = word1 - word0;
+    if (side == GridSide::PosZ || side == GridSide::NegZ)
+    {
+        int other = row + (side == GridSide::PosZ ? 1 : -1);
+        if (other < 0 || other >= grid.height())
+            std::memset(out, 0, count * sizeof(uint64_t));
+        else
+            std::memcpy(out, grid.rowWords(other) + word0, count * sizeof(uint64_t));
+        return;
+    }
+
+    // the carries come from the words on either side, inside the range or not
+    const uint64_t *w = grid.rowWords(row);
+    if (side == GridSide::PosX)
+    {
+        size_t i = word0;
+#if defined(__AVX2__)
+        for (; i + 4 <= word1 && i + 5 <= n; i += 4)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(w + i));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(w + i + 1));
+            _mm256_storeu_si256((__m256i *)(out + (i - word0)), _mm256_or_si256(_mm256_srli_epi64(a, 1), _mm256_slli_epi64(b, 63)));
+        }
+#elif defined(BITGRID_SSE2)
+        for (; i + 2 <= word1 && i + 3 <= n; i += 2)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(w + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(w + i + 1));
+            _mm_storeu_si128((__m128i *)(out + (i - word0)), _mm_or_si128(_mm_srli_epi64(a, 1), _mm_slli_epi64(b, 63)));
+        }
+#endif
+        for (; i < word1; i++)
+            out[i - word0] = w[i] >> 1 | (i + 1 < n ? w[i + 1] << 63 : 0);
+    }
+    else
+    {
+        size_t i = word0;
+        if (i == 0)
+            out[i++] = w[0] << 1;
+#if defined(__AVX2__)
+        for (; i + 4 <= word1; i += 4)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(w + i));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(w + i - 1));
+            _mm256_storeu_si256((__m256i *)(out + (i - word0)), _mm256_or_si256(_mm256_slli_epi64(a, 1), _mm256_srli_epi64(b, 63)));
+        }
+#elif defined(BITGRID_SSE2)
+        for (; i + 2 <= word1; i += 2)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(w + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(w + i - 1));
+            _mm_storeu_si128((__m128i *)(out + (i - word0)), _mm_or_si128(_mm_slli_epi64(a, 1), _mm_srli_epi64(b, 63)));
+        }
+#endif
+        for (; i < word1; i++)
+            out[i - word0] = w[i] << 1 | w[i - 1] >> 63;
+        const int tail = grid.width() & 63;
+        if (tail != 0 && word1 == n)
+            out[count - 1] &= bitRange(0, tail);
+    }
+}
+
+// spreads the low 16 bits of v to the even bits
+static uint32_t part1By1(uint32_t v)
+{
+    v &= 0xffffu;
+    v = (v | (v << 8)) & 0x00ff00ffu;
+    v = (v | (v << 4)) & 0x0f0f0f0fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+uint32_t MortonBitGrid::encode(int col, int row)
+{
+    return part1By1((uint32_t)col) | part1By1((uint32_t)row) << 1;
+}
+
+MortonBitGrid::MortonBitGrid(const BitGrid &grid) : width_(grid.width()), height_(grid.height())
+{
+    // at least 8x8, so every word is one whole block
+    side_ = 8;
+    while (side_ < std::max(width_, height_))
+        side_ *= 2;
+    words_.assign((size_t)side_ * (size_t)side_ / 64, 0);
+    for (int r = 0; r < height_; r++)
+    {
+        const uint64_t *w = grid.rowWords(r);
+        for (size_t i = 0; i < grid.wordsPerRow(); i++)
+            for (uint64_t bits = w[i]; bits; bits &= bits - 1)
+                set((int)(i * 64) + lowestBit64(bits), r);
+    }
+}
+
+void MortonBitGrid::set(int col, int row, bool value)
+{
+    uint32_t code = encode(col, row);
+    uint64_t &w = words_[code >> 6];
+    const uint64_t bit = 1ull << (code & 63);
+    w = value ? (w | bit) : (w & ~bit);
+}
+
+size_t MortonBitGrid::count() const
+{
+    size_t n = 0;
+    for (uint64_t w : words_)
+        n += (size_t)popcount64(w);
+    return n;
+}
+
+namespace
+{
+    // bits of an 8x8 block word whose in-block x (or y) lies in [lo, hi)
+    struct BlockMasks
+    {
+        uint64_t x[9][9];
+        uint64_t y[9][9];
+
+        BlockMasks()
+        {
+            for (int lo = 0; lo <= 8; lo++)
+                for (int hi = 0; hi <= 8; hi++)
+                {
+                    x[lo][hi] = y[lo][hi] = 0;
+                    for (int a = lo; a < hi; a++)
+                        for (int b = 0; b < 8; b++)
+                        {
+                            x[lo][hi] |= 1ull << MortonBitGrid::encode(a, b);
+                            y[lo][hi] |= 1ull << MortonBitGrid::encode(b, a);
+                        }
+                }
+        }
+    };
+    const BlockMasks kBlockMasks;
+} // namespace
+
+size_t MortonBitGrid::countRect(int col0, int row0, int col1, int row1) const
+{
+    col0 = std::max(col0, 0);
+    row0 = std::max(row0, 0);
+    col1 = std::min(col1, width_);
+    row1 = std::min(row1, height_);
+    size_t n = 0;
+    for (int by = row0 & ~7; by < row1; by += 8)
+    {
+        const uint64_t rows = kBlockMasks.y[std::max(row0 - by, 0)][std::min(row1 - by, 8)];
+        for (int bx = col0 & ~7; bx < col1; bx += 8)
+        {
+            const uint64_t cols = kBlockMasks.x[std::max(col0 - bx, 0)][std::min(col1 - bx, 8)];
+            n += (size_t)popcount64(words_[encode(bx, by) >> 6] & rows & cols);
+        }
+    }
+    return n;
+}
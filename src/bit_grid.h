@@ -0,0 +1,124 @@
+#pragma once
+
+#include "mapped_array.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+inline int popcount64(uint64_t v)
+{
+#if defined(_MSC_VER)
+    return (int)__popcnt64(v);
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+// Index of the lowest set bit; v must not be zero.
+inline int lowestBit64(uint64_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return (int)i;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// Occupancy grid with one bit per cell, bit (col & 63) of word col / 64 in
+// row-major rows. Rows are padded to whole 64-bit words and the padding bits
+// are always clear, so rows can be scanned, counted and shifted a word at a
+// time without looking at their neighbours' bits.
+class BitGrid
+{
+public:
+    BitGrid() = default;
+    BitGrid(int width, int height);
+    // Grid over words owned elsewhere, such as a mapped map file.
+    static BitGrid view(int width, int height, const uint64_t *words);
+    static size_t wordsPerRowFor(int width) { return ((size_t)width + 63) / 64; }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool empty() const { return width_ == 0 || height_ == 0; }
+    size_t wordsPerRow() const { return wordsPerRow_; }
+    const MappedArray<uint64_t> &words() const { return words_; }
+    size_t bytes() const { return words_.size() * sizeof(uint64_t); }
+
+    const uint64_t *rowWords(int row) const { return words_.data() + (size_t)row * wordsPerRow_; }
+    uint64_t *mutableRowWords(int row) { return words_.mutableData() + (size_t)row * wordsPerRow_; }
+
+    bool contains(int col, int row) const { return col >= 0 && row >= 0 && col < width_ && row < height_; }
+    // No bounds check.
+    bool get(int col, int row) const { return (rowWords(row)[col >> 6] >> (col & 63)) & 1u; }
+    void set(int col, int row, bool value = true);
+
+    // Set cells, by popcount over the words.
+    size_t count() const;
+    size_t countRow(int row, int col0, int col1) const;
+    size_t countRect(int col0, int row0, int col1, int row1) const;
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    size_t wordsPerRow_ = 0;
+    MappedArray<uint64_t> words_;
+};
+
+enum class GridSide
+{
+    PosX, // col + 1
+    NegX, // col - 1
+    PosZ, // row + 1
+    NegZ, // row - 1
+};
+
+// Bit c of out is the cell next to (c, row) on the given side; cells beyond
+// the grid read as clear. out holds wordsPerRow() words. The X sides shift
+// the row a vector of words at a time (SSE2, or AVX2 when enabled).
+void neighbourMask(const BitGrid &grid, int row, GridSide side, uint64_t *out);
+// Only words [word0, word1) of the same mask, written to out[0, word1 - word0).
+void neighbourMask(const BitGrid &grid, int row, GridSide side, uint64_t *out, size_t word0, size_t word1);
+
+// The same cells in Z (Morton) order over a power-of-two square: each word is
+// an 8x8 block, and blocks follow the Z curve as well, so cells near each
+// other in both directions share a word or a cache line. Area queries such as
+// collision probes touch fewer lines than in the row-major grid; full row
+// scans touch more.
+class MortonBitGrid
+{
+public:
+    MortonBitGrid() = default;
+    explicit MortonBitGrid(const BitGrid &grid);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int side() const { return side_; }
+    size_t bytes() const { return words_.size() * sizeof(uint64_t); }
+
+    static uint32_t encode(int col, int row);
+
+    bool contains(int col, int row) const { return col >= 0 && row >= 0 && col < width_ && row < height_; }
+    // No bounds check.
+    bool get(int col, int row) const
+    {
+        uint32_t code = encode(col, row);
+        return (words_[code >> 6] >> (code & 63)) & 1u;
+    }
+    void set(int col, int row, bool value = true);
+
+    size_t count() const;
+    size_t countRect(int col0, int row0, int col1, int row1) const;
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    int side_ = 0;
+    std::vector<uint64_t> words_;
+};
@@ -0,0 +1,355 @@
+#include "bvh.h"
+
+#include "collision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static constexpr int kBins = 16;
+static constexpr uint32_t kMaxLeafSize = 4;
+// cost of visiting a node relative to one box test
+static constexpr float kTraversalCost = 1.0f;
+
+namespace
+{
+    struct Bounds
+    {
+        glm::vec3 min{std::numeric_limits<float>::infinity()};
+        glm::vec3 max{-std::numeric_limits<float>::infinity()};
+
+        void grow(const glm::vec3 &p)
+        {
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+        void grow(const AABB &b)
+        {
+            grow(b.min);
+            grow(b.max);
+        }
+        void grow(const Bounds &b)
+        {
+            min = glm::min(min, b.min);
+            max = glm::max(max, b.max);
+        }
+        float area() const
+        {
+            if (min.x > max.x)
+                return 0.0f;
+            glm::vec3 e = max - min;
+            return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+    };
+
+    struct Builder
+    {
+        const MappedArray<AABB> &boxes;
+        std::vector<glm::vec3> centroids;
+        std::vector<uint32_t> order;
+        std::vector<BvhNode> nodes;
+
+        uint32_t makeLeaf(uint32_t node, uint32_t first, uint32_t count)
+        {
+            nodes[node].offset = first;
+            nodes[node].count = count;
+            return node;
+        }
+
+        uint32_t build(uint32_t first, uint32_t count, uint32_t depth)
+        {
+            uint32_t node = (uint32_t)nodes.size();
+            nodes.push_back({});
+
+            Bounds bounds, centers;
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                bounds.grow(boxes[order[i]]);
+                centers.grow(centroids[order[i]]);
+            }
+            for (int a = 0; a < 3; a++)
+            {
+                nodes[node].min[a] = bounds.min[a];
+                nodes[node].max[a] = bounds.max[a];
+            }
+            if (count <= 1 || depth >= kBvhMaxDepth)
+                return makeLeaf(node, first, count);
+
+            // binned SAH over the centroid extent, best axis and bin boundary
+            int bestAxis = -1, bestSplit = 0;
+            float bestCost = std::numeric_limits<float>::infinity();
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float lo = centers.min[axis], hi = centers.max[axis];
+                if (hi <= lo)
+                    continue;
+                Bounds binBounds[kBins];
+                uint32_t binCount[kBins] = {};
+                float scale = (float)kBins / (hi - lo);
+                for (uint32_t i = first; i < first + count; i++)
+                {
+                    int b = std::min(kBins - 1, (int)((centroids[order[i]][axis] - lo) * scale));
+                    binBounds[b].grow(boxes[order[i]]);
+                    binCount[b]++;
+                }
+
+                float rightArea[kBins];
+                uint32_t rightCount[kBins];
+                Bounds acc;
+                uint32_t n = 0;
+                for (int b = kBins - 1; b > 0; b--)
+                {
+                    acc.grow(binBounds[b]);
+                    n += binCount[b];
+                    rightArea[b] = acc.area();
+                    rightCount[b] = n;
+                }
+                acc = Bounds();
+                n = 0;
+                for (int b = 0; b < kBins - 1; b++)
+                {
+                    acc.grow(binBounds[b]);
+                    n += binCount[b];
+                    float cost = acc.area() * (float)n + rightArea[b + 1] * (float)rightCount[b + 1];
+                    if (n > 0 && rightCount[b + 1] > 0 && cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = b + 1;
+                    }
+                }
+            }
+
+            float leafCost = (float)count;
+            float splitCost = kTraversalCost + bestCost / std::max(bounds.area(), 1e-12f);
+            if (bestAxis < 0 || (count <= kMaxLeafSize && splitCost >= leafCost))
+            {
+                if (bestAxis < 0 && count > kMaxLeafSize)
+                {
+                    // all centroids coincide: split the range in half
+                    uint32_t half = count / 2;
+                    build(first, half, depth + 1);
+                    nodes[node].offset = build(first + half, count - half, depth + 1);
+                    nodes[node].count = 0;
+                    return node;
+                }
+                return makeLeaf(node, first, count);
+            }
+
+            float lo = centers.min[bestAxis];
+            float scale = (float)kBins / (centers.max[bestAxis] - lo);
+            auto mid = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t id)
+                                      { return std::min(kBins - 1, (int)((centroids[id][bestAxis] - lo) * scale)) < bestSplit; });
+            uint32_t leftCount = (uint32_t)(mid - (order.begin() + first));
+
+            build(first, leftCount, depth + 1);
+            uint32_t right = build(first + leftCount, count - leftCount, depth + 1);
+            nodes[node].offset = right;
+            nodes[node].count = 0;
+            return node;
+        }
+    };
+
+    // The node slab test does exactly what rayAABB does per axis, so a node's
+    // interval always contains the intervals of the boxes under it and pruning
+    // never drops a hit rayAABB would report.
+    struct RayInv
+    {
+        glm::vec3 origin;
+        glm::vec3 inv;
+        bool flat[3];
+    };
+
+    static RayInv prepareRay(const glm::vec3 &origin, const glm::vec3 &dir)
+    {
+        RayInv r;
+        r.origin = origin;
+        for (int a = 0; a < 3; a++)
+        {
+            r.flat[a] = std::fabs(dir[a]) < 1e-6f;
+            r.inv[a] = r.flat[a] ? 0.0f : 1.0f / dir[a];
+        }
+        return r;
+    }
+
+    static bool rayNode(const RayInv &r, const BvhNode &n, float &tNear)
+    {
+        float tmin = 0.0f;
+        float tmax = std::numeric_limits<float>::infinity();
+        for (int a = 0; a < 3; a++)
+        {
+            if (r.flat[a])
+            {
+                if (r.origin[a] < n.min[a] || r.origin[a] > n.max[a])
+                    return false;
+                continue;
+            }
+            float t1 = (n.min[a] - r.origin[a]) * r.inv[a];
+            float t2 = (n.max[a] - r.origin[a]) * r.inv[a];
+            if (t1 > t2)
+                std::swap(t1, t2);
+            tmin = std::max(tmin, t1);
+            tmax = std::min(tmax, t2);
+            if (tmin > tmax)
+                return false;
+        }
+        tNear = tmin;
+        return tmax >= 0.0f;
+    }
+
+    static AABB nodeBox(const BvhNode &n)
+    {
+        return {{n.min[0], n.min[1], n.min[2]}, {n.max[0], n.max[1], n.max[2]}};
+    }
+
+    static constexpr int kStackSize = 64;
+} // namespace
+
+Bvh buildBvh(const MappedArray<AABB> &boxes)
+{
+    Bvh bvh;
+    if (boxes.empty())
+        return bvh;
+
+    Builder b{boxes, {}, {}, {}};
+    b.centroids.resize(boxes.size());
+    b.order.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        b.centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+        b.order[i] = (uint32_t)i;
+    }
+    b.nodes.reserve(2 * boxes.size());
+    b.build(0, (uint32_t)boxes.size(), 0);
+
+    bvh.nodes = std::move(b.nodes);
+    bvh.ids = std::move(b.order);
+    bvh.boxes.reserve(boxes.size());
+    for (uint32_t id : bvh.ids)
+        bvh.boxes.push_back(boxes[id]);
+    return bvh;
+}
+
+float bvhClosestHit(const Bvh &bvh, const glm::vec3 &origin, const glm::vec3 &dir, int *hitIndex)
+{
+    float best = std::numeric_limits<float>::infinity();
+    int bestIndex = -1;
+    if (bvh.nodes.empty())
+        return best;
+
+    RayInv ray = prepareRay(origin, dir);
+    uint32_t stack[kStackSize];
+    int top = 0;
+    float t = 0.0f;
+    if (rayNode(ray, bvh.nodes[0], t))
+        stack[top++] = 0;
+
+    while (top > 0)
+    {
+        const BvhNode &n = bvh.nodes[stack[--top]];
+        if (n.count > 0)
+        {
+            for (uint32_t i = n.offset; i < n.offset + n.count; i++)
+                if (rayAABB(origin, dir, bvh.boxes[i], t) && t >= 0.0f && t < best)
+                {
+                    best = t;
+                    bestIndex = (int)bvh.ids[i];
+                }
+            continue;
+        }
+
+        // push the farther child first so the nearer one is popped next
+        uint32_t left = (uint32_t)(&n - bvh.nodes.data()) + 1;
+        uint32_t right = n.offset;
+        float tl = 0.0f, tr = 0.0f;
+        bool hl = rayNode(ray, bvh.nodes[left], tl) && tl < best;
+        bool hr = rayNode(ray, bvh.nodes[right], tr) && tr < best;
+        if (hl && hr)
+        {
+            if (tl <= tr)
+            {
+                stack[top++] = right;
+                stack[top++] = left;
+            }
+            else
+            {
+                stack[top++] = left;
+                stack[top++] = right;
+            }
+        }
+        else if (hl)
+            stack[top++] = left;
+        else if (hr)
+            stack[top++] = right;
+    }
+
+    if (hitIndex)
+        *hitIndex = bestIndex;
+    return best;
+}
+
+bool bvhAnyHit(const Bvh &bvh, const glm::vec3 &origin, const glm::vec3 &dir, float maxT)
+{
+    if (bvh.nodes.empty())
+        return false;
+
+    RayInv ray = prepareRay(origin, dir);
+    uint32_t stack[kStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    float t = 0.0f;
+    while (top > 0)
+    {
+        uint32_t index = stack[--top];
+        const BvhNode &n = bvh.nodes[index];
+        if (!rayNode(ray, n, t) || t >= maxT)
+            continue;
+        if (n.count > 0)
+        {
+            for (uint32_t i = n.offset; i < n.offset + n.count; i++)
+                if (rayAABB(origin, dir, bvh.boxes[i], t) && t >= 0.0f && t < maxT)
+                    return true;
+            continue;
+        }
+        stack[top++] = n.offset;
+        stack[top++] = index + 1;
+    }
+    return false;
+}
+
+bool bvhOverlapsCircleXZ(const Bvh &bvh, const glm::vec3 &pos, float radius)
+{
+    if (bvh.nodes.empty())
+        return false;
+
+    uint32_t stack[kStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        uint32_t index = stack[--top];
+        const BvhNode &n = bvh.nodes[index];
+        // the circle reaches the node whenever it reaches any box inside it
+        if (!circleIntersectsAABB_XZ(pos, radius, nodeBox(n)))
+            continue;
+        if (n.count > 0)
+        {
+            for (uint32_t i = n.offset; i < n.offset + n.count; i++)
+                if (circleIntersectsAABB_XZ(pos, radius, bvh.boxes[i]))
+                    return true;
+            continue;
+        }
+        stack[top++] = n.offset;
+        stack[top++] = index + 1;
+    }
+    return false;
+}
+
+bool bvhLineOfSight(const Bvh &bvh, const glm::vec3 &from, const glm::vec3 &to)
+{
+    glm::vec3 d = to - from;
+    float dist = glm::length(d);
+    if (dist <= 0.0f)
+        return true;
+    return !bvhAnyHit(bvh, from, d / dist, dist);
+}
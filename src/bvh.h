@@ -0,0 +1,51 @@
+#pragma once
+
+#include "maze.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// One BVH node in 32 bytes, so two share a cache line. Nodes are laid out
+// depth first: an inner node's left child directly follows it and `offset`
+// is its right child; a leaf covers boxes [offset, offset + count).
+struct alignas(32) BvhNode
+{
+    float min[3];
+    uint32_t offset;
+    float max[3];
+    uint32_t count; // 0 for inner nodes
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode must stay 32 bytes");
+
+// Deepest node buildBvh makes (the root is depth 0): deeper ranges become
+// larger leaves. The traversal stacks are sized for it, so loaded trees must
+// not go deeper either.
+constexpr uint32_t kBvhMaxDepth = 48;
+
+// Bounding volume hierarchy over arbitrary AABBs, built with a binned
+// surface area heuristic. Unlike the occupancy grid it makes no assumption
+// about the boxes being grid-aligned, disjoint or of one size.
+struct Bvh
+{
+    MappedArray<BvhNode> nodes;
+    // the input boxes in leaf order, and their index in the input array
+    MappedArray<AABB> boxes;
+    MappedArray<uint32_t> ids;
+    // keeps the map file alive while the arrays above view it
+    std::shared_ptr<const void> mapping;
+};
+
+Bvh buildBvh(const MappedArray<AABB> &boxes);
+
+// Nearest rayAABB hit over all boxes, the same t a linear scan returns, or
+// infinity on a miss. hitIndex (optional) receives the input index of that box.
+float bvhClosestHit(const Bvh &bvh, const glm::vec3 &origin, const glm::vec3 &dir, int *hitIndex = nullptr);
+// Whether any box is hit before maxT; stops at the first one found.
+bool bvhAnyHit(const Bvh &bvh, const glm::vec3 &origin, const glm::vec3 &dir, float maxT);
+// Same answer as circleIntersectsAABB_XZ against every box.
+bool bvhOverlapsCircleXZ(const Bvh &bvh, const glm::vec3 &pos, float radius);
+// True when no box lies on the segment between the two points.
+bool bvhLineOfSight(const Bvh &bvh, const glm::vec3 &from, const glm::vec3 &to);
@@ -3,6 +3,15 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+// Per-frame camera data, std140 layout of the "Camera" uniform block
+// declared by every shader (bound to kCameraBlockBinding, see shader.h).
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 position;
+};
+
 enum Movement { FORWARD, BACKWARD, LEFT, RIGHT };
 
 class Camera {
@@ -0,0 +1,239 @@
+#include "chunk_stream.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+size_t ChunkData::bytes() const
+{
+    return sizeof(*this) + mesh.vertices.capacity() * sizeof(float) + mesh.indices.capacity() * sizeof(unsigned int) +
+           mesh.ranges.capacity() * sizeof(WallMeshRange) + walls.capacity() * sizeof(AABB) +
+           (grid ? sizeof(ChunkGrid) + grid->solid.bytes() : 0);
+}
+
+namespace
+{
+    static ChunkData chunkRect(const Maze &maze, int chunkCells, uint32_t id)
+    {
+        const int chunksX = (maze.gridWidth + chunkCells - 1) / chunkCells;
+        ChunkData c;
+        c.id = id;
+        c.col0 = (int)(id % (uint32_t)chunksX) * chunkCells;
+        c.row0 = (int)(id / (uint32_t)chunksX) * chunkCells;
+        c.col1 = std::min(maze.gridWidth, c.col0 + chunkCells);
+        c.row1 = std::min(maze.gridHeight, c.row0 + chunkCells);
+        return c;
+    }
+
+    // The chunk's occupancy and its border; wordAt(row, word) returns a word
+    // of the maze's grid and is only asked about rows and words inside it.
+    template <typename WordAt>
+    static std::shared_ptr<const ChunkGrid> chunkGrid(const Maze &maze, const ChunkData &c, WordAt wordAt)
+    {
+        auto g = std::make_shared<ChunkGrid>();
+        const int firstWord = c.col0 / 64 - 1, lastWord = (c.col1 - 1) / 64 + 1;
+        g->col0 = firstWord * 64;
+        g->row0 = c.row0 - 1;
+        g->solid = BitGrid((lastWord - firstWord + 1) * 64, c.row1 - c.row0 + 2);
+        const int mazeWords = (int)BitGrid::wordsPerRowFor(maze.gridWidth);
+        for (int r = 0; r < g->solid.height(); r++)
+        {
+            const int row = g->row0 + r;
+            if (row < 0 || row >= maze.gridHeight)
+                continue;
+            uint64_t *out = g->solid.mutableRowWords(r);
+            for (int word = std::max(firstWord, 0); word <= std::min(lastWord, mazeWords - 1); word++)
+                out[word - firstWord] = wordAt(row, word);
+        }
+        return g;
+    }
+
+    // the mesh from the chunk's own grid, and bounds around it all
+    static void finishChunk(const Maze &maze, ChunkData &c)
+    {
+        c.mesh = bakeWallMesh(maze, c.grid->solid, c.grid->col0, c.grid->row0, c.col0, c.row0, c.col1, c.row1);
+        // a chunk without walls still gets its floor area, so it culls sensibly
+        c.box.min = cellBox(maze, c.col0, c.row0).min;
+        c.box.max = cellBox(maze, c.col1 - 1, c.row1 - 1).max;
+        if (c.walls.empty())
+            c.box.max.y = c.box.min.y;
+    }
+} // namespace
+
+ChunkData buildChunk(const Maze &maze, int chunkCells, uint32_t id)
+{
+    ChunkData c = chunkRect(maze, chunkCells, id);
+    c.grid = chunkGrid(maze, c, [&](int row, int word)
+                       { return maze.solid.rowWords(row)[word]; });
+    mergeWallCells(maze, c.col0, c.row0, c.col1, c.row1, c.walls);
+    finishChunk(maze, c);
+    return c;
+}
+
+ChunkData loadChunk(const MapFile &map, const Maze &maze, uint32_t id)
+{
+    const int cells = map.chunkCells(), rowWords = cells / 64;
+    ChunkData c = chunkRect(maze, cells, id);
+    c.grid = chunkGrid(maze, c, [&](int row, int word)
+                       {
+                           const int cx = word / rowWords, cy = row / cells;
+                           const uint64_t *block = map.chunkSolid((uint32_t)(cy * map.chunksX() + cx));
+                           return block[(size_t)(row - cy * cells) * rowWords + (size_t)(word - cx * rowWords)]; });
+    const uint32_t *first = map.chunkWallFirst();
+    c.walls.assign(map.chunkWalls() + first[id], map.chunkWalls() + first[id + 1]);
+    finishChunk(maze, c);
+    return c;
+}
+
+bool ChunkGridSet::wallAt(int col, int row) const
+{
+    auto it = grids.find((uint32_t)((row / chunkCells) * chunksX + col / chunkCells));
+    return it == grids.end() || it->second->wall(col, row);
+}
+
+ChunkStreamer::ChunkStreamer(const Maze &maze, const ChunkStreamParams &params, std::shared_ptr<const MapFile> map)
+    : maze(maze), params_(params)
+{
+    params_.chunkCells = std::max(1, params_.chunkCells);
+    params_.radius = std::max(0, params_.radius);
+    const size_t side = (size_t)(2 * params_.radius + 1);
+    params_.budget = std::max(params_.budget, side * side);
+    params_.maxLoadsPerUpdate = std::max<size_t>(1, params_.maxLoadsPerUpdate);
+    chunksX_ = (maze.gridWidth + params_.chunkCells - 1) / params_.chunkCells;
+    chunksY_ = (maze.gridHeight + params_.chunkCells - 1) / params_.chunkCells;
+    if (map && map->hasChunks() && map->chunkCells() == params_.chunkCells && map->header().gridWidth == maze.gridWidth &&
+        map->header().gridHeight == maze.gridHeight)
+        this->map = std::move(map);
+    auto empty = std::make_shared<ChunkGridSet>();
+    empty->chunkCells = params_.chunkCells;
+    empty->chunksX = chunksX_;
+    grids = std::move(empty);
+    loader = std::thread([this]
+                         { loaderLoop(); });
+}
+
+ChunkStreamer::~ChunkStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+    }
+    wake.notify_all();
+    loader.join();
+}
+
+void ChunkStreamer::loaderLoop()
+{
+    std::unique_lock<std::mutex> lock(m);
+    for (;;)
+    {
+        wake.wait(lock, [&]
+                  { return stopping || !queue.empty(); });
+        if (stopping)
+            return;
+        uint32_t id = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        auto chunk = std::make_unique<ChunkData>(map ? loadChunk(*map, maze, id) : buildChunk(maze, params_.chunkCells, id));
+        lock.lock();
+        ready.push_back(std::move(chunk));
+    }
+}
+
+std::shared_ptr<const ChunkGridSet> ChunkStreamer::residentGrids() const
+{
+    std::lock_guard<std::mutex> lock(m);
+    return grids;
+}
+
+bool ChunkStreamer::isWanted(uint32_t id, int eyeX, int eyeY) const
+{
+    int x = (int)(id % (uint32_t)chunksX_), y = (int)(id / (uint32_t)chunksX_);
+    return std::abs(x - eyeX) <= params_.radius && std::abs(y - eyeY) <= params_.radius;
+}
+
+void ChunkStreamer::update(const glm::vec3 &eye, std::vector<std::unique_ptr<ChunkData>> &loaded, std::vector<uint32_t> &evicted)
+{
+    if (chunksX_ <= 0 || chunksY_ <= 0)
+        return;
+
+    // the camera's chunk, clamped so a camera outside the grid still streams its edge
+    int col, row;
+    worldToCell(maze, eye.x, eye.z, col, row);
+    const int eyeX = std::clamp(col < 0 ? -1 : col / params_.chunkCells, 0, chunksX_ - 1);
+    const int eyeY = std::clamp(row < 0 ? -1 : row / params_.chunkCells, 0, chunksY_ - 1);
+
+    // nearest first, so they are loaded first and end up at the front of the LRU
+    wanted.clear();
+    const int r = params_.radius;
+    for (int y = std::max(0, eyeY - r); y <= std::min(chunksY_ - 1, eyeY + r); y++)
+        for (int x = std::max(0, eyeX - r); x <= std::min(chunksX_ - 1, eyeX + r); x++)
+            wanted.push_back((uint32_t)(y * chunksX_ + x));
+    auto distance = [&](uint32_t id)
+    {
+        int dx = (int)(id % (uint32_t)chunksX_) - eyeX, dy = (int)(id / (uint32_t)chunksX_) - eyeY;
+        return dx * dx + dy * dy;
+    };
+    std::stable_sort(wanted.begin(), wanted.end(), [&](uint32_t a, uint32_t b)
+                     { return distance(a) < distance(b); });
+
+    // queued requests that did not start yet are re-issued below if still wanted
+    std::vector<std::unique_ptr<ChunkData>> finished;
+    {
+        std::lock_guard<std::mutex> lock(m);
+        for (uint32_t id : queue)
+            requested.erase(id);
+        queue.clear();
+        while (!ready.empty() && finished.size() < params_.maxLoadsPerUpdate)
+        {
+            finished.push_back(std::move(ready.front()));
+            ready.pop_front();
+        }
+    }
+    std::vector<const ChunkData *> added;
+    for (auto &chunk : finished)
+    {
+        requested.erase(chunk->id);
+        if (!isWanted(chunk->id, eyeX, eyeY) || isResident(chunk->id))
+            continue;
+        lru.push_front(chunk->id);
+        lruIndex[chunk->id] = lru.begin();
+        added.push_back(chunk.get());
+        loaded.push_back(std::move(chunk));
+    }
+
+    for (auto it = wanted.rbegin(); it != wanted.rend(); ++it)
+    {
+        auto found = lruIndex.find(*it);
+        if (found != lruIndex.end())
+            lru.splice(lru.begin(), lru, found->second);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m);
+        for (uint32_t id : wanted)
+            if (!isResident(id) && requested.insert(id).second)
+                queue.push_back(id);
+    }
+    wake.notify_one();
+
+    // every wanted chunk is at the front, so the back is never one of them
+    const size_t evictedBefore = evicted.size();
+    while (lruIndex.size() > params_.budget)
+    {
+        uint32_t id = lru.back();
+        lru.pop_back();
+        lruIndex.erase(id);
+        evicted.push_back(id);
+    }
+
+    // publish the new resident set; readers keep the old one as long as they hold it
+    if (added.empty() && evicted.size() == evictedBefore)
+        return;
+    auto next = std::make_shared<ChunkGridSet>(*grids);
+    for (const ChunkData *c : added)
+        next->grids[c->id] = c->grid;
+    for (size_t i = evictedBefore; i < evicted.size(); i++)
+        next->grids.erase(evicted[i]);
+    std::lock_guard<std::mutex> lock(m);
+    grids = std::move(next);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "map_file.h"
+#include "maze.h"
+#include "wall_mesh.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct ChunkStreamParams
+{
+    // cells per chunk side
+    int chunkCells = 64;
+    // chunks kept loaded around the camera's chunk, in each direction
+    int radius = 2;
+    // most chunks resident at once; raised to cover the radius if smaller
+    size_t budget = 49;
+    // most finished chunks handed to the consumer per update, so a burst of
+    // loads is spread over several frames
+    size_t maxLoadsPerUpdate = 4;
+};
+
+// Occupancy of one chunk, with a border of one row above and below and one
+// word (64 columns) on either side, so baking the chunk's faces needs nothing
+// else. Cells past the maze are open.
+struct ChunkGrid
+{
+    // maze cell of solid's (0, 0); col0 is a multiple of 64
+    int col0 = 0, row0 = 0;
+    BitGrid solid;
+
+    bool wall(int col, int row) const { return solid.contains(col - col0, row - row0) && solid.get(col - col0, row - row0); }
+};
+
+// Everything one chunk of the maze needs, built off the render thread: its
+// wall cells' mesh (one range per cell, for culling), its wall cells merged
+// into outline boxes, the bounds of both, and its occupancy for collision.
+struct ChunkData
+{
+    uint32_t id = 0; // row-major chunk index
+    int col0 = 0, row0 = 0, col1 = 0, row1 = 0;
+    AABB box{};
+    WallMeshData mesh;
+    std::vector<AABB> walls;
+    std::shared_ptr<const ChunkGrid> grid;
+
+    size_t bytes() const;
+};
+
+// From the maze's own grid and walls.
+ChunkData buildChunk(const Maze &maze, int chunkCells, uint32_t id);
+// From a map file's chunk sections, reading only that chunk's block and the
+// border words of its neighbours; maze only places the boxes.
+ChunkData loadChunk(const MapFile &map, const Maze &maze, uint32_t id);
+
+// The occupancy of the chunks resident at one moment. Cells of chunks that
+// are not resident count as walls, so nothing moves or sees past what is
+// loaded.
+struct ChunkGridSet
+{
+    int chunkCells = 0;
+    int chunksX = 0;
+    std::unordered_map<uint32_t, std::shared_ptr<const ChunkGrid>> grids;
+
+    bool wallAt(int col, int row) const;
+};
+
+// Streams chunks around the camera. A loader thread builds the missing
+// chunks nearest first, from the map file's chunk sections when it has them
+// at this chunk size; the consumer (the render thread, which owns the GL
+// buffers) calls update() once per frame to collect finished chunks and the
+// ids it must drop. Resident chunks are kept in least-recently-wanted order
+// and evicted from the back once there are more than the budget, so render
+// and collision memory and per-frame cost depend on the radius, not on the
+// map size. Navigation (flow field, path graph, regions) still reads the
+// maze's whole-map arrays.
+class ChunkStreamer
+{
+public:
+    ChunkStreamer(const Maze &maze, const ChunkStreamParams &params, std::shared_ptr<const MapFile> map = nullptr);
+    ~ChunkStreamer();
+    ChunkStreamer(const ChunkStreamer &) = delete;
+    ChunkStreamer &operator=(const ChunkStreamer &) = delete;
+
+    int chunksX() const { return chunksX_; }
+    int chunksY() const { return chunksY_; }
+    const ChunkStreamParams &params() const { return params_; }
+
+    // Consumer thread only. Appends the chunks that became resident to loaded
+    // and the ids that were evicted to evicted.
+    void update(const glm::vec3 &eye, std::vector<std::unique_ptr<ChunkData>> &loaded, std::vector<uint32_t> &evicted);
+
+    size_t residentCount() const { return lruIndex.size(); }
+    // requested and not yet handed out
+    size_t pendingCount() const { return requested.size(); }
+    bool isResident(uint32_t id) const { return lruIndex.count(id) != 0; }
+    // Any thread. The resident chunks' occupancy as of the last update().
+    std::shared_ptr<const ChunkGridSet> residentGrids() const;
+
+private:
+    const Maze &maze;
+    std::shared_ptr<const MapFile> map; // null unless its chunks are used
+    ChunkStreamParams params_;
+    int chunksX_ = 0, chunksY_ = 0;
+
+    // consumer state
+    std::list<uint32_t> lru; // most recently wanted first
+    std::unordered_map<uint32_t, std::list<uint32_t>::iterator> lruIndex;
+    std::unordered_set<uint32_t> requested;
+    std::vector<uint32_t> wanted;
+
+    // shared with the loader thread
+    mutable std::mutex m;
+    std::condition_variable wake;
+    std::deque<uint32_t> queue;
+    std::deque<std::unique_ptr<ChunkData>> ready;
+    std::shared_ptr<const ChunkGridSet> grids;
+    bool stopping = false;
+    std::thread loader;
+
+    void loaderLoop();
+    bool isWanted(uint32_t id, int eyeX, int eyeY) const;
+};
@@ -0,0 +1,242 @@
+#include "collision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static float clampf(float v, float lo, float hi)
+{
+    if (v < lo)
+        return lo;
+    if (v > hi)
+        return hi;
+    return v;
+}
+
+bool circleIntersectsAABB_XZ(const glm::vec3 &pos, float radius, const AABB &box)
+{
+    float closestX = clampf(pos.x, box.min.x, box.max.x);
+    float closestZ = clampf(pos.z, box.min.z, box.max.z);
+    float dx = pos.x - closestX;
+    float dz = pos.z - closestZ;
+    return dx * dx + dz * dz < radius * radius;
+}
+
+bool rayAABB(const glm::vec3 &origin, const glm::vec3 &dir, const AABB &box, float &tHit)
+{
+    float tmin = 0.0f;
+    float tmax = std::numeric_limits<float>::infinity();
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float o = origin[axis];
+        float d = dir[axis];
+        float mn = box.min[axis];
+        float mx = box.max[axis];
+
+        if (std::fabs(d) < 1e-6f)
+        {
+            if (o < mn || o > mx)
+                return false;
+            continue;
+        }
+
+        float inv = 1.0f / d;
+        float t1 = (mn - o) * inv;
+        float t2 = (mx - o) * inv;
+        if (t1 > t2)
+            std::swap(t1, t2);
+        tmin = std::max(tmin, t1);
+        tmax = std::min(tmax, t2);
+        if (tmin > tmax)
+            return false;
+    }
+
+    tHit = tmin;
+    return tmax >= 0.0f;
+}
+
+bool raySphere(const glm::vec3 &origin, const glm::vec3 &dir, const glm::vec3 &center, float radius, float &tHit)
+{
+    glm::vec3 oc = origin - center;
+    float b = glm::dot(oc, dir);
+    float c = glm::dot(oc, oc) - radius * radius;
+    float h = b * b - c;
+    if (h < 0.0f)
+        return false;
+    h = std::sqrt(h);
+
+    float t0 = -b - h;
+    float t1 = -b + h;
+    if (t1 < 0.0f)
+        return false;
+    tHit = (t0 >= 0.0f) ? t0 : t1;
+    return true;
+}
+
+// The grid queries take the occupancy as wallAt(col, row), called only for
+// cells inside the grid, so Maze::solid and streamed chunks share one walk.
+template <typename WallAt>
+static bool isBlockedBy(const Maze &maze, const glm::vec3 &pos, float radius, const WallAt &wallAt)
+{
+    int c0 = 0, r0 = 0, c1 = 0, r1 = 0;
+    worldToCell(maze, pos.x - radius, pos.z - radius, c0, r0);
+    worldToCell(maze, pos.x + radius, pos.z + radius, c1, r1);
+
+    for (int r = r0; r <= r1; r++)
+        for (int c = c0; c <= c1; c++)
+            if (c >= 0 && r >= 0 && c < maze.gridWidth && r < maze.gridHeight && wallAt(c, r) &&
+                circleIntersectsAABB_XZ(pos, radius, cellBox(maze, c, r)))
+                return true;
+    return false;
+}
+
+bool isBlocked(const Maze &maze, const glm::vec3 &pos, float radius)
+{
+    return isBlockedBy(maze, pos, radius, [&](int c, int r)
+                       { return maze.solid.get(c, r); });
+}
+
+bool isBlocked(const Maze &maze, const glm::vec3 &pos, float radius, const std::function<bool(int, int)> &wallAt)
+{
+    return isBlockedBy(maze, pos, radius, wallAt);
+}
+
+bool isBlockedLinear(const Maze &maze, const glm::vec3 &pos, float radius)
+{
+    for (const auto &w : maze.walls)
+        if (circleIntersectsAABB_XZ(pos, radius, w))
+            return true;
+    return false;
+}
+
+template <typename WallAt>
+static void testWallCell(const Maze &maze, const WallAt &wallAt, int col, int row, const glm::vec3 &origin, const glm::vec3 &dir,
+                         float &best)
+{
+    if (col < 0 || row < 0 || col >= maze.gridWidth || row >= maze.gridHeight || !wallAt(col, row))
+        return;
+    float t = 0.0f;
+    if (rayAABB(origin, dir, cellBox(maze, col, row), t) && t >= 0.0f)
+        best = std::min(best, t);
+}
+
+template <typename WallAt>
+static float nearestWallTBy(const Maze &maze, const glm::vec3 &origin, const glm::vec3 &dir, const WallAt &wallAt)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    if (maze.gridWidth <= 0 || maze.gridHeight <= 0)
+        return inf;
+
+    // clip the ray to the slab every wall lives in (grid footprint x [0, wallHeight])
+    AABB bounds;
+    bounds.min = cellBox(maze, 0, 0).min;
+    bounds.max = cellBox(maze, maze.gridWidth - 1, maze.gridHeight - 1).max;
+    float tEnter = 0.0f;
+    float tExit = inf;
+    if (!rayAABB(origin, dir, bounds, tEnter))
+        return inf;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (std::fabs(dir[axis]) < 1e-6f)
+            continue;
+        float bound = dir[axis] > 0.0f ? bounds.max[axis] : bounds.min[axis];
+        tExit = std::min(tExit, (bound - origin[axis]) / dir[axis]);
+    }
+
+    const float cs = maze.cellSize;
+    glm::vec3 start = origin + dir * tEnter;
+    int col = 0, row = 0;
+    worldToCell(maze, start.x, start.z, col, row);
+    col = std::min(std::max(col, 0), maze.gridWidth - 1);
+    row = std::min(std::max(row, 0), maze.gridHeight - 1);
+
+    const float gridMinX = -(float)maze.gridWidth * 0.5f * cs;
+    const float gridMinZ = -(float)maze.gridHeight * 0.5f * cs;
+
+    int stepX = dir.x > 0.0f ? 1 : -1;
+    int stepZ = dir.z > 0.0f ? 1 : -1;
+    float tMaxX = inf, tDeltaX = inf;
+    float tMaxZ = inf, tDeltaZ = inf;
+    if (std::fabs(dir.x) >= 1e-6f)
+    {
+        float boundary = gridMinX + (float)(col + (stepX > 0 ? 1 : 0)) * cs;
+        tMaxX = (boundary - origin.x) / dir.x;
+        tDeltaX = cs / std::fabs(dir.x);
+    }
+    if (std::fabs(dir.z) >= 1e-6f)
+    {
+        float boundary = gridMinZ + (float)(row + (stepZ > 0 ? 1 : 0)) * cs;
+        tMaxZ = (boundary - origin.z) / dir.z;
+        tDeltaZ = cs / std::fabs(dir.z);
+    }
+
+    // the ray may start on (or a rounding error away from) a cell edge and so
+    // already touch a neighbouring wall at t = 0
+    float best = inf;
+    const AABB startBox = cellBox(maze, col, row);
+    const float edgeEps = 1e-4f * cs;
+    int dc0 = start.x - startBox.min.x < edgeEps ? -1 : 0;
+    int dc1 = startBox.max.x - start.x < edgeEps ? 1 : 0;
+    int dr0 = start.z - startBox.min.z < edgeEps ? -1 : 0;
+    int dr1 = startBox.max.z - start.z < edgeEps ? 1 : 0;
+    for (int dr = dr0; dr <= dr1; dr++)
+        for (int dc = dc0; dc <= dc1; dc++)
+            if (dc != 0 || dr != 0)
+                testWallCell(maze, wallAt, col + dc, row + dr, origin, dir, best);
+
+    for (;;)
+    {
+        testWallCell(maze, wallAt, col, row, origin, dir, best);
+
+        // every later cell is entered at or after this cell's exit
+        float tCellExit = std::min(tMaxX, tMaxZ);
+        if (best <= tCellExit || tCellExit > tExit)
+            break;
+
+        // passing (almost) exactly through a corner: the diagonal neighbour we
+        // do not step into still touches the ray, so test it as well
+        if (std::fabs(tMaxX - tMaxZ) <= 1e-5f * std::max(1.0f, tCellExit))
+        {
+            testWallCell(maze, wallAt, col + stepX, row, origin, dir, best);
+            testWallCell(maze, wallAt, col, row + stepZ, origin, dir, best);
+        }
+
+        if (tMaxX < tMaxZ)
+        {
+            col += stepX;
+            tMaxX += tDeltaX;
+        }
+        else
+        {
+            row += stepZ;
+            tMaxZ += tDeltaZ;
+        }
+        if (col < 0 || row < 0 || col >= maze.gridWidth || row >= maze.gridHeight)
+            break;
+    }
+    return best;
+}
+
+float nearestWallT(const Maze &maze, const glm::vec3 &origin, const glm::vec3 &dir)
+{
+    return nearestWallTBy(maze, origin, dir, [&](int c, int r)
+                          { return maze.solid.get(c, r); });
+}
+
+float nearestWallT(const Maze &maze, const glm::vec3 &origin, const glm::vec3 &dir, const std::function<bool(int, int)> &wallAt)
+{
+    return nearestWallTBy(maze, origin, dir, wallAt);
+}
+
+float nearestWallTLinear(const Maze &maze, const glm::vec3 &origin, const glm::vec3 &dir)
+{
+    float best = std::numeric_limits<float>::infinity();
+    for (const auto &w : maze.walls)
+    {
+        float t = 0.0f;
+        if (rayAABB(origin, dir, w, t) && t >= 0.0f)
+            best = std::min(best, t);
+    }
+    return best;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "maze.h"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+
+bool circleIntersectsAABB_XZ(const glm::vec3 &pos, float radius, const AABB &box);
+bool rayAABB(const glm::vec3 &origin, const glm::vec3 &dir, const AABB &box, float &tHit);
+bool raySphere(const glm::vec3 &origin, const glm::vec3 &dir, const glm::vec3 &center, float radius, float &tHit);
+
+// Tests only the occupancy cells the circle overlaps, O(1) in the wall count.
+bool isBlocked(const Maze &maze, const glm::vec3 &pos, float radius);
+// Reference brute-force version over every entry in Maze::walls.
+bool isBlockedLinear(const Maze &maze, const glm::vec3 &pos, float radius);
+
+// Walks the occupancy grid cell by cell (DDA) and stops at the first wall,
+// so the cost depends on the ray length rather than the wall count.
+// Returns the same t as nearestWallTLinear, or infinity on a miss.
+float nearestWallT(const Maze &maze, const glm::vec3 &origin, const glm::vec3 &dir);
+float nearestWallTLinear(const Maze &maze, const glm::vec3 &origin, const glm::vec3 &dir);
+
+// The grid queries above with occupancy kept outside Maze::solid, such as the
+// resident chunks of a streamed map: wallAt(col, row) is asked about cells
+// inside the grid, and maze only gives the grid's size and placement.
+bool isBlocked(const Maze &maze, const glm::vec3 &pos, float radius, const std::function<bool(int, int)> &wallAt);
+float nearestWallT(const Maze &maze, const glm::vec3 &origin, const glm::vec3 &dir, const std::function<bool(int, int)> &wallAt);
@@ -0,0 +1,132 @@
+#include "flow_field.h"
+
+#include <algorithm>
+#include <limits>
+
+static const int kStepCol[4] = {1, -1, 0, 0};
+static const int kStepRow[4] = {0, 0, 1, -1};
+
+FlowField::FlowField(const Maze &maze, const FlowFieldParams &params) : maze(maze), params_(params)
+{
+    // every cell within maxDistance steps is within maxDistance cells on each axis
+    windowWidth = maze.gridWidth;
+    windowHeight = maze.gridHeight;
+    if (params.maxDistance)
+    {
+        const uint64_t side = 2 * (uint64_t)params.maxDistance + 1;
+        windowWidth = (int)std::min<uint64_t>(side, (uint64_t)windowWidth);
+        windowHeight = (int)std::min<uint64_t>(side, (uint64_t)windowHeight);
+    }
+    const size_t cells = (size_t)windowWidth * (size_t)windowHeight;
+    for (Layer &l : layers)
+        l.value.assign(cells, 0);
+}
+
+size_t FlowField::bytes() const
+{
+    return sizeof(*this) + (layers[0].value.capacity() + layers[1].value.capacity() + frontier.capacity() + nextFrontier.capacity()) * sizeof(uint32_t);
+}
+
+void FlowField::setGoal(CellCoord goal)
+{
+    if (!maze.solid.contains(goal.col, goal.row) || maze.solid.get(goal.col, goal.row))
+        return;
+    const CellCoord current = building ? pendingGoal : goal_;
+    if ((building || hasField) && current.col == goal.col && current.row == goal.row)
+        return;
+
+    // Past every value the layer holds, so its old field reads as unreached.
+    // Only when that would overflow is the layer cleared.
+    Layer &l = layers[1 - front];
+    const uint64_t limit = params_.maxDistance ? params_.maxDistance : l.value.size();
+    const uint64_t base = (uint64_t)l.base + l.maxDistance + 1;
+    if (base + limit >= std::numeric_limits<uint32_t>::max())
+    {
+        std::fill(l.value.begin(), l.value.end(), 0u);
+        l.base = 1;
+    }
+    else
+        l.base = (uint32_t)base;
+    l.maxDistance = 0;
+    l.cells = 1;
+    // a new window position is safe for the same reason: every value in it is
+    // below the new base
+    const int radius = (int)std::min<uint32_t>(params_.maxDistance, (uint32_t)kMaxGridSide);
+    l.col0 = params_.maxDistance ? std::max(0, std::min(goal.col - radius, maze.gridWidth - windowWidth)) : 0;
+    l.row0 = params_.maxDistance ? std::max(0, std::min(goal.row - radius, maze.gridHeight - windowHeight)) : 0;
+
+    const uint32_t cell = (uint32_t)((size_t)(goal.row - l.row0) * (size_t)windowWidth + (size_t)(goal.col - l.col0));
+    l.value[cell] = l.base;
+    frontier.assign(1, cell);
+    nextFrontier.clear();
+    frontierPos = 0;
+    level = 0;
+    pendingGoal = goal;
+    building = true;
+}
+
+bool FlowField::update()
+{
+    if (!building)
+        return true;
+    Layer &l = layers[1 - front];
+    uint32_t *value = l.value.data();
+    const uint32_t w = (uint32_t)windowWidth, h = (uint32_t)windowHeight;
+    size_t budget = params_.cellsPerUpdate ? params_.cellsPerUpdate : std::numeric_limits<size_t>::max();
+    while (budget > 0)
+    {
+        if (frontierPos == frontier.size())
+        {
+            // the next level is at the distance limit: assigned, not expanded
+            if (nextFrontier.empty() || (params_.maxDistance && level + 1 >= params_.maxDistance))
+            {
+                front = 1 - front;
+                goal_ = pendingGoal;
+                hasField = true;
+                building = false;
+                return true;
+            }
+            frontier.swap(nextFrontier);
+            nextFrontier.clear();
+            frontierPos = 0;
+            level++;
+        }
+        const uint32_t cell = frontier[frontierPos++];
+        budget--;
+        const uint32_t col = cell % w, row = cell / w;
+        const uint32_t next = l.base + level + 1;
+        auto visit = [&](uint32_t c, uint32_t r, uint32_t n)
+        {
+            if (value[n] >= l.base || maze.solid.get(l.col0 + (int)c, l.row0 + (int)r))
+                return;
+            value[n] = next;
+            l.cells++;
+            nextFrontier.push_back(n);
+        };
+        if (col + 1 < w)
+            visit(col + 1, row, cell + 1);
+        if (col > 0)
+            visit(col - 1, row, cell - 1);
+        if (row + 1 < h)
+            visit(col, row + 1, cell + w);
+        if (row > 0)
+            visit(col, row - 1, cell - w);
+        if (!nextFrontier.empty())
+            l.maxDistance = level + 1;
+    }
+    return false;
+}
+
+bool FlowField::step(int col, int row, CellCoord &next) const
+{
+    const uint32_t d = distance(col, row);
+    if (d == kUnreached || d == 0)
+        return false;
+    for (int k = 0; k < 4; k++)
+        if (distance(col + kStepCol[k], row + kStepRow[k]) == d - 1)
+        {
+            next = {(int16_t)(col + kStepCol[k]), (int16_t)(row + kStepRow[k])};
+            return true;
+        }
+    return false;
+}
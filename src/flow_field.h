@@ -0,0 +1,100 @@
+#pragma once
+
+#include "maze.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct FlowFieldParams
+{
+    // cells farther than this many steps from the goal are left out of the
+    // field; 0 covers everything the goal can reach
+    uint32_t maxDistance = 0;
+    // most cells the wavefront expands per update(); 0 finishes it at once
+    size_t cellsPerUpdate = 0;
+};
+
+// Distance field toward one goal cell over the open cells of a maze (BFS,
+// 4-connected), for many agents heading to the same place: each one looks up
+// the neighbour one step closer to the goal in O(1).
+//
+// When the goal moves, a new wavefront is propagated into a second buffer,
+// optionally a bounded number of cells per update() so a large field is
+// spread over several ticks; lookups keep reading the last complete field
+// until the new one replaces it. Distances are stored with a per-buffer base
+// that grows with every field, so a new field never clears the grid and
+// costs only the cells it reaches. A field bounded to maxDistance steps is
+// stored in a (2 * maxDistance + 1)^2 window centred on its goal (clamped to
+// the grid), so its memory does not depend on the map size; only unbounded
+// fields cover the whole grid.
+class FlowField
+{
+public:
+    static constexpr uint32_t kUnreached = 0xffffffffu;
+
+    FlowField(const Maze &maze, const FlowFieldParams &params = {});
+
+    // Starts a wavefront toward goal unless the field already heads there.
+    // Wall and out-of-grid cells are ignored.
+    void setGoal(CellCoord goal);
+    // Advances the pending wavefront; returns true once no wavefront is pending.
+    bool update();
+
+    bool ready() const { return hasField; }
+    bool pending() const { return building; }
+    // goal of the field lookups read
+    CellCoord goal() const { return goal_; }
+    // open cells in the field lookups read
+    size_t reachedCells() const { return layers[front].cells; }
+    const FlowFieldParams &params() const { return params_; }
+    size_t bytes() const;
+
+    // Steps to the goal, or kUnreached.
+    uint32_t distance(int col, int row) const
+    {
+        if (!hasField)
+            return kUnreached;
+        const Layer &l = layers[front];
+        const int c = col - l.col0, r = row - l.row0;
+        if (c < 0 || r < 0 || c >= windowWidth || r >= windowHeight)
+            return kUnreached;
+        uint32_t v = l.value[(size_t)r * (size_t)windowWidth + (size_t)c];
+        return v >= l.base ? v - l.base : kUnreached;
+    }
+    // The neighbour one step closer to the goal; false at the goal and for
+    // cells outside the field.
+    bool step(int col, int row, CellCoord &next) const;
+
+private:
+    struct Layer
+    {
+        // base + distance for cells of this layer's window, row-major;
+        // anything below base belongs to an older field
+        std::vector<uint32_t> value;
+        // grid cell of the window's first value
+        int col0 = 0;
+        int row0 = 0;
+        uint32_t base = 1;
+        uint32_t maxDistance = 0;
+        size_t cells = 0;
+    };
+
+    const Maze &maze;
+    FlowFieldParams params_;
+    // window size in cells, the same for both layers
+    int windowWidth = 0;
+    int windowHeight = 0;
+    Layer layers[2];
+    int front = 0;
+    bool hasField = false;
+    CellCoord goal_;
+
+    // the wavefront being built in layers[1 - front], as window indices
+    bool building = false;
+    CellCoord pendingGoal;
+    std::vector<uint32_t> frontier;
+    std::vector<uint32_t> nextFrontier;
+    size_t frontierPos = 0;
+    uint32_t level = 0;
+};
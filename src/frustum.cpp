@@ -0,0 +1,166 @@
+#include "frustum.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_SSE2 1
+#endif
+
+Frustum frustumFromMatrix(const glm::mat4 &m)
+{
+    // rows of the matrix; glm stores columns
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+        row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    Frustum f;
+    f.planes[0] = row[3] + row[0]; // left
+    f.planes[1] = row[3] - row[0]; // right
+    f.planes[2] = row[3] + row[1]; // bottom
+    f.planes[3] = row[3] - row[1]; // top
+    f.planes[4] = row[3] + row[2]; // near
+    f.planes[5] = row[3] - row[2]; // far
+    for (auto &p : f.planes)
+        p = p / glm::length(glm::vec3(p.x, p.y, p.z));
+    return f;
+}
+
+void BoxArray::add(const AABB &b)
+{
+    add((b.min + b.max) * 0.5f, (b.max - b.min) * 0.5f);
+}
+
+void BoxArray::add(const glm::vec3 &center, const glm::vec3 &halfExtent)
+{
+    cx.push_back(center.x);
+    cy.push_back(center.y);
+    cz.push_back(center.z);
+    ex.push_back(halfExtent.x);
+    ey.push_back(halfExtent.y);
+    ez.push_back(halfExtent.z);
+}
+
+void BoxArray::set(size_t i, const glm::vec3 &center, const glm::vec3 &halfExtent)
+{
+    cx[i] = center.x;
+    cy[i] = center.y;
+    cz[i] = center.z;
+    ex[i] = halfExtent.x;
+    ey[i] = halfExtent.y;
+    ez[i] = halfExtent.z;
+}
+
+void BoxArray::resize(size_t n)
+{
+    cx.resize(n);
+    cy.resize(n);
+    cz.resize(n);
+    ex.resize(n);
+    ey.resize(n);
+    ez.resize(n);
+}
+
+void BoxArray::clear()
+{
+    cx.clear();
+    cy.clear();
+    cz.clear();
+    ex.clear();
+    ey.clear();
+    ez.clear();
+}
+
+// A box is outside when even its corner furthest along the plane normal is
+// behind the plane: dot(n, c) + w + dot(|n|, e) < 0.
+static bool boxVisible(const Frustum &f, const BoxArray &b, size_t i)
+{
+    for (const auto &p : f.planes)
+    {
+        float d = ((p.x * b.cx[i] + p.y * b.cy[i]) + p.z * b.cz[i]) + p.w;
+        float r = (std::fabs(p.x) * b.ex[i] + std::fabs(p.y) * b.ey[i]) + std::fabs(p.z) * b.ez[i];
+        if (d + r < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+size_t cullBoxesScalar(const Frustum &f, const BoxArray &boxes, std::vector<uint32_t> &visible)
+{
+    visible.resize(boxes.size());
+    size_t count = 0;
+    for (size_t i = 0; i < boxes.size(); i++)
+        if (boxVisible(f, boxes, i))
+            visible[count++] = (uint32_t)i;
+    visible.resize(count);
+    return count;
+}
+
+size_t cullBoxIndices(const Frustum &f, const BoxArray &boxes, const std::vector<uint32_t> &candidates, std::vector<uint32_t> &visible)
+{
+    visible.clear();
+    for (uint32_t i : candidates)
+        if (boxVisible(f, boxes, i))
+            visible.push_back(i);
+    return visible.size();
+}
+
+size_t cullBoxes(const Frustum &f, const BoxArray &boxes, std::vector<uint32_t> &visible)
+{
+    const size_t n = boxes.size();
+    visible.resize(n);
+    size_t count = 0;
+    size_t i = 0;
+
+    // same operation order as boxVisible and no FMA, so both paths agree exactly
+#if defined(__AVX2__)
+    const __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(&boxes.cx[i]), cy = _mm256_loadu_ps(&boxes.cy[i]), cz = _mm256_loadu_ps(&boxes.cz[i]);
+        __m256 ex = _mm256_loadu_ps(&boxes.ex[i]), ey = _mm256_loadu_ps(&boxes.ey[i]), ez = _mm256_loadu_ps(&boxes.ez[i]);
+        __m256 outside = _mm256_setzero_ps();
+        for (const auto &p : f.planes)
+        {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.x), cx), _mm256_mul_ps(_mm256_set1_ps(p.y), cy)),
+                                                   _mm256_mul_ps(_mm256_set1_ps(p.z), cz)),
+                                     _mm256_set1_ps(p.w));
+            __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::fabs(p.x)), ex), _mm256_mul_ps(_mm256_set1_ps(std::fabs(p.y)), ey)),
+                                     _mm256_mul_ps(_mm256_set1_ps(std::fabs(p.z)), ez));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_LT_OQ));
+        }
+        int mask = _mm256_movemask_ps(outside);
+        for (int bit = 0; bit < 8; bit++)
+            if (!(mask & (1 << bit)))
+                visible[count++] = (uint32_t)(i + bit);
+    }
+#elif defined(FRUSTUM_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&boxes.cx[i]), cy = _mm_loadu_ps(&boxes.cy[i]), cz = _mm_loadu_ps(&boxes.cz[i]);
+        __m128 ex = _mm_loadu_ps(&boxes.ex[i]), ey = _mm_loadu_ps(&boxes.ey[i]), ez = _mm_loadu_ps(&boxes.ez[i]);
+        __m128 outside = _mm_setzero_ps();
+        for (const auto &p : f.planes)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), cx), _mm_mul_ps(_mm_set1_ps(p.y), cy)), _mm_mul_ps(_mm_set1_ps(p.z), cz)),
+                                  _mm_set1_ps(p.w));
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(p.x)), ex), _mm_mul_ps(_mm_set1_ps(std::fabs(p.y)), ey)),
+                                  _mm_mul_ps(_mm_set1_ps(std::fabs(p.z)), ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), zero));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int bit = 0; bit < 4; bit++)
+            if (!(mask & (1 << bit)))
+                visible[count++] = (uint32_t)(i + bit);
+    }
+#endif
+
+    for (; i < n; i++)
+        if (boxVisible(f, boxes, i))
+            visible[count++] = (uint32_t)i;
+    visible.resize(count);
+    return count;
+}
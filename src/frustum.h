@@ -0,0 +1,44 @@
+#pragma once
+
+#include "maze.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// View frustum as six inward-facing planes (xyz = unit normal, w = offset):
+// a point p is inside when dot(n, p) + w >= 0 for every plane.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// Gribb/Hartmann extraction from a projection * view matrix (GL clip space).
+Frustum frustumFromMatrix(const glm::mat4 &viewProjection);
+
+// Boxes as centre/half-extent arrays, the layout the batch test streams.
+struct BoxArray
+{
+    std::vector<float> cx, cy, cz;
+    std::vector<float> ex, ey, ez;
+
+    size_t size() const { return cx.size(); }
+    void add(const AABB &b);
+    void add(const glm::vec3 &center, const glm::vec3 &halfExtent);
+    void set(size_t i, const glm::vec3 &center, const glm::vec3 &halfExtent);
+    void resize(size_t n);
+    void clear();
+};
+
+// Writes the indices of the boxes that are inside or straddle the frustum to
+// visible, in ascending order, and returns how many there are. The test is
+// conservative: a box just outside a frustum corner may still pass.
+// Runs 4 (SSE2) or 8 (AVX2) boxes per step.
+size_t cullBoxes(const Frustum &f, const BoxArray &boxes, std::vector<uint32_t> &visible);
+// Scalar reference, bit-identical results.
+size_t cullBoxesScalar(const Frustum &f, const BoxArray &boxes, std::vector<uint32_t> &visible);
+// Same test restricted to the given candidate indices (kept in their order).
+// Scalar: meant for short pre-filtered lists such as a PVS.
+size_t cullBoxIndices(const Frustum &f, const BoxArray &boxes, const std::vector<uint32_t> &candidates, std::vector<uint32_t> &visible);
@@ -0,0 +1,191 @@
+#include "input_record.h"
+
+#include <cstring>
+
+static const char kMagic[4] = {'F', 'P', 'S', 'I'};
+static constexpr uint16_t kVersion = 1;
+static constexpr uint8_t kFireFlag = 0x40;
+static constexpr uint8_t kMouseFlag = 0x80;
+static constexpr uint8_t kKeyMask = 0x3f;
+
+static void putU16(std::ostream &o, uint16_t v)
+{
+    char b[2] = {(char)(v & 0xff), (char)(v >> 8)};
+    o.write(b, 2);
+}
+
+static void putU32(std::ostream &o, uint32_t v)
+{
+    char b[4] = {(char)(v & 0xff), (char)((v >> 8) & 0xff), (char)((v >> 16) & 0xff), (char)(v >> 24)};
+    o.write(b, 4);
+}
+
+static void putF32(std::ostream &o, float f)
+{
+    uint32_t v;
+    std::memcpy(&v, &f, 4);
+    putU32(o, v);
+}
+
+static void putVarint(std::ostream &o, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        o.put((char)(v | 0x80));
+        v >>= 7;
+    }
+    o.put((char)v);
+}
+
+static bool getU16(std::istream &i, uint16_t &v)
+{
+    unsigned char b[2];
+    if (!i.read((char *)b, 2))
+        return false;
+    v = (uint16_t)(b[0] | (b[1] << 8));
+    return true;
+}
+
+static bool getU32(std::istream &i, uint32_t &v)
+{
+    unsigned char b[4];
+    if (!i.read((char *)b, 4))
+        return false;
+    v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+    return true;
+}
+
+static bool getF32(std::istream &i, float &f)
+{
+    uint32_t v;
+    if (!getU32(i, v))
+        return false;
+    std::memcpy(&f, &v, 4);
+    return true;
+}
+
+static bool getVarint(std::istream &i, uint32_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        int c = i.get();
+        if (c == EOF)
+            return false;
+        v |= (uint32_t)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool InputRecorder::open(const std::string &path, uint32_t seed, uint16_t tickHz)
+{
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    file.write(kMagic, 4);
+    putU16(file, kVersion);
+    putU16(file, tickHz);
+    putU32(file, seed);
+    lastTick = 0;
+    lastKeys = 0;
+    hasPending = false;
+    return (bool)file;
+}
+
+void InputRecorder::writeRecord(uint32_t tick, const TickInput &in)
+{
+    bool mouse = in.mouseDx != 0.0f || in.mouseDy != 0.0f;
+    putVarint(file, tick - lastTick);
+    file.put((char)((in.keys & kKeyMask) | (in.fire ? kFireFlag : 0) | (mouse ? kMouseFlag : 0)));
+    if (mouse)
+    {
+        putF32(file, in.mouseDx);
+        putF32(file, in.mouseDy);
+    }
+    lastTick = tick;
+    lastKeys = in.keys;
+}
+
+void InputRecorder::write(uint32_t tick, const TickInput &in)
+{
+    if (!file.is_open())
+        return;
+    if (in.fire || in.keys != lastKeys || in.mouseDx != 0.0f || in.mouseDy != 0.0f)
+    {
+        writeRecord(tick, in);
+        hasPending = false;
+    }
+    else
+    {
+        // idle tick: remembered only so close() can mark the end of the run
+        pendingTick = tick;
+        hasPending = true;
+    }
+}
+
+void InputRecorder::close()
+{
+    if (!file.is_open())
+        return;
+    if (hasPending)
+    {
+        TickInput idle;
+        idle.keys = lastKeys;
+        writeRecord(pendingTick, idle);
+    }
+    file.close();
+}
+
+bool InputReplay::open(const std::string &path)
+{
+    file.open(path, std::ios::binary);
+    char magic[4];
+    uint16_t version = 0;
+    if (!file.read(magic, 4) || std::memcmp(magic, kMagic, 4) != 0 || !getU16(file, version) || version != kVersion ||
+        !getU16(file, tickHz_) || !getU32(file, seed_))
+        return false;
+    lastTick = 0;
+    readRecord();
+    return true;
+}
+
+void InputReplay::readRecord()
+{
+    uint32_t delta = 0;
+    int flags = EOF;
+    if (!getVarint(file, delta) || (flags = file.get()) == EOF)
+    {
+        hasNext = false;
+        eof = true;
+        return;
+    }
+    nextInput = TickInput();
+    nextInput.keys = (uint8_t)(flags & kKeyMask);
+    nextInput.fire = (flags & kFireFlag) != 0;
+    if ((flags & kMouseFlag) && !(getF32(file, nextInput.mouseDx) && getF32(file, nextInput.mouseDy)))
+    {
+        hasNext = false;
+        eof = true;
+        return;
+    }
+    nextTick = lastTick + delta;
+    lastTick = nextTick;
+    hasNext = true;
+}
+
+TickInput InputReplay::next(uint32_t tick)
+{
+    if (hasNext && tick == nextTick)
+    {
+        TickInput in = nextInput;
+        heldKeys = in.keys;
+        readRecord();
+        return in;
+    }
+    // no record for this tick: keys stay held, no shot, no mouse movement
+    TickInput in;
+    in.keys = heldKeys;
+    return in;
+}
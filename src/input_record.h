@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Input consumed by one simulation tick. Live play samples it from GLFW,
+// replay reads it back from a recording; both feed the same tick code.
+enum InputKey : uint8_t
+{
+    KEY_FORWARD = 1 << 0,
+    KEY_BACKWARD = 1 << 1,
+    KEY_LEFT = 1 << 2,
+    KEY_RIGHT = 1 << 3,
+    KEY_SPRINT = 1 << 4,
+};
+
+struct TickInput
+{
+    uint8_t keys = 0;
+    bool fire = false;
+    float mouseDx = 0.0f;
+    float mouseDy = 0.0f;
+};
+
+// Recording layout (little-endian):
+//   header: "FPSI", u16 version, u16 tick rate (Hz), u32 RNG seed
+//   records: varint tick delta, u8 flags (keys | 0x40 fire | 0x80 mouse),
+//            [f32 dx, f32 dy] when the mouse flag is set
+// A record is written only when the held keys change, on a shot, or when the
+// mouse moved; the last tick is always written so replay knows the length.
+class InputRecorder
+{
+public:
+    bool open(const std::string &path, uint32_t seed, uint16_t tickHz);
+    void write(uint32_t tick, const TickInput &in);
+    void close();
+    ~InputRecorder() { close(); }
+
+private:
+    std::ofstream file;
+    uint32_t lastTick = 0;
+    uint32_t pendingTick = 0;
+    bool hasPending = false;
+    uint8_t lastKeys = 0;
+    void writeRecord(uint32_t tick, const TickInput &in);
+};
+
+class InputReplay
+{
+public:
+    bool open(const std::string &path);
+    uint32_t seed() const { return seed_; }
+    uint16_t tickHz() const { return tickHz_; }
+    // True once every recorded tick has been handed out.
+    bool finished(uint32_t tick) const { return eof && tick > lastTick; }
+    // Input for the given tick; ticks must be requested in order.
+    TickInput next(uint32_t tick);
+
+private:
+    std::ifstream file;
+    uint32_t seed_ = 0;
+    uint16_t tickHz_ = 0;
+    uint32_t lastTick = 0;
+    uint8_t heldKeys = 0;
+    bool eof = false;
+    bool hasNext = false;
+    uint32_t nextTick = 0;
+    TickInput nextInput;
+    void readRecord();
+};
@@ -0,0 +1,242 @@
+#include "jobs.h"
+
+#include <algorithm>
+
+struct Job
+{
+    std::function<void()> fn;
+    // unfinished dependencies, plus one held by submit() until it is done wiring
+    std::atomic<int> pending{1};
+    std::atomic<bool> done{false};
+    std::mutex m;
+    std::vector<JobHandle> dependents;
+    // dependencies that had not finished at submit, for waiters outside the pool
+    std::vector<JobHandle> deps;
+};
+
+namespace
+{
+    thread_local const JobSystem *tlsSystem = nullptr;
+    thread_local size_t tlsQueue = 0;
+} // namespace
+
+JobSystem::JobSystem(unsigned workers)
+{
+    if (workers == 0)
+    {
+        unsigned hw = std::thread::hardware_concurrency();
+        workers = hw > 1 ? hw - 1 : 0;
+    }
+    for (unsigned i = 0; i <= workers; i++)
+        queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < workers; i++)
+        threads.emplace_back(&JobSystem::workerLoop, this, (size_t)i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lk(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &t : threads)
+        t.join();
+}
+
+size_t JobSystem::currentQueue() const
+{
+    return tlsSystem == this ? tlsQueue : queues.size() - 1;
+}
+
+JobHandle JobSystem::submit(std::function<void()> fn, std::initializer_list<JobHandle> deps)
+{
+    auto job = std::make_shared<Job>();
+    job->fn = std::move(fn);
+    for (const auto &dep : deps)
+    {
+        if (!dep)
+            continue;
+        std::lock_guard<std::mutex> lk(dep->m);
+        if (dep->done.load(std::memory_order_relaxed))
+            continue;
+        job->pending.fetch_add(1, std::memory_order_relaxed);
+        dep->dependents.push_back(job);
+        job->deps.push_back(dep);
+    }
+    if (job->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        enqueue(job);
+    return job;
+}
+
+bool JobSystem::finished(const JobHandle &h)
+{
+    return !h || h->done.load(std::memory_order_acquire);
+}
+
+void JobSystem::enqueue(JobHandle job)
+{
+    Queue &q = *queues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> lk(q.m);
+        q.jobs.push_back(std::move(job));
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    // taking the lock orders this with a worker that is about to sleep
+    {
+        std::lock_guard<std::mutex> lk(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+JobHandle JobSystem::take(size_t self)
+{
+    JobHandle job;
+    {
+        Queue &own = *queues[self];
+        std::lock_guard<std::mutex> lk(own.m);
+        if (!own.jobs.empty())
+        {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+        }
+    }
+    for (size_t k = 1; !job && k < queues.size(); k++)
+    {
+        Queue &victim = *queues[(self + k) % queues.size()];
+        std::lock_guard<std::mutex> lk(victim.m);
+        if (!victim.jobs.empty())
+        {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+        }
+    }
+    if (job)
+        queued.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::run(const JobHandle &job)
+{
+    job->fn();
+    job->fn = nullptr;
+
+    std::vector<JobHandle> ready;
+    {
+        std::lock_guard<std::mutex> lk(job->m);
+        job->deps.clear();
+        job->done.store(true, std::memory_order_release);
+        ready.swap(job->dependents);
+    }
+    for (auto &d : ready)
+        if (d->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            enqueue(std::move(d));
+}
+
+bool JobSystem::claim(const JobHandle &job)
+{
+    for (auto &q : queues)
+    {
+        std::lock_guard<std::mutex> lk(q->m);
+        auto it = std::find(q->jobs.begin(), q->jobs.end(), job);
+        if (it != q->jobs.end())
+        {
+            q->jobs.erase(it);
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::runAwaited(const JobHandle &job)
+{
+    if (finished(job))
+        return false;
+    if (claim(job))
+    {
+        run(job);
+        return true;
+    }
+    // still waiting on its dependencies, or already running elsewhere
+    std::vector<JobHandle> deps;
+    {
+        std::lock_guard<std::mutex> lk(job->m);
+        deps = job->deps;
+    }
+    for (const auto &d : deps)
+        if (runAwaited(d))
+            return true;
+    return false;
+}
+
+void JobSystem::wait(const JobHandle &h)
+{
+    // Workers help with anything queued. Other threads (the render thread,
+    // say) run only h and what it depends on, so a wait there cannot pick up
+    // someone else's long job and stall the caller.
+    const bool worker = tlsSystem == this;
+    const size_t self = currentQueue();
+    while (!finished(h))
+    {
+        if (worker)
+        {
+            if (JobHandle job = take(self))
+            {
+                run(job);
+                continue;
+            }
+        }
+        else if (runAwaited(h))
+            continue;
+        std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn)
+{
+    if (count == 0)
+        return;
+    grain = std::max<size_t>(grain, 1);
+    const size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || threads.empty())
+    {
+        fn(0, count);
+        return;
+    }
+
+    // helpers and the caller pull chunks off a shared counter, so a slow or
+    // descheduled thread just ends up doing fewer of them
+    std::atomic<size_t> next{0};
+    auto body = [&]
+    {
+        for (size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < chunks;)
+            fn(c * grain, std::min(count, (c + 1) * grain));
+    };
+    std::vector<JobHandle> helpers;
+    size_t helperCount = std::min<size_t>(chunks - 1, threads.size());
+    for (size_t i = 0; i < helperCount; i++)
+        helpers.push_back(submit(body));
+    body();
+    for (const auto &h : helpers)
+        wait(h);
+}
+
+void JobSystem::workerLoop(size_t index)
+{
+    tlsSystem = this;
+    tlsQueue = index;
+    for (;;)
+    {
+        if (JobHandle job = take(index))
+        {
+            run(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(sleepMutex);
+        wake.wait(lk, [this]
+                  { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping)
+            return;
+    }
+}
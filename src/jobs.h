@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+using JobHandle = std::shared_ptr<Job>;
+
+// Work-stealing thread pool. Every worker owns a deque: it pushes and pops its
+// own jobs at the back (most recent first, still warm in cache) while idle
+// workers steal from the front of the others. Threads outside the pool submit
+// to a shared queue. A waiting worker runs any queued job meanwhile; a waiting
+// thread outside the pool runs only the awaited job and its dependencies.
+class JobSystem
+{
+public:
+    // workers = 0 picks hardware_concurrency() - 1; the calling thread makes up the rest
+    explicit JobSystem(unsigned workers = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    unsigned workerCount() const { return (unsigned)threads.size(); }
+
+    // Queues fn to run once every job in deps has finished (null handles are ignored).
+    JobHandle submit(std::function<void()> fn, std::initializer_list<JobHandle> deps = {});
+    static bool finished(const JobHandle &h);
+    // Blocks until h has finished, running queued jobs meanwhile (on threads
+    // outside the pool only h and the jobs it depends on).
+    void wait(const JobHandle &h);
+    // Calls fn(begin, end) over [0, count) in chunks of grain items spread over
+    // the workers and the calling thread, and returns when all are done.
+    // A range that fits in one chunk runs inline without touching the queues.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn);
+
+private:
+    struct Queue
+    {
+        std::mutex m;
+        std::deque<JobHandle> jobs;
+    };
+
+    void enqueue(JobHandle job);
+    JobHandle take(size_t self);
+    bool claim(const JobHandle &job);
+    bool runAwaited(const JobHandle &job);
+    void run(const JobHandle &job);
+    void workerLoop(size_t index);
+    size_t currentQueue() const;
+
+    // one per worker, the last one is shared by outside threads
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> queued{0};
+    bool stopping = false;
+};
@@ -4,16 +4,35 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "bvh.h"
 #include "camera.h"
+#include "chunk_stream.h"
+#include "collision.h"
+#include "flow_field.h"
+#include "frustum.h"
+#include "input_record.h"
+#include "jobs.h"
+#include "map_file.h"
 #include "maze.h"
+#include "pathfind.h"
+#include "pvs.h"
 #include "shader.h"
+#include "targets.h"
+#include "triple_buffer.h"
+#include "wall_mesh.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <limits>
+#include <memory>
 #include <random>
+#include <string>
+#include <thread>
 #include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -27,8 +46,59 @@ namespace
     static constexpr float kEnemyRadius = 0.45f;
     static constexpr int kEnemyCount = 6;
     static constexpr float kEnemyY = 0.5f;
+    static constexpr float kEnemySpeed = 1.6f;
+    // targets stop this far from the player instead of walking into them
+    static constexpr float kEnemyStopDistance = 1.2f;
+    // path cells refined ahead of a target; the rest is refined as it walks
+    static constexpr size_t kEnemyPathAhead = 16;
+    // ticks between replans while the player stays in one cell
+    static constexpr uint32_t kReplanTicks = 60;
+    // targets within this many steps of the player steer down a flow field
+    // instead of following their own paths; the field's wavefront expands at
+    // most kFlowCellsPerTick cells per tick
+    static constexpr uint32_t kFlowRadius = 160;
+    static constexpr size_t kFlowCellsPerTick = 1 << 15;
 
     static constexpr float kRespawnInterval = 2.0f;
+    // spawn cells are drawn from the player's region; up to kSpawnTries draws
+    // look for one at least kSpawnMinDistance away and out of the player's sight
+    static constexpr int kSpawnTries = 8;
+    static constexpr float kSpawnMinDistance = 4.0f;
+
+    // Simulation runs at a fixed rate independent of the display; rendering
+    // interpolates between the last two simulation states.
+    static constexpr double kSimHz = 120.0;
+    static constexpr float kSimDt = (float)(1.0 / kSimHz);
+    static constexpr int kMaxSimStepsPerFrame = 8;
+    static constexpr double kMaxFrameTime = 0.25;
+
+    // merge adjacent wall cells into larger boxes at build time
+    static constexpr bool kMergeWalls = false;
+
+    // per-cell visibility cache, rebuilt when the maze no longer matches it
+    static constexpr const char *kPvsCachePath = "maze.pvs";
+
+    // maps with more cells than this are streamed in chunks around the camera
+    // instead of being baked whole (--stream forces it for any map)
+    static constexpr size_t kStreamMinCells = 512 * 512;
+
+    // targets per job when per-target work is split across the job system;
+    // below this everything runs inline on the calling thread
+    static constexpr size_t kTargetJobGrain = 1024;
+
+    static constexpr unsigned int kHeadlessWidth = 1280;
+    static constexpr unsigned int kHeadlessHeight = 720;
+    static constexpr int kHeadlessTicksPerFrame = (int)(kSimHz / 60.0);
+
+    struct Options
+    {
+        bool headless = false;
+        int frames = 600;
+        std::string recordPath;
+        std::string replayPath;
+        std::string mapPath;
+        bool stream = false;
+    };
 
     static const std::vector<std::string> kMazeGrid = {
         "#################",
@@ -48,12 +118,6 @@ namespace
         "#################",
     };
 
-    struct Target
-    {
-        glm::vec3 pos{0.0f};
-        bool alive = true;
-    };
-
     struct GlMesh
     {
         GLuint vao = 0;
@@ -61,129 +125,197 @@ namespace
         GLuint ebo = 0;
     };
 
-    struct Crosshair
+    // per-wall model matrix and bounds for the outline pass; only the visible
+    // matrices are streamed to the GPU each frame
+    struct WallInstances
     {
-        GLuint vao = 0;
         GLuint vbo = 0;
-        GLuint texture = 0;
+        GLuint edgesVao = 0;
+        std::vector<glm::mat4> models;
+        BoxArray boxes;
     };
 
-    struct AppState
+    // per-frame target transforms for the instanced target draw
+    struct TargetInstances
     {
-        unsigned int width = 800;
-        unsigned int height = 600;
-        GLFWwindow *window = nullptr;
-
-        Camera camera{glm::vec3(0.0f, kPlayerEyeHeight, 3.0f)};
-        bool firstMouse = true;
-        float lastX = 0.0f;
-        float lastY = 0.0f;
+        GLuint vbo = 0;
+        GLuint vao = 0;
+        // interpolated bounds of every live target, then transforms of the visible ones
+        BoxArray boxes;
+        std::vector<glm::mat4> models;
+    };
 
-        float deltaTime = 0.0f;
-        float lastFrame = 0.0f;
+    // uniform handles, resolved once after the programs are linked
+    struct UniformHandles
+    {
+        struct
+        {
+            int model, color;
+        } scene;
+        struct
+        {
+            int tex;
+        } wall;
+        struct
+        {
+            int color;
+        } edge;
+        struct
+        {
+            int ortho;
+        } cross;
+    };
 
-        Maze maze;
-        std::mt19937 rng{std::random_device{}()};
+    // GPU side of one streamed chunk, and what survived culling this frame
+    struct GlChunk
+    {
+        uint32_t id = 0;
+        AABB box{};
+        GlMesh mesh;
+        std::vector<WallMeshRange> ranges;
+        BoxArray rangeBoxes;
+        std::vector<glm::mat4> wallModels;
+        BoxArray wallBoxes;
+        std::vector<uint32_t> visibleCells;
+        std::vector<uint32_t> visibleWalls;
+    };
 
-        std::vector<Target> targets;
-        float spawnTimer = 0.0f;
+    struct Crosshair
+    {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint texture = 0;
+    };
 
+    // GL objects, created on the main thread at startup and afterwards only
+    // touched by whichever thread renders
+    struct RenderResources
+    {
         GlMesh cube;
-        GlMesh texturedCube;
         GlMesh cubeEdges;
+        GlMesh wallMesh;
+        GLsizei wallIndexCount = 0;
+        // one index range and box per wall cell of the baked mesh
+        std::vector<WallMeshRange> wallRanges;
+        BoxArray wallRangeBoxes;
+        // wall cells visible from each empty cell, and the outline box of each wall cell
+        Pvs pvs;
+        std::vector<uint32_t> wallCellBox;
+        WallInstances wallInstances;
+        TargetInstances targetInstances;
+        UniformHandles u{};
+        GLuint cameraUbo = 0;
         GLuint wallTexture = 0;
         Crosshair cross;
+        glm::vec2 floorSize{0.0f};
+
+        // per-frame culling output, kept to reuse the allocations
+        std::vector<uint32_t> pvsCells;
+        std::vector<uint32_t> pvsWalls;
+        std::vector<uint32_t> visibleCells;
+        std::vector<uint32_t> visibleWalls;
+        std::vector<uint32_t> visibleTargets;
+        std::vector<GLsizei> drawCounts;
+        std::vector<const void *> drawOffsets;
+        std::vector<glm::mat4> visibleWallModels;
+
+        // large maps: chunks streamed around the camera take the place of the
+        // baked mesh, the PVS and the outline boxes above
+        std::unique_ptr<ChunkStreamer> streamer;
+        std::vector<GlChunk> chunks;
+        BoxArray chunkBoxes;
+        std::vector<uint32_t> visibleChunks;
+        std::vector<std::unique_ptr<ChunkData>> loadedChunks;
+        std::vector<uint32_t> evictedChunks;
     };
 
-    static float clampf(float v, float lo, float hi)
+    // what survived frustum culling this frame
+    struct RenderStats
     {
-        if (v < lo)
-            return lo;
-        if (v > hi)
-            return hi;
-        return v;
-    }
-
-    static bool circleIntersectsAABB_XZ(const glm::vec3 &pos, float radius, const AABB &box)
-    {
-        float closestX = clampf(pos.x, box.min.x, box.max.x);
-        float closestZ = clampf(pos.z, box.min.z, box.max.z);
-        float dx = pos.x - closestX;
-        float dz = pos.z - closestZ;
-        return dx * dx + dz * dz < radius * radius;
-    }
+        size_t wallCells = 0;
+        size_t wallCellsPvs = 0;
+        size_t wallCellsVisible = 0;
+        size_t wallDraws = 0;
+        size_t wallBoxes = 0;
+        size_t wallBoxesVisible = 0;
+        size_t targets = 0;
+        size_t targetsVisible = 0;
+    };
 
-    static bool isBlocked(const Maze &maze, const glm::vec3 &pos, float radius)
+    // What render() needs from the simulation, copied out once per loop
+    // iteration. Holds both the previous and the current tick so the renderer
+    // can interpolate by its own clock.
+    struct FrameSnapshot
     {
-        for (const auto &w : maze.walls)
-            if (circleIntersectsAABB_XZ(pos, radius, w))
-                return true;
-        return false;
-    }
+        unsigned int width = 0;
+        unsigned int height = 0;
+        glm::vec3 prevEye{0.0f};
+        glm::vec3 eye{0.0f};
+        glm::vec3 front{0.0f, 0.0f, -1.0f};
+        glm::vec3 up{0.0f, 1.0f, 0.0f};
+        // grid cells of eye and prevEye, for the PVS lookup
+        int eyeCol = -1, eyeRow = -1;
+        int prevEyeCol = -1, prevEyeRow = -1;
+        // wall-clock time at which the current tick is exact (alpha = 0 there)
+        double tickTime = 0.0;
+        std::vector<glm::vec3> prevTargets;
+        std::vector<glm::vec3> targets;
+    };
 
-    static bool rayAABB(const glm::vec3 &origin, const glm::vec3 &dir, const AABB &box, float &tHit)
+    struct AppState
     {
-        float tmin = 0.0f;
-        float tmax = std::numeric_limits<float>::infinity();
-
-        for (int axis = 0; axis < 3; axis++)
-        {
-            float o = origin[axis];
-            float d = dir[axis];
-            float mn = box.min[axis];
-            float mx = box.max[axis];
-
-            if (std::fabs(d) < 1e-6f)
-            {
-                if (o < mn || o > mx)
-                    return false;
-                continue;
-            }
-
-            float inv = 1.0f / d;
-            float t1 = (mn - o) * inv;
-            float t2 = (mx - o) * inv;
-            if (t1 > t2)
-                std::swap(t1, t2);
-            tmin = std::max(tmin, t1);
-            tmax = std::min(tmax, t2);
-            if (tmin > tmax)
-                return false;
-        }
+        unsigned int width = 800;
+        unsigned int height = 600;
+        GLFWwindow *window = nullptr;
 
-        tHit = tmin;
-        return tmax >= 0.0f;
-    }
+        Camera camera{glm::vec3(0.0f, kPlayerEyeHeight, 3.0f)};
+        bool firstMouse = true;
+        float lastX = 0.0f;
+        float lastY = 0.0f;
 
-    static bool raySphere(const glm::vec3 &origin, const glm::vec3 &dir, const glm::vec3 &center, float radius, float &tHit)
-    {
-        glm::vec3 oc = origin - center;
-        float b = glm::dot(oc, dir);
-        float c = glm::dot(oc, oc) - radius * radius;
-        float h = b * b - c;
-        if (h < 0.0f)
-            return false;
-        h = std::sqrt(h);
+        double lastFrame = 0.0;
+        double accumulator = 0.0;
+        glm::vec3 prevCameraPos{0.0f};
+        bool shootQueued = false;
 
-        float t0 = -b - h;
-        float t1 = -b + h;
-        if (t1 < 0.0f)
-            return false;
-        tHit = (t0 >= 0.0f) ? t0 : t1;
-        return true;
-    }
+        Maze maze;
+        // the .fmap the maze views, if it came from one; its chunks feed the streamer
+        std::shared_ptr<const MapFile> mapFile;
+        // hitscan, movement and line-of-sight queries against Maze::walls
+        Bvh wallBvh;
+        // recorded with the input so a replay spawns the same targets
+        uint32_t seed = std::random_device{}();
+        std::mt19937 rng{seed};
+
+        // simulation tick counter, the timestamp of recorded input
+        uint32_t tick = 0;
+        float pendingMouseDx = 0.0f;
+        float pendingMouseDy = 0.0f;
+        InputRecorder recorder;
+        InputReplay replay;
+        bool replaying = false;
+
+        TargetPool targets;
+        float spawnTimer = 0.0f;
 
-    static float nearestWallT(const Maze &maze, const glm::vec3 &origin, const glm::vec3 &dir)
-    {
-        float best = std::numeric_limits<float>::infinity();
-        for (const auto &w : maze.walls)
-        {
-            float t = 0.0f;
-            if (rayAABB(origin, dir, w, t) && t >= 0.0f)
-                best = std::min(best, t);
-        }
-        return best;
-    }
+        // Distance field around the player's cell for nearby targets, and
+        // paths toward it for the rest, by target index. Kills and respawns
+        // move target indices, so they mark the paths stale.
+        std::unique_ptr<FlowField> flow;
+        PathGraph pathGraph;
+        PathCache pathCache;
+        std::vector<PathRequest> pathRequests;
+        std::vector<size_t> pathTargets;
+        std::vector<PathPlan> plannedPaths;
+        std::vector<PathPlan> targetPaths;
+        std::vector<size_t> targetPathNext;
+        CellCoord pathGoal;
+        uint32_t pathTick = 0;
+        bool pathsStale = true;
+
+        JobSystem *jobs = nullptr;
+        RenderResources gfx;
+    };
 
     static GLuint loadTextureRGBA(const char *path)
     {
@@ -303,404 +435,395 @@ namespace
         glEnableVertexAttribArray(0);
     }
 
-    static void setupTexturedCubeMesh(GlMesh &m)
+    static void setupCubeEdgesMesh(GlMesh &m)
     {
-        // 36 vertices (no indices): pos(3) + uv(2)
-        const float v[] = {
-            // +X
-            0.5f,
+        // 12 edges => 24 vertices (GL_LINES), pos(3)
+        const float e[] = {
+            // bottom square
             -0.5f,
             -0.5f,
-            0,
-            0,
-            0.5f,
             -0.5f,
             0.5f,
-            1,
-            0,
-            0.5f,
-            0.5f,
-            0.5f,
-            1,
-            1,
-            0.5f,
             -0.5f,
             -0.5f,
-            0,
-            0,
-            0.5f,
-            0.5f,
-            0.5f,
-            1,
-            1,
             0.5f,
-            0.5f,
-            -0.5f,
-            0,
-            1,
-            // -X
             -0.5f,
             -0.5f,
             0.5f,
-            0,
-            0,
             -0.5f,
+            0.5f,
+            0.5f,
             -0.5f,
+            0.5f,
             -0.5f,
-            1,
-            0,
             -0.5f,
             0.5f,
             -0.5f,
-            1,
-            1,
-            -0.5f,
             -0.5f,
             0.5f,
-            0,
-            0,
             -0.5f,
-            0.5f,
             -0.5f,
-            1,
-            1,
             -0.5f,
-            0.5f,
-            0.5f,
-            0,
-            1,
-            // +Y
+            // top square
             -0.5f,
             0.5f,
             -0.5f,
-            0,
-            0,
             0.5f,
             0.5f,
             -0.5f,
-            1,
-            0,
             0.5f,
             0.5f,
-            0.5f,
-            1,
-            1,
             -0.5f,
             0.5f,
-            -0.5f,
-            0,
-            0,
             0.5f,
             0.5f,
             0.5f,
-            1,
-            1,
-            -0.5f,
             0.5f,
             0.5f,
-            0,
-            1,
-            // -Y
-            -0.5f,
             -0.5f,
             0.5f,
-            0,
-            0,
             0.5f,
             -0.5f,
             0.5f,
-            1,
-            0,
             0.5f,
             -0.5f,
-            -0.5f,
-            1,
-            1,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            0,
-            0,
             0.5f,
             -0.5f,
-            -0.5f,
-            1,
-            1,
-            -0.5f,
+            // verticals
             -0.5f,
             -0.5f,
-            0,
-            1,
-            // +Z
             -0.5f,
             -0.5f,
             0.5f,
-            0,
-            0,
             -0.5f,
             0.5f,
-            0.5f,
-            0,
-            1,
-            0.5f,
-            0.5f,
-            0.5f,
-            1,
-            1,
             -0.5f,
             -0.5f,
             0.5f,
-            0,
-            0,
-            0.5f,
             0.5f,
-            0.5f,
-            1,
-            1,
+            -0.5f,
             0.5f,
             -0.5f,
             0.5f,
-            1,
-            0,
-            // -Z
             0.5f,
-            -0.5f,
-            -0.5f,
-            0,
-            0,
             0.5f,
             0.5f,
             -0.5f,
-            0,
-            1,
             -0.5f,
             0.5f,
             -0.5f,
-            1,
-            1,
             0.5f,
-            -0.5f,
-            -0.5f,
+            0.5f,
+        };
+
+        glGenVertexArrays(1, &m.vao);
+        glGenBuffers(1, &m.vbo);
+
+        glBindVertexArray(m.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(e), e, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+    }
+
+    static void setupCrosshair(Crosshair &c, unsigned int w, unsigned int h)
+    {
+        float size = 16.0f;
+        float cx = w * 0.5f;
+        float cy = h * 0.5f;
+
+        float quad[] = {
+            cx - size,
+            cy + size,
+            0,
+            1,
+            cx - size,
+            cy - size,
             0,
             0,
-            -0.5f,
-            0.5f,
-            -0.5f,
+            cx + size,
+            cy - size,
             1,
+            0,
+
+            cx - size,
+            cy + size,
+            0,
             1,
-            -0.5f,
-            -0.5f,
-            -0.5f,
+            cx + size,
+            cy - size,
             1,
             0,
+            cx + size,
+            cy + size,
+            1,
+            1,
         };
 
-        glGenVertexArrays(1, &m.vao);
-        glGenBuffers(1, &m.vbo);
+        glGenVertexArrays(1, &c.vao);
+        glGenBuffers(1, &c.vbo);
 
-        glBindVertexArray(m.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(v), v, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
+        glBindVertexArray(c.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, c.vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
         glEnableVertexAttribArray(1);
     }
 
-    static void setupCubeEdgesMesh(GlMesh &m)
+    static glm::mat4 boxModel(const AABB &box)
     {
-        // 12 edges => 24 vertices (GL_LINES), pos(3)
-        const float e[] = {
-            // bottom square
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            // top square
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            // verticals
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-        };
+        glm::vec3 center = (box.min + box.max) * 0.5f;
+        glm::vec3 size = (box.max - box.min);
+        return glm::scale(glm::translate(glm::mat4(1.0f), center), size);
+    }
 
-        glGenVertexArrays(1, &m.vao);
-        glGenBuffers(1, &m.vbo);
+    static void setupWallInstances(WallInstances &w, const MappedArray<AABB> &walls, const GlMesh &cubeEdges)
+    {
+        w.models.clear();
+        w.boxes.clear();
+        for (const auto &box : walls)
+        {
+            w.models.push_back(boxModel(box));
+            w.boxes.add(box);
+        }
 
-        glBindVertexArray(m.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(e), e, GL_STATIC_DRAW);
+        // refilled with the visible walls every frame
+        glGenBuffers(1, &w.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, w.vbo);
+        glBufferData(GL_ARRAY_BUFFER, w.models.size() * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+
+        // edge pos(3) per vertex, transform per instance
+        glGenVertexArrays(1, &w.edgesVao);
+        glBindVertexArray(w.edgesVao);
+        glBindBuffer(GL_ARRAY_BUFFER, cubeEdges.vbo);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
         glEnableVertexAttribArray(0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, w.vbo);
+        // mat4 takes four consecutive vec4 attribute slots
+        for (int i = 0; i < 4; i++)
+        {
+            glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)(i * sizeof(glm::vec4)));
+            glEnableVertexAttribArray(2 + i);
+            glVertexAttribDivisor(2 + i, 1);
+        }
+
+        glBindVertexArray(0);
     }
 
-    static void setupCrosshair(Crosshair &c, unsigned int w, unsigned int h)
+    static void setupTargetInstances(TargetInstances &t, const GlMesh &cube)
     {
-        float size = 16.0f;
-        float cx = w * 0.5f;
-        float cy = h * 0.5f;
+        glGenBuffers(1, &t.vbo);
+        glGenVertexArrays(1, &t.vao);
+        glBindVertexArray(t.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, cube.vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube.ebo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
 
-        float quad[] = {
-            cx - size,
-            cy + size,
-            0,
-            1,
-            cx - size,
-            cy - size,
-            0,
-            0,
-            cx + size,
-            cy - size,
-            1,
-            0,
+        // refilled every frame in render()
+        glBindBuffer(GL_ARRAY_BUFFER, t.vbo);
+        for (int i = 0; i < 4; i++)
+        {
+            glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)(i * sizeof(glm::vec4)));
+            glEnableVertexAttribArray(2 + i);
+            glVertexAttribDivisor(2 + i, 1);
+        }
 
-            cx - size,
-            cy + size,
-            0,
-            1,
-            cx + size,
-            cy - size,
-            1,
-            0,
-            cx + size,
-            cy + size,
-            1,
-            1,
-        };
+        glBindVertexArray(0);
+    }
 
-        glGenVertexArrays(1, &c.vao);
-        glGenBuffers(1, &c.vbo);
+    // Outline box index of every wall cell (wall cells numbered row-major).
+    static std::vector<uint32_t> wallCellBoxes(const Maze &maze)
+    {
+        // wall cell number of a row's first wall cell; the rest follow by popcount
+        std::vector<uint32_t> rowStart((size_t)maze.gridHeight + 1, 0);
+        for (int r = 0; r < maze.gridHeight; r++)
+            rowStart[(size_t)r + 1] = rowStart[(size_t)r] + (uint32_t)maze.solid.countRow(r, 0, maze.gridWidth);
+
+        std::vector<uint32_t> out(rowStart.back(), 0);
+        const float inset = 0.5f * maze.cellSize;
+        for (size_t k = 0; k < maze.walls.size(); k++)
+        {
+            const AABB &b = maze.walls[k];
+            int c0, r0, c1, r1;
+            worldToCell(maze, b.min.x + inset, b.min.z + inset, c0, r0);
+            worldToCell(maze, b.max.x - inset, b.max.z - inset, c1, r1);
+            // every cell of a box is a wall, so its numbers run consecutively
+            for (int r = r0; r <= r1; r++)
+            {
+                uint32_t first = rowStart[(size_t)r] + (uint32_t)maze.solid.countRow(r, 0, c0);
+                for (int c = c0; c <= c1; c++)
+                    out[first + (uint32_t)(c - c0)] = (uint32_t)k;
+            }
+        }
+        return out;
+    }
 
-        glBindVertexArray(c.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, c.vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    // Loads the PVS cache when it was built for this maze, otherwise rebuilds and rewrites it.
+    static void setupPvs(RenderResources &g, const Maze &maze, JobSystem &jobs)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        PvsParams params;
+        bool cached = loadPvs(g.pvs, kPvsCachePath, pvsKey(maze, params));
+        if (!cached)
+        {
+            g.pvs = buildPvs(maze, params, &jobs);
+            if (!savePvs(g.pvs, kPvsCachePath))
+                std::cout << "Cannot write " << kPvsCachePath << std::endl;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        size_t total = 0, cells = 0;
+        std::vector<uint32_t> walls;
+        for (int r = 0; r < maze.gridHeight; r++)
+            for (int c = 0; c < maze.gridWidth; c++)
+            {
+                walls.clear();
+                if (!pvsVisibleWalls(g.pvs, c, r, walls))
+                    continue;
+                total += walls.size();
+                cells++;
+            }
+        std::printf("PVS: %s in %.1f ms, %zu bytes, %.1f of %u wall cells visible per cell on average\n", cached ? "loaded" : "built", ms,
+                    g.pvs.data.size(), (double)total / (double)std::max<size_t>(1, cells), g.pvs.wallCount);
+        g.wallCellBox = wallCellBoxes(maze);
+    }
+
+    static void uploadWallMesh(GlMesh &m, const WallMeshData &data)
+    {
+        glGenVertexArrays(1, &m.vao);
+        glGenBuffers(1, &m.vbo);
+        glGenBuffers(1, &m.ebo);
+
+        glBindVertexArray(m.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
+        glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(float), data.vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(unsigned int), data.indices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
         glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+    }
+
+    static void setupWallMesh(RenderResources &g, const Maze &maze)
+    {
+        WallMeshData data = bakeWallMesh(maze);
+        uploadWallMesh(g.wallMesh, data);
+        g.wallIndexCount = (GLsizei)data.indices.size();
+        g.wallRanges = std::move(data.ranges);
+        g.wallRangeBoxes.clear();
+        for (const auto &range : g.wallRanges)
+            g.wallRangeBoxes.add(range.box);
+    }
+
+    // Grid mazes keep the occupancy-grid queries, which are cheaper than any
+    // tree walk; walls without a grid go through the BVH. Both return exactly
+    // the same result as the linear scans. Streamed maps ask the resident
+    // chunks, where anything not loaded yet counts as a wall.
+    static float nearestWall(const AppState &s, const glm::vec3 &origin, const glm::vec3 &dir)
+    {
+        if (s.gfx.streamer)
+        {
+            std::shared_ptr<const ChunkGridSet> grids = s.gfx.streamer->residentGrids();
+            return nearestWallT(s.maze, origin, dir, [&](int c, int r)
+                                { return grids->wallAt(c, r); });
+        }
+        if (s.maze.gridWidth > 0)
+            return nearestWallT(s.maze, origin, dir);
+        return bvhClosestHit(s.wallBvh, origin, dir);
+    }
+
+    static bool blockedByWall(const AppState &s, const glm::vec3 &pos, float radius)
+    {
+        if (s.gfx.streamer)
+        {
+            std::shared_ptr<const ChunkGridSet> grids = s.gfx.streamer->residentGrids();
+            return isBlocked(s.maze, pos, radius, [&](int c, int r)
+                             { return grids->wallAt(c, r); });
+        }
+        if (s.maze.gridWidth > 0)
+            return isBlocked(s.maze, pos, radius);
+        return bvhOverlapsCircleXZ(s.wallBvh, pos, radius);
+    }
+
+    // A cell the player can walk to, favouring ones away from and hidden from
+    // the player. Wall-only maps, which have no regions, take any open cell.
+    static glm::vec3 spawnPosition(AppState &s)
+    {
+        int col = 0, row = 0;
+        worldToCell(s.maze, s.camera.Position.x, s.camera.Position.z, col, row);
+        const uint32_t region = regionAt(s.maze, col, row);
+        if (region == kNoRegion)
+            return randomEmptyCell(s.maze, s.rng);
+
+        glm::vec3 p(0.0f);
+        for (int i = 0; i < kSpawnTries; i++)
+        {
+            p = cellCenter(s.maze, randomRegionCell(s.maze, region, s.rng));
+            const glm::vec3 eye(p.x, s.camera.Position.y, p.z);
+            const float dist = glm::length(eye - s.camera.Position);
+            if (dist >= kSpawnMinDistance && nearestWall(s, s.camera.Position, (eye - s.camera.Position) / dist) < dist)
+                break;
+        }
+        return p;
     }
 
     static void respawnDeadTargets(AppState &s)
     {
-        s.spawnTimer += s.deltaTime;
+        s.spawnTimer += kSimDt;
         if (s.spawnTimer < kRespawnInterval)
             return;
         s.spawnTimer = 0.0f;
 
-        for (auto &t : s.targets)
-        {
-            if (t.alive)
-                continue;
-            glm::vec3 p = randomEmptyCell(s.maze, s.rng);
-            t.pos = {p.x, kEnemyY, p.z};
-            t.alive = true;
-            break;
-        }
+        if (!s.targets.hasDead())
+            return;
+        glm::vec3 p = spawnPosition(s);
+        s.targets.respawn({p.x, kEnemyY, p.z});
+        s.pathsStale = true;
     }
 
     static void shoot(AppState &s)
     {
         glm::vec3 rayDir = glm::normalize(s.camera.Front);
-        float wallT = nearestWallT(s.maze, s.camera.Position, rayDir);
+        float wallT = nearestWall(s, s.camera.Position, rayDir);
 
-        float bestT = std::numeric_limits<float>::infinity();
-        Target *best = nullptr;
-        for (auto &t : s.targets)
+        float tHit = 0.0f;
+        int hit = raycastTargets(s.targets, s.camera.Position, rayDir, wallT, tHit);
+        if (hit >= 0)
         {
-            if (!t.alive)
-                continue;
-            float tHit = 0.0f;
-            if (!raySphere(s.camera.Position, rayDir, t.pos, kEnemyRadius, tHit))
-                continue;
-            if (tHit >= wallT)
-                continue;
-            if (tHit < bestT)
-            {
-                bestT = tHit;
-                best = &t;
-            }
+            s.targets.kill((size_t)hit);
+            s.pathsStale = true;
         }
-
-        if (best)
-            best->alive = false;
     }
 
-    static void updateDelta(AppState &s)
+    // Adds the elapsed real time to the accumulator and returns how many
+    // fixed ticks to run; after a long hitch the backlog is dropped instead
+    // of running an ever-growing number of catch-up ticks.
+    static int consumeFrameTime(AppState &s)
     {
-        float current = (float)glfwGetTime();
-        s.deltaTime = current - s.lastFrame;
-        s.lastFrame = current;
+        double now = glfwGetTime();
+        s.accumulator += std::min(now - s.lastFrame, kMaxFrameTime);
+        s.lastFrame = now;
+
+        int steps = (int)(s.accumulator / kSimDt);
+        if (steps > kMaxSimStepsPerFrame)
+        {
+            steps = kMaxSimStepsPerFrame;
+            s.accumulator = steps * (double)kSimDt;
+        }
+        return steps;
     }
 
-    static void movePlayer(AppState &s)
+    static void movePlayer(AppState &s, uint8_t keys)
     {
         float speed = 3.0f;
-        if (glfwGetKey(s.window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+        if (keys & KEY_SPRINT)
             speed = 5.0f;
 
         glm::vec3 forward = glm::vec3(s.camera.Front.x, 0.0f, s.camera.Front.z);
@@ -710,113 +833,502 @@ namespace
         glm::vec3 right = glm::normalize(glm::cross(forward, s.camera.Up));
 
         glm::vec3 move(0.0f);
-        if (glfwGetKey(s.window, GLFW_KEY_W) == GLFW_PRESS)
+        if (keys & KEY_FORWARD)
             move += forward;
-        if (glfwGetKey(s.window, GLFW_KEY_S) == GLFW_PRESS)
+        if (keys & KEY_BACKWARD)
             move -= forward;
-        if (glfwGetKey(s.window, GLFW_KEY_A) == GLFW_PRESS)
+        if (keys & KEY_LEFT)
             move -= right;
-        if (glfwGetKey(s.window, GLFW_KEY_D) == GLFW_PRESS)
+        if (keys & KEY_RIGHT)
             move += right;
 
         if (glm::length(move) > 0.0f)
         {
-            move = glm::normalize(move) * speed * s.deltaTime;
+            move = glm::normalize(move) * speed * kSimDt;
 
             glm::vec3 next = s.camera.Position;
             next.x += move.x;
-            if (!isBlocked(s.maze, next, kPlayerRadius))
+            if (!blockedByWall(s, next, kPlayerRadius))
                 s.camera.Position.x = next.x;
 
             next = s.camera.Position;
             next.z += move.z;
-            if (!isBlocked(s.maze, next, kPlayerRadius))
+            if (!blockedByWall(s, next, kPlayerRadius))
                 s.camera.Position.z = next.z;
         }
 
         s.camera.Position.y = kPlayerEyeHeight;
     }
 
-    static void processInput(AppState &s)
+    static bool nextToCell(CellCoord a, int col, int row)
+    {
+        return std::abs(a.col - col) + std::abs(a.row - row) <= 1;
+    }
+
+    // Targets head for the player's cell. Near the player they step down the
+    // flow field, one lookup each; the others follow their own paths, which
+    // are planned as one batch on the job system when the player changes
+    // cell, when target indices have moved, and every kReplanTicks, and
+    // refined only a few cells ahead. A target whose path no longer starts
+    // next to it (it left the field somewhere else) gets a new one.
+    static void moveTargets(AppState &s)
+    {
+        TargetPool &targets = s.targets;
+        if (targets.liveCount == 0 || !s.flow)
+            return;
+        int col, row;
+        worldToCell(s.maze, s.camera.Position.x, s.camera.Position.z, col, row);
+        if (!s.maze.solid.contains(col, row) || s.maze.solid.get(col, row))
+            return;
+        const CellCoord goal{(int16_t)col, (int16_t)row};
+        const FlowField &flow = *s.flow;
+        s.flow->setGoal(goal);
+        s.flow->update();
+
+        const bool replanAll = s.pathsStale || goal.col != s.pathGoal.col || goal.row != s.pathGoal.row || s.tick - s.pathTick >= kReplanTicks;
+        s.targetPaths.resize(targets.liveCount);
+        s.targetPathNext.resize(targets.liveCount, 1);
+        s.pathRequests.clear();
+        s.pathTargets.clear();
+        for (size_t i = 0; i < targets.liveCount; i++)
+        {
+            worldToCell(s.maze, targets.x[i], targets.z[i], col, row);
+            if (flow.distance(col, row) != FlowField::kUnreached)
+                continue;
+            const PathPlan &plan = s.targetPaths[i];
+            // paths that were not found wait for the next full replan
+            if (!replanAll && (!plan.found() || nextToCell(plan.cells[std::min(s.targetPathNext[i], plan.cells.size() - 1)], col, row)))
+                continue;
+            s.pathRequests.push_back({{(int16_t)col, (int16_t)row}, goal});
+            s.pathTargets.push_back(i);
+        }
+        if (!s.pathRequests.empty())
+        {
+            planPaths(s.pathGraph, s.maze, s.pathRequests, s.plannedPaths, kEnemyPathAhead, s.jobs, &s.pathCache);
+            for (size_t k = 0; k < s.pathTargets.size(); k++)
+            {
+                std::swap(s.targetPaths[s.pathTargets[k]], s.plannedPaths[k]);
+                // cell 0 is the one the target stands in
+                s.targetPathNext[s.pathTargets[k]] = 1;
+            }
+        }
+        if (replanAll)
+        {
+            s.pathGoal = goal;
+            s.pathTick = s.tick;
+            s.pathsStale = false;
+        }
+
+        const glm::vec2 player(s.camera.Position.x, s.camera.Position.z);
+        s.jobs->parallelFor(targets.liveCount, kTargetJobGrain, [&](size_t begin, size_t end)
+                            {
+                                for (size_t i = begin; i < end; i++)
+                                {
+                                    PathPlan &plan = s.targetPaths[i];
+                                    size_t &next = s.targetPathNext[i];
+                                    glm::vec3 pos = targets.position(i);
+                                    float step = kEnemySpeed * kSimDt;
+                                    while (step > 0.0f)
+                                    {
+                                        if (glm::length(glm::vec2(pos.x, pos.z) - player) < kEnemyStopDistance)
+                                            break;
+                                        int c, r;
+                                        worldToCell(s.maze, pos.x, pos.z, c, r);
+                                        CellCoord cell;
+                                        const bool onField = flow.distance(c, r) != FlowField::kUnreached;
+                                        if (onField)
+                                        {
+                                            if (!flow.step(c, r, cell))
+                                                break;
+                                        }
+                                        else
+                                        {
+                                            if (!plan.found() ||
+                                                (next >= plan.cells.size() && refinePath(s.pathGraph, s.maze, plan, next + kEnemyPathAhead, &s.pathCache) <= next))
+                                                break;
+                                            cell = plan.cells[next];
+                                            if (!nextToCell(cell, c, r))
+                                                break;
+                                        }
+                                        glm::vec3 to = cellCenter(s.maze, cell);
+                                        to.y = kEnemyY;
+                                        glm::vec3 d = to - pos;
+                                        float len = glm::length(d);
+                                        if (len <= step)
+                                        {
+                                            pos = to;
+                                            step -= len;
+                                            next += !onField;
+                                        }
+                                        else
+                                        {
+                                            pos += d * (step / len);
+                                            step = 0.0f;
+                                        }
+                                    }
+                                    targets.setPosition(i, pos);
+                                } });
+    }
+
+    // Per-frame input that is not part of the simulation.
+    static void processInput(AppState &s, bool &wasPressed)
     {
         if (glfwGetKey(s.window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(s.window, true);
 
-        movePlayer(s);
+        // a click between two ticks is latched and fired on the next tick
+        bool pressed = glfwGetMouseButton(s.window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        if (pressed && !wasPressed)
+            s.shootQueued = true;
+        wasPressed = pressed;
+    }
+
+    static TickInput sampleInput(AppState &s)
+    {
+        if (s.replaying)
+            return s.replay.next(s.tick);
+
+        TickInput in;
+        if (glfwGetKey(s.window, GLFW_KEY_W) == GLFW_PRESS)
+            in.keys |= KEY_FORWARD;
+        if (glfwGetKey(s.window, GLFW_KEY_S) == GLFW_PRESS)
+            in.keys |= KEY_BACKWARD;
+        if (glfwGetKey(s.window, GLFW_KEY_A) == GLFW_PRESS)
+            in.keys |= KEY_LEFT;
+        if (glfwGetKey(s.window, GLFW_KEY_D) == GLFW_PRESS)
+            in.keys |= KEY_RIGHT;
+        if (glfwGetKey(s.window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+            in.keys |= KEY_SPRINT;
+        in.fire = s.shootQueued;
+        in.mouseDx = s.pendingMouseDx;
+        in.mouseDy = s.pendingMouseDy;
+
+        s.shootQueued = false;
+        s.pendingMouseDx = 0.0f;
+        s.pendingMouseDy = 0.0f;
+        return in;
+    }
+
+    // Everything that changes game state goes through here with a TickInput,
+    // so live play and replays run the exact same code.
+    static void simulateTick(AppState &s)
+    {
+        TickInput in = sampleInput(s);
+        s.recorder.write(s.tick, in);
+
+        s.prevCameraPos = s.camera.Position;
+        TargetPool &targets = s.targets;
+        s.jobs->parallelFor(targets.liveCount, kTargetJobGrain, [&](size_t begin, size_t end)
+                            {
+                                for (size_t i = begin; i < end; i++)
+                                    targets.prevPos[i] = targets.position(i); });
+
+        s.camera.processMouse(in.mouseDx, in.mouseDy);
+        movePlayer(s, in.keys);
+        moveTargets(s);
+        if (in.fire)
+            shoot(s);
+        respawnDeadTargets(s);
+        s.tick++;
+    }
+
+    static GLuint setupCameraUbo()
+    {
+        GLuint ubo = 0;
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, kCameraBlockBinding, ubo);
+        return ubo;
+    }
+
+    static void resolveUniforms(UniformHandles &u, const Shader &shader, const Shader &crossShader, const Shader &wallShader, const Shader &edgeShader)
+    {
+        u.scene.model = shader.uniform("model");
+        u.scene.color = shader.uniform("color");
+        u.wall.tex = wallShader.uniform("tex");
+        u.edge.color = edgeShader.uniform("color");
+        u.cross.ortho = crossShader.uniform("ortho");
+    }
+
+    // Wall cells in the PVS of the camera's cell, plus those of the previous
+    // tick's cell while the interpolated eye may still be there, and the outline
+    // boxes covering them. False when there is no PVS for those cells (no cache
+    // built, or the eye left the grid); then every wall is a candidate.
+    static bool gatherPvs(RenderResources &g, const FrameSnapshot &f)
+    {
+        g.pvsCells.clear();
+        if (!pvsVisibleWalls(g.pvs, f.eyeCol, f.eyeRow, g.pvsCells))
+            return false;
+        if (f.prevEyeCol != f.eyeCol || f.prevEyeRow != f.eyeRow)
+        {
+            if (!pvsVisibleWalls(g.pvs, f.prevEyeCol, f.prevEyeRow, g.pvsCells))
+                return false;
+            std::sort(g.pvsCells.begin(), g.pvsCells.end());
+            g.pvsCells.erase(std::unique(g.pvsCells.begin(), g.pvsCells.end()), g.pvsCells.end());
+        }
+
+        // merged walls cover several cells each
+        g.pvsWalls.clear();
+        for (uint32_t c : g.pvsCells)
+            g.pvsWalls.push_back(g.wallCellBox[c]);
+        std::sort(g.pvsWalls.begin(), g.pvsWalls.end());
+        g.pvsWalls.erase(std::unique(g.pvsWalls.begin(), g.pvsWalls.end()), g.pvsWalls.end());
+        return true;
+    }
+
+    // Uploads the chunks the streamer finished since the last frame and frees
+    // the evicted ones. Runs on the render thread, which owns the GL objects.
+    static void streamChunks(RenderResources &g, const glm::vec3 &eye)
+    {
+        g.loadedChunks.clear();
+        g.evictedChunks.clear();
+        g.streamer->update(eye, g.loadedChunks, g.evictedChunks);
+        if (g.loadedChunks.empty() && g.evictedChunks.empty())
+            return;
+
+        for (uint32_t id : g.evictedChunks)
+        {
+            auto it = std::find_if(g.chunks.begin(), g.chunks.end(), [&](const GlChunk &c)
+                                   { return c.id == id; });
+            if (it == g.chunks.end())
+                continue;
+            glDeleteVertexArrays(1, &it->mesh.vao);
+            glDeleteBuffers(1, &it->mesh.vbo);
+            glDeleteBuffers(1, &it->mesh.ebo);
+            if (&*it != &g.chunks.back())
+                *it = std::move(g.chunks.back());
+            g.chunks.pop_back();
+        }
+        for (auto &data : g.loadedChunks)
+        {
+            GlChunk c;
+            c.id = data->id;
+            c.box = data->box;
+            uploadWallMesh(c.mesh, data->mesh);
+            c.ranges = std::move(data->mesh.ranges);
+            for (const auto &range : c.ranges)
+                c.rangeBoxes.add(range.box);
+            for (const auto &box : data->walls)
+            {
+                c.wallModels.push_back(boxModel(box));
+                c.wallBoxes.add(box);
+            }
+            g.chunks.push_back(std::move(c));
+        }
+
+        g.chunkBoxes.clear();
+        for (const auto &c : g.chunks)
+            g.chunkBoxes.add(c.box);
+    }
+
+    // Whole chunks first, then the wall cells and outline boxes of the ones
+    // that survive.
+    static void cullChunks(RenderResources &g, const Frustum &frustum)
+    {
+        cullBoxes(frustum, g.chunkBoxes, g.visibleChunks);
+        for (uint32_t i : g.visibleChunks)
+        {
+            GlChunk &c = g.chunks[i];
+            cullBoxes(frustum, c.rangeBoxes, c.visibleCells);
+            cullBoxes(frustum, c.wallBoxes, c.visibleWalls);
+        }
     }
 
-    static void render(AppState &s, Shader &shader, Shader &crossShader, Shader &texShader)
+    // Draw ranges of the visible cells, with cells that are adjacent in the
+    // index buffer merged into one range.
+    static void buildWallDraws(RenderResources &g, const std::vector<WallMeshRange> &ranges, const std::vector<uint32_t> &visible)
     {
+        g.drawCounts.clear();
+        g.drawOffsets.clear();
+        unsigned int runEnd = ~0u;
+        for (uint32_t c : visible)
+        {
+            const WallMeshRange &range = ranges[c];
+            if (range.firstIndex == runEnd)
+                g.drawCounts.back() += (GLsizei)range.indexCount;
+            else
+            {
+                g.drawCounts.push_back((GLsizei)range.indexCount);
+                g.drawOffsets.push_back((const void *)(range.firstIndex * sizeof(unsigned int)));
+            }
+            runEnd = range.firstIndex + range.indexCount;
+        }
+    }
+
+    static void captureSnapshot(const AppState &s, FrameSnapshot &f)
+    {
+        f.width = s.width;
+        f.height = s.height;
+        f.prevEye = s.prevCameraPos;
+        f.eye = s.camera.Position;
+        f.front = s.camera.Front;
+        f.up = s.camera.Up;
+        worldToCell(s.maze, f.eye.x, f.eye.z, f.eyeCol, f.eyeRow);
+        worldToCell(s.maze, f.prevEye.x, f.prevEye.z, f.prevEyeCol, f.prevEyeRow);
+        f.tickTime = s.lastFrame - s.accumulator;
+        const TargetPool &t = s.targets;
+        f.prevTargets.assign(t.prevPos.begin(), t.prevPos.begin() + (std::ptrdiff_t)t.liveCount);
+        f.targets.resize(t.liveCount);
+        for (size_t i = 0; i < t.liveCount; i++)
+            f.targets[i] = t.position(i);
+    }
+
+    static RenderStats render(RenderResources &g, const FrameSnapshot &f, float alpha, JobSystem &jobs, Shader &shader, Shader &crossShader,
+                              Shader &wallShader, Shader &edgeShader)
+    {
+        const UniformHandles &u = g.u;
         glClearColor(0.25f, 0.25f, 0.25f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        shader.use();
-        glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)s.width / s.height, 0.1f, 100.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "projection"), 1, GL_FALSE, &proj[0][0]);
-
-        glm::mat4 view = s.camera.getView();
-        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "view"), 1, GL_FALSE, &view[0][0]);
+        // camera matrices go to the shared uniform block once per frame
+        CameraBlock cam;
+        cam.projection = glm::perspective(glm::radians(45.0f), (float)f.width / f.height, 0.1f, 100.0f);
+        glm::vec3 eye = glm::mix(f.prevEye, f.eye, alpha);
+        cam.view = glm::lookAt(eye, eye + f.front, f.up);
+        cam.viewProjection = cam.projection * cam.view;
+        cam.position = glm::vec4(eye, 1.0f);
+        glBindBuffer(GL_UNIFORM_BUFFER, g.cameraUbo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &cam);
+
+        // walls: the camera cell's PVS when there is one, then frustum culling;
+        // wall cells on a worker, outline boxes and targets here. Streamed maps
+        // cull the resident chunks instead, all of it on the worker.
+        Frustum frustum = frustumFromMatrix(cam.viewProjection);
+        const bool streaming = g.streamer != nullptr;
+        if (streaming)
+            streamChunks(g, eye);
+        bool usePvs = !streaming && gatherPvs(g, f);
+        JobHandle cellJob = jobs.submit([&]
+                                        {
+                                            if (streaming)
+                                                cullChunks(g, frustum);
+                                            else if (usePvs)
+                                                cullBoxIndices(frustum, g.wallRangeBoxes, g.pvsCells, g.visibleCells);
+                                            else
+                                                cullBoxes(frustum, g.wallRangeBoxes, g.visibleCells); });
+        if (streaming)
+            g.visibleWalls.clear();
+        else if (usePvs)
+            cullBoxIndices(frustum, g.wallInstances.boxes, g.pvsWalls, g.visibleWalls);
+        else
+            cullBoxes(frustum, g.wallInstances.boxes, g.visibleWalls);
+
+        TargetInstances &ti = g.targetInstances;
+        ti.boxes.resize(f.targets.size());
+        jobs.parallelFor(f.targets.size(), kTargetJobGrain, [&](size_t begin, size_t end)
+                         {
+                             for (size_t i = begin; i < end; i++)
+                                 ti.boxes.set(i, glm::mix(f.prevTargets[i], f.targets[i], alpha), glm::vec3(0.5f)); });
+        cullBoxes(frustum, ti.boxes, g.visibleTargets);
+        jobs.wait(cellJob);
+
+        RenderStats stats;
+        if (streaming)
+        {
+            // "pvs" here is the wall cells of the chunks in the frustum
+            for (const GlChunk &c : g.chunks)
+            {
+                stats.wallCells += c.ranges.size();
+                stats.wallBoxes += c.wallModels.size();
+            }
+            for (uint32_t i : g.visibleChunks)
+            {
+                const GlChunk &c = g.chunks[i];
+                stats.wallCellsPvs += c.ranges.size();
+                stats.wallCellsVisible += c.visibleCells.size();
+                stats.wallBoxesVisible += c.visibleWalls.size();
+            }
+        }
+        else
+        {
+            stats.wallCells = g.wallRanges.size();
+            stats.wallCellsPvs = usePvs ? g.pvsCells.size() : g.wallRanges.size();
+            stats.wallCellsVisible = g.visibleCells.size();
+            stats.wallBoxes = g.wallInstances.models.size();
+            stats.wallBoxesVisible = g.visibleWalls.size();
+        }
+        stats.targets = f.targets.size();
+        stats.targetsVisible = g.visibleTargets.size();
 
-        glBindVertexArray(s.cube.vao);
+        shader.use();
+        glBindVertexArray(g.cube.vao);
 
         // floor
-        float mazeW = (float)kMazeGrid[0].size() * s.maze.cellSize;
-        float mazeH = (float)kMazeGrid.size() * s.maze.cellSize;
-        glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), {0, -0.05f, 0}), {mazeW, 0.1f, mazeH});
-        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, &model[0][0]);
-        glUniform3f(glGetUniformLocation(shader.ID, "color"), 0.35f, 0.35f, 0.35f);
+        glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), {0, -0.05f, 0}), {g.floorSize.x, 0.1f, g.floorSize.y});
+        shader.setMat4(u.scene.model, model);
+        shader.setVec3(u.scene.color, {0.35f, 0.35f, 0.35f});
         glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 
-        // walls (textured)
-        texShader.use();
-        glUniformMatrix4fv(glGetUniformLocation(texShader.ID, "projection"), 1, GL_FALSE, &proj[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(texShader.ID, "view"), 1, GL_FALSE, &view[0][0]);
+        // walls (textured): visible cells of the baked mesh, one multi-draw;
+        // streamed maps issue one per visible chunk
+        wallShader.use();
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, s.wallTexture);
-        glUniform1i(glGetUniformLocation(texShader.ID, "tex"), 0);
-        glBindVertexArray(s.texturedCube.vao);
+        glBindTexture(GL_TEXTURE_2D, g.wallTexture);
+        wallShader.setInt(u.wall.tex, 0);
 
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(1.0f, 1.0f);
-        for (const auto &box : s.maze.walls)
+        if (streaming)
+        {
+            for (uint32_t i : g.visibleChunks)
+            {
+                const GlChunk &c = g.chunks[i];
+                buildWallDraws(g, c.ranges, c.visibleCells);
+                if (g.drawCounts.empty())
+                    continue;
+                glBindVertexArray(c.mesh.vao);
+                glMultiDrawElements(GL_TRIANGLES, g.drawCounts.data(), GL_UNSIGNED_INT, g.drawOffsets.data(), (GLsizei)g.drawCounts.size());
+                stats.wallDraws += g.drawCounts.size();
+            }
+        }
+        else
         {
-            glm::vec3 center = (box.min + box.max) * 0.5f;
-            glm::vec3 size = (box.max - box.min);
-            model = glm::scale(glm::translate(glm::mat4(1.0f), center), size);
-            glUniformMatrix4fv(glGetUniformLocation(texShader.ID, "model"), 1, GL_FALSE, &model[0][0]);
-            float uScale = std::max(size.x, size.z);
-            float vScale = size.y;
-            glUniform2f(glGetUniformLocation(texShader.ID, "uvScale"), uScale, vScale);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            buildWallDraws(g, g.wallRanges, g.visibleCells);
+            stats.wallDraws = g.drawCounts.size();
+            glBindVertexArray(g.wallMesh.vao);
+            if (!g.drawCounts.empty())
+                glMultiDrawElements(GL_TRIANGLES, g.drawCounts.data(), GL_UNSIGNED_INT, g.drawOffsets.data(), (GLsizei)g.drawCounts.size());
         }
         glDisable(GL_POLYGON_OFFSET_FILL);
 
-        // wall outline without diagonals (edges only)
-        shader.use();
-        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "projection"), 1, GL_FALSE, &proj[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "view"), 1, GL_FALSE, &view[0][0]);
-        glBindVertexArray(s.cubeEdges.vao);
-        glLineWidth(2.0f);
-        glUniform3f(glGetUniformLocation(shader.ID, "color"), 0.05f, 0.06f, 0.08f);
-        for (const auto &box : s.maze.walls)
+        // wall outline without diagonals (edges only), one instanced draw of the visible walls
+        g.visibleWallModels.resize(g.visibleWalls.size());
+        for (size_t i = 0; i < g.visibleWalls.size(); i++)
+            g.visibleWallModels[i] = g.wallInstances.models[g.visibleWalls[i]];
+        for (uint32_t i : g.visibleChunks)
+            for (uint32_t w : g.chunks[i].visibleWalls)
+                g.visibleWallModels.push_back(g.chunks[i].wallModels[w]);
+        if (!g.visibleWallModels.empty())
         {
-            glm::vec3 center = (box.min + box.max) * 0.5f;
-            glm::vec3 size = (box.max - box.min);
-            model = glm::scale(glm::translate(glm::mat4(1.0f), center), size);
-            glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, &model[0][0]);
-            glDrawArrays(GL_LINES, 0, 24);
+            glBindBuffer(GL_ARRAY_BUFFER, g.wallInstances.vbo);
+            glBufferData(GL_ARRAY_BUFFER, std::max(g.wallInstances.models.size(), g.visibleWallModels.size()) * sizeof(glm::mat4), nullptr,
+                         GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, g.visibleWallModels.size() * sizeof(glm::mat4), g.visibleWallModels.data());
+            edgeShader.use();
+            glBindVertexArray(g.wallInstances.edgesVao);
+            glLineWidth(2.0f);
+            edgeShader.setVec3(u.edge.color, {0.05f, 0.06f, 0.08f});
+            glDrawArraysInstanced(GL_LINES, 0, 24, (GLsizei)g.visibleWallModels.size());
         }
 
-        // targets
-        glBindVertexArray(s.cube.vao);
-        for (const auto &t : s.targets)
+        // targets: transforms of the visible ones built on the job system, one instanced draw
+        ti.models.resize(g.visibleTargets.size());
+        jobs.parallelFor(ti.models.size(), kTargetJobGrain, [&](size_t begin, size_t end)
+                         {
+                             for (size_t i = begin; i < end; i++)
+                             {
+                                 uint32_t t = g.visibleTargets[i];
+                                 ti.models[i] = glm::translate(glm::mat4(1.0f), glm::vec3(ti.boxes.cx[t], ti.boxes.cy[t], ti.boxes.cz[t]));
+                             } });
+        if (!ti.models.empty())
         {
-            if (!t.alive)
-                continue;
-            model = glm::translate(glm::mat4(1.0f), t.pos);
-            glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, &model[0][0]);
-            glUniform3f(glGetUniformLocation(shader.ID, "color"), 1.0f, 0.2f, 0.2f);
-            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+            glBindBuffer(GL_ARRAY_BUFFER, ti.vbo);
+            glBufferData(GL_ARRAY_BUFFER, ti.models.size() * sizeof(glm::mat4), ti.models.data(), GL_STREAM_DRAW);
+            edgeShader.use();
+            edgeShader.setVec3(u.edge.color, {1.0f, 0.2f, 0.2f});
+            glBindVertexArray(ti.vao);
+            glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, (GLsizei)ti.models.size());
         }
 
         // crosshair
@@ -825,19 +1337,214 @@ namespace
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         crossShader.use();
-        glm::mat4 ortho = glm::ortho(0.0f, (float)s.width, 0.0f, (float)s.height);
-        glUniformMatrix4fv(glGetUniformLocation(crossShader.ID, "ortho"), 1, GL_FALSE, &ortho[0][0]);
-        glBindVertexArray(s.cross.vao);
-        glBindTexture(GL_TEXTURE_2D, s.cross.texture);
+        glm::mat4 ortho = glm::ortho(0.0f, (float)f.width, 0.0f, (float)f.height);
+        crossShader.setMat4(u.cross.ortho, ortho);
+        glBindVertexArray(g.cross.vao);
+        glBindTexture(GL_TEXTURE_2D, g.cross.texture);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
         glDisable(GL_BLEND);
         glEnable(GL_DEPTH_TEST);
+        return stats;
+    }
+
+    // Offscreen colour + depth target for headless runs.
+    struct OffscreenTarget
+    {
+        GLuint fbo = 0;
+        GLuint color = 0;
+        GLuint depth = 0;
+    };
+
+    static bool setupOffscreenTarget(OffscreenTarget &t, unsigned int w, unsigned int h)
+    {
+        glGenRenderbuffers(1, &t.color);
+        glBindRenderbuffer(GL_RENDERBUFFER, t.color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, (GLsizei)w, (GLsizei)h);
+        glGenRenderbuffers(1, &t.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, t.depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, (GLsizei)w, (GLsizei)h);
+
+        glGenFramebuffers(1, &t.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, t.fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, t.color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, t.depth);
+        return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    // Scripted camera for headless runs: walks the empty cells in order while turning.
+    static void scriptedCamera(AppState &s, int frame, int frames)
+    {
+        const auto &cells = s.maze.emptyCells;
+        if (cells.empty())
+            return;
+        float t = (float)frame / (float)std::max(1, frames - 1) * (float)(cells.size() - 1);
+        size_t i = std::min((size_t)t, cells.size() - 1);
+        size_t j = std::min(i + 1, cells.size() - 1);
+        glm::vec3 a = cellCenter(s.maze, cells[i]);
+        glm::vec3 p = a + (cellCenter(s.maze, cells[j]) - a) * (t - (float)i);
+        s.camera.Position = {p.x, kPlayerEyeHeight, p.z};
+        s.prevCameraPos = s.camera.Position;
+        s.camera.Yaw = -90.0f + (float)frame * 3.0f;
+        s.camera.Pitch = 0.0f;
+        s.camera.processMouse(0.0f, 0.0f);
+    }
+
+    static double percentile(std::vector<double> v, double p)
+    {
+        if (v.empty())
+            return 0.0;
+        std::sort(v.begin(), v.end());
+        return v[std::min(v.size() - 1, (size_t)(p * (double)(v.size() - 1) + 0.5))];
+    }
+
+    static void printTimingSummary(const char *name, const std::vector<double> &ms)
+    {
+        double sum = 0.0;
+        for (double v : ms)
+            sum += v;
+        std::printf("%-4s avg %8.3f  min %8.3f  p50 %8.3f  p95 %8.3f  max %8.3f ms\n", name, sum / (double)std::max<size_t>(1, ms.size()),
+                    percentile(ms, 0.0), percentile(ms, 0.5), percentile(ms, 0.95), percentile(ms, 1.0));
+    }
+
+    // Renders a fixed number of frames into an FBO along the scripted path and
+    // prints per-frame CPU (command submission) and GPU (GL_TIME_ELAPSED) times.
+    static int runHeadless(AppState &s, int frames, Shader &shader, Shader &crossShader, Shader &wallShader, Shader &edgeShader)
+    {
+        OffscreenTarget target;
+        if (!setupOffscreenTarget(target, s.width, s.height))
+        {
+            std::cout << "Offscreen framebuffer incomplete" << std::endl;
+            return 1;
+        }
+        glViewport(0, 0, (int)s.width, (int)s.height);
+
+        GLuint query = 0;
+        glGenQueries(1, &query);
+
+        // single-threaded: snapshot and render back to back on this thread
+        FrameSnapshot snapshot;
+        std::vector<double> cpuMs, gpuMs;
+        RenderStats total;
+        std::printf("frame,cpu_ms,gpu_ms,cells_pvs,cells_visible,wall_draws,walls_visible,targets_visible\n");
+        for (int frame = 0; frame < frames; frame++)
+        {
+            if (s.replaying)
+            {
+                // a replay drives the camera instead: fixed ticks per 60 Hz frame
+                if (s.replay.finished(s.tick))
+                    break;
+                for (int i = 0; i < kHeadlessTicksPerFrame; i++)
+                    simulateTick(s);
+            }
+            else
+                scriptedCamera(s, frame, frames);
+
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            auto t0 = std::chrono::steady_clock::now();
+            captureSnapshot(s, snapshot);
+            // frames land exactly on ticks
+            RenderStats stats = render(s.gfx, snapshot, 1.0f, *s.jobs, shader, crossShader, wallShader, edgeShader);
+            auto t1 = std::chrono::steady_clock::now();
+            glEndQuery(GL_TIME_ELAPSED);
+
+            // waits for the GPU, so frames never overlap
+            GLuint64 gpuNs = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuNs);
+
+            cpuMs.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+            gpuMs.push_back((double)gpuNs * 1e-6);
+            std::printf("%d,%.3f,%.3f,%zu,%zu,%zu,%zu,%zu\n", frame, cpuMs.back(), gpuMs.back(), stats.wallCellsPvs, stats.wallCellsVisible, stats.wallDraws,
+                        stats.wallBoxesVisible, stats.targetsVisible);
+            total.wallCells = stats.wallCells;
+            total.wallBoxes = stats.wallBoxes;
+            total.targets = stats.targets;
+            total.wallCellsPvs += stats.wallCellsPvs;
+            total.wallCellsVisible += stats.wallCellsVisible;
+            total.wallDraws += stats.wallDraws;
+            total.wallBoxesVisible += stats.wallBoxesVisible;
+            total.targetsVisible += stats.targetsVisible;
+        }
+
+        std::printf("%zu frames at %ux%u (%s)\n", cpuMs.size(), s.width, s.height, (const char *)glGetString(GL_RENDERER));
+        printTimingSummary("cpu", cpuMs);
+        printTimingSummary("gpu", gpuMs);
+        double n = (double)std::max<size_t>(1, cpuMs.size());
+        std::printf("visible (avg): wall cells %.1f / %.1f in PVS / %zu in %.1f draws, wall boxes %.1f / %zu, targets %.1f / %zu\n",
+                    total.wallCellsVisible / n, total.wallCellsPvs / n, total.wallCells, total.wallDraws / n, total.wallBoxesVisible / n, total.wallBoxes,
+                    total.targetsVisible / n, total.targets);
+
+        glDeleteQueries(1, &query);
+        return 0;
+    }
+
+    // A binary map is used as stored, with its cached BVH and path graph if it
+    // has them; anything else is read as a text grid. Falls back to the
+    // built-in maze.
+    static void loadMaze(AppState &s, const std::string &path)
+    {
+        if (!path.empty())
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            auto map = std::make_shared<MapFile>();
+            std::vector<std::string> grid;
+            bool loaded = false;
+            if (map->open(path))
+            {
+                // only grid-less maps query the BVH; the others use the grid
+                if (!mazeFromMapFile(map, s.maze, &s.wallBvh) && s.maze.gridWidth == 0)
+                    s.wallBvh = buildBvh(s.maze.walls);
+                pathGraphFromMapFile(map, s.pathGraph);
+                s.mapFile = map;
+                // maps written before region labels existed
+                if (s.maze.regionFirst.empty())
+                    labelRegions(s.maze, s.jobs);
+                loaded = true;
+            }
+            else if (loadTextGrid(path, grid))
+            {
+                s.maze = buildMazeFromGrid(grid, 1.0f, 1.75f, kMergeWalls, s.jobs);
+                loaded = true;
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            if (loaded)
+            {
+                std::cout << "Map: " << path << " (" << s.maze.gridWidth << "x" << s.maze.gridHeight << ") loaded in " << ms << " ms"
+                          << (map->isOpen() ? "" : " from text") << std::endl;
+                return;
+            }
+            std::cout << "Cannot load map " << path << ", using the built-in maze" << std::endl;
+        }
+        s.maze = buildMazeFromGrid(kMazeGrid, 1.0f, 1.75f, kMergeWalls, s.jobs);
+    }
+
+    static Options parseOptions(int argc, char **argv)
+    {
+        Options o;
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--headless") == 0)
+            {
+                o.headless = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-')
+                    o.frames = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+                o.recordPath = argv[++i];
+            else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+                o.replayPath = argv[++i];
+            else if (std::strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+                o.mapPath = argv[++i];
+            else if (std::strcmp(argv[i], "--stream") == 0)
+                o.stream = true;
+        }
+        return o;
     }
 
+    // Runs on the main thread, which has no GL context in windowed mode; the
+    // render thread picks the new size up from the next snapshot.
     static void framebufferSizeCallback(GLFWwindow *window, int w, int h)
     {
-        glViewport(0, 0, w, h);
         auto *s = (AppState *)glfwGetWindowUserPointer(window);
         if (!s)
             return;
@@ -862,13 +1569,18 @@ namespace
         s->lastX = (float)xpos;
         s->lastY = (float)ypos;
 
-        s->camera.processMouse(xoffset, yoffset);
+        // applied on the next simulation tick
+        s->pendingMouseDx += xoffset;
+        s->pendingMouseDy += yoffset;
     }
 } // namespace
 
-int main()
+int main(int argc, char **argv)
 {
     AppState s;
+    Options opt = parseOptions(argc, argv);
+    JobSystem jobs;
+    s.jobs = &jobs;
 
     if (!glfwInit())
     {
@@ -876,12 +1588,21 @@ int main()
         return 1;
     }
 
-    GLFWmonitor *monitor = glfwGetPrimaryMonitor();
-    const GLFWvidmode *mode = glfwGetVideoMode(monitor);
-    s.width = (unsigned int)mode->width;
-    s.height = (unsigned int)mode->height;
-
-    glfwWindowHint(GLFW_DECORATED, GLFW_FALSE);
+    if (opt.headless)
+    {
+        // hidden window only provides the context; frames go to an FBO
+        s.width = kHeadlessWidth;
+        s.height = kHeadlessHeight;
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+    else
+    {
+        GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode *mode = glfwGetVideoMode(monitor);
+        s.width = (unsigned int)mode->width;
+        s.height = (unsigned int)mode->height;
+        glfwWindowHint(GLFW_DECORATED, GLFW_FALSE);
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -895,7 +1616,8 @@ int main()
     }
 
     glfwMakeContextCurrent(s.window);
-    glfwSetWindowPos(s.window, 0, 0);
+    if (!opt.headless)
+        glfwSetWindowPos(s.window, 0, 0);
     glfwSetWindowUserPointer(s.window, &s);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -907,53 +1629,151 @@ int main()
     }
 
     glViewport(0, 0, (int)s.width, (int)s.height);
-    glfwSetFramebufferSizeCallback(s.window, framebufferSizeCallback);
-    glfwSetCursorPosCallback(s.window, mouseCallback);
-    glfwSetInputMode(s.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!opt.headless)
+    {
+        glfwSetFramebufferSizeCallback(s.window, framebufferSizeCallback);
+        glfwSetCursorPosCallback(s.window, mouseCallback);
+        glfwSetInputMode(s.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
     glEnable(GL_DEPTH_TEST);
 
     Shader shader("shaders/vertex.glsl", "shaders/fragment.glsl");
     Shader crossShader("shaders/cross_vert.glsl", "shaders/cross_frag.glsl");
-    Shader texShader("shaders/tex_vertex.glsl", "shaders/tex_fragment.glsl");
-
-    setupCubeMesh(s.cube);
-    setupTexturedCubeMesh(s.texturedCube);
-    setupCubeEdgesMesh(s.cubeEdges);
-    setupCrosshair(s.cross, s.width, s.height);
-    s.cross.texture = loadTextureRGBA("textures/crosshair.png");
-    s.wallTexture = loadTextureRGBARepeat("textures/blue_wall.jpg");
+    Shader wallShader("shaders/tex_vertex.glsl", "shaders/tex_fragment.glsl");
+    Shader edgeShader("shaders/vertex_instanced.glsl", "shaders/fragment.glsl");
+    resolveUniforms(s.gfx.u, shader, crossShader, wallShader, edgeShader);
+    s.gfx.cameraUbo = setupCameraUbo();
+
+    setupCubeMesh(s.gfx.cube);
+    setupCubeEdgesMesh(s.gfx.cubeEdges);
+    setupTargetInstances(s.gfx.targetInstances, s.gfx.cube);
+    setupCrosshair(s.gfx.cross, s.width, s.height);
+    s.gfx.cross.texture = loadTextureRGBA("textures/crosshair.png");
+    s.gfx.wallTexture = loadTextureRGBARepeat("textures/blue_wall.jpg");
+
+    if (!opt.replayPath.empty())
+    {
+        if (!s.replay.open(opt.replayPath) || s.replay.tickHz() != (uint16_t)kSimHz)
+        {
+            std::cout << "Cannot replay " << opt.replayPath << std::endl;
+            glfwDestroyWindow(s.window);
+            glfwTerminate();
+            return 1;
+        }
+        s.replaying = true;
+        s.seed = s.replay.seed();
+    }
+    s.rng.seed(s.seed);
+    std::cout << "RNG seed: " << s.seed << std::endl;
+    if (!opt.recordPath.empty() && !s.recorder.open(opt.recordPath, s.seed, (uint16_t)kSimHz))
+        std::cout << "Cannot record to " << opt.recordPath << std::endl;
 
-    s.maze = buildMazeFromGrid(kMazeGrid, 1.0f, 1.75f);
+    loadMaze(s, opt.mapPath);
+    s.flow = std::make_unique<FlowField>(s.maze, FlowFieldParams{kFlowRadius, kFlowCellsPerTick});
+    {
+        // a .fmap may carry the graph already; text grids and older files build it
+        const bool stored = !s.pathGraph.clusterFirstNode.empty();
+        auto t0 = std::chrono::steady_clock::now();
+        if (!stored)
+            s.pathGraph = buildPathGraph(s.maze, {}, &jobs);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        std::printf("Paths: %zu entrance nodes, %zu edges in %d x %d clusters, %s in %.0f ms\n", s.pathGraph.nodes.size(),
+                    s.pathGraph.edges.size(), s.pathGraph.clustersX, s.pathGraph.clustersY, stored ? "mapped" : "built", ms);
+    }
+    const size_t mazeCells = (size_t)s.maze.gridWidth * (size_t)s.maze.gridHeight;
+    if (opt.stream || mazeCells > kStreamMinCells)
+    {
+        s.gfx.streamer = std::make_unique<ChunkStreamer>(s.maze, ChunkStreamParams{}, s.mapFile);
+        setupWallInstances(s.gfx.wallInstances, {}, s.gfx.cubeEdges);
+        const ChunkStreamParams &sp = s.gfx.streamer->params();
+        std::printf("Maze: %d x %d cells streamed as %d x %d chunks of %d cells, radius %d, at most %zu resident\n", s.maze.gridWidth,
+                    s.maze.gridHeight, s.gfx.streamer->chunksX(), s.gfx.streamer->chunksY(), sp.chunkCells, sp.radius, sp.budget);
+    }
+    else
+    {
+        setupWallInstances(s.gfx.wallInstances, s.maze.walls, s.gfx.cubeEdges);
+        setupWallMesh(s.gfx, s.maze);
+        setupPvs(s.gfx, s.maze, jobs);
+        std::cout << "Maze: " << s.maze.wallCellCount << " wall cells -> " << s.maze.walls.size() << " wall boxes, "
+                  << s.gfx.wallIndexCount / 3 << " wall triangles (" << s.maze.wallCellCount * 12 << " as full cubes)" << std::endl;
+    }
+    s.gfx.floorSize = glm::vec2((float)s.maze.gridWidth, (float)s.maze.gridHeight) * s.maze.cellSize;
+    // the player starts in the largest region, so pockets never trap them
     if (!s.maze.emptyCells.empty())
-        s.camera.Position = s.maze.emptyCells.front() + glm::vec3(0.0f, kPlayerEyeHeight, 0.0f);
+    {
+        uint32_t largest = 0;
+        for (uint32_t r = 1; r < regionCount(s.maze); r++)
+            if (s.maze.regionFirst[r + 1] - s.maze.regionFirst[r] > s.maze.regionFirst[largest + 1] - s.maze.regionFirst[largest])
+                largest = r;
+        const CellCoord start = s.maze.emptyCells[s.maze.regionCells[s.maze.regionFirst[largest]]];
+        s.camera.Position = cellCenter(s.maze, start) + glm::vec3(0.0f, kPlayerEyeHeight, 0.0f);
+    }
+    s.prevCameraPos = s.camera.Position;
 
     s.targets.clear();
     for (int i = 0; i < kEnemyCount; i++)
     {
-        glm::vec3 p = randomEmptyCell(s.maze, s.rng);
-        s.targets.push_back({{p.x, kEnemyY, p.z}, true});
+        glm::vec3 p = spawnPosition(s);
+        glm::vec3 pos(p.x, kEnemyY, p.z);
+        s.targets.add(pos, kEnemyRadius);
+    }
+
+    if (opt.headless)
+    {
+        int rc = runHeadless(s, opt.frames, shader, crossShader, wallShader, edgeShader);
+        glfwDestroyWindow(s.window);
+        glfwTerminate();
+        return rc;
     }
 
     bool wasPressed = false;
+    s.lastFrame = glfwGetTime();
+
+    // The render thread owns the context from here on: it draws the newest
+    // snapshot and blocks in glfwSwapBuffers, while this thread keeps polling
+    // input and running ticks on time.
+    TripleBuffer<FrameSnapshot> frames;
+    captureSnapshot(s, frames.writeBuffer());
+    frames.publish();
+    std::atomic<bool> quit{false};
+
+    glfwMakeContextCurrent(nullptr);
+    std::thread renderThread([&]
+                             {
+                                 glfwMakeContextCurrent(s.window);
+                                 while (!quit.load(std::memory_order_acquire))
+                                 {
+                                     const FrameSnapshot &f = frames.read();
+                                     float alpha = (float)std::clamp((glfwGetTime() - f.tickTime) / kSimDt, 0.0, 1.0);
+                                     glViewport(0, 0, (int)f.width, (int)f.height);
+                                     render(s.gfx, f, alpha, jobs, shader, crossShader, wallShader, edgeShader);
+                                     glfwSwapBuffers(s.window);
+                                 }
+                                 glfwMakeContextCurrent(nullptr); });
 
     while (!glfwWindowShouldClose(s.window))
     {
-        updateDelta(s);
-        processInput(s);
-
-        bool pressed = glfwGetMouseButton(s.window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
-        if (pressed && !wasPressed)
-            shoot(s);
-        wasPressed = pressed;
+        processInput(s, wasPressed);
+        if (s.replaying && s.replay.finished(s.tick))
+            break;
 
-        respawnDeadTargets(s);
-        render(s, shader, crossShader, texShader);
+        int steps = consumeFrameTime(s);
+        for (int i = 0; i < steps; i++)
+        {
+            simulateTick(s);
+            s.accumulator -= kSimDt;
+        }
+        captureSnapshot(s, frames.writeBuffer());
+        frames.publish();
 
-        glfwSwapBuffers(s.window);
-        glfwPollEvents();
+        // sleep until the next tick is due, waking early for input
+        glfwWaitEventsTimeout(std::max(0.0, kSimDt - s.accumulator));
     }
 
+    quit.store(true, std::memory_order_release);
+    renderThread.join();
+
     glfwDestroyWindow(s.window);
     glfwTerminate();
     return 0;
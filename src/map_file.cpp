@@ -0,0 +1,668 @@
+#include "map_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(AABB) == 24 && sizeof(CellCoord) == 4, "map sections store AABB as raw floats and CellCoord as two int16");
+static_assert(sizeof(PathGraph::Edge) == 8, "map sections store path edges as two u32");
+static_assert(std::is_trivially_copyable<AABB>::value && std::is_trivially_copyable<BvhNode>::value &&
+                  std::is_trivially_copyable<CellCoord>::value && std::is_trivially_copyable<PathGraph::Edge>::value,
+              "map sections are copied byte for byte");
+
+static constexpr char kMagic[4] = {'F', 'M', 'A', 'P'};
+static constexpr uint64_t kSectionAlign = 64;
+
+static constexpr uint32_t makeTag(char a, char b, char c, char d)
+{
+    return (uint32_t)(unsigned char)a | (uint32_t)(unsigned char)b << 8 | (uint32_t)(unsigned char)c << 16 |
+           (uint32_t)(unsigned char)d << 24;
+}
+
+static constexpr uint32_t kTagGrid = makeTag('G', 'R', 'I', 'D');
+static constexpr uint32_t kTagWalls = makeTag('W', 'A', 'L', 'L');
+static constexpr uint32_t kTagEmpty = makeTag('E', 'M', 'P', 'T');
+static constexpr uint32_t kTagBvhNodes = makeTag('B', 'V', 'H', 'N');
+static constexpr uint32_t kTagBvhBoxes = makeTag('B', 'V', 'H', 'B');
+static constexpr uint32_t kTagBvhIds = makeTag('B', 'V', 'H', 'I');
+static constexpr uint32_t kTagCellRegion = makeTag('R', 'E', 'G', 'N');
+static constexpr uint32_t kTagRegionFirst = makeTag('R', 'G', 'N', 'F');
+static constexpr uint32_t kTagRegionCells = makeTag('R', 'G', 'N', 'C');
+static constexpr uint32_t kTagPathNodes = makeTag('P', 'T', 'H', 'N');
+static constexpr uint32_t kTagPathClusterFirst = makeTag('P', 'T', 'H', 'C');
+static constexpr uint32_t kTagPathEdgeFirst = makeTag('P', 'T', 'H', 'F');
+static constexpr uint32_t kTagPathEdges = makeTag('P', 'T', 'H', 'E');
+static constexpr uint32_t kTagChunkSolid = makeTag('C', 'H', 'K', 'G');
+static constexpr uint32_t kTagChunkWallFirst = makeTag('C', 'H', 'K', 'F');
+static constexpr uint32_t kTagChunkWalls = makeTag('C', 'H', 'K', 'W');
+// largest chunk side the chunk sections may use
+static constexpr uint32_t kMaxChunkCells = 4096;
+
+bool MapFile::mapFile(const std::string &path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(MapHeader))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    base = (const unsigned char *)view;
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MapHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file referenced on its own
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    base = (const unsigned char *)view;
+    size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void MapFile::close()
+{
+    if (base)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle((HANDLE)mappingHandle);
+        CloseHandle((HANDLE)fileHandle);
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+#else
+        munmap((void *)base, size);
+#endif
+    }
+    base = nullptr;
+    size = 0;
+    solid_ = nullptr;
+    walls_ = nullptr;
+    wallCount_ = 0;
+    emptyCells_ = nullptr;
+    emptyCellCount_ = 0;
+    bvhNodes_ = nullptr;
+    bvhNodeCount_ = 0;
+    bvhBoxes_ = nullptr;
+    bvhIds_ = nullptr;
+    cellRegion_ = nullptr;
+    regionFirst_ = nullptr;
+    regionFirstCount_ = 0;
+    regionCells_ = nullptr;
+    pathNodes_ = nullptr;
+    pathNodeCount_ = 0;
+    pathClusterFirst_ = nullptr;
+    pathClusterFirstCount_ = 0;
+    pathEdgeFirst_ = nullptr;
+    pathEdges_ = nullptr;
+    pathEdgeCount_ = 0;
+    chunkSolid_ = nullptr;
+    chunkWords_ = 0;
+    chunksX_ = 0;
+    chunksY_ = 0;
+    chunkWallFirst_ = nullptr;
+    chunkWalls_ = nullptr;
+}
+
+bool MapFile::open(const std::string &path)
+{
+    close();
+    if (!mapFile(path))
+        return false;
+    if (!validate())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Every index the game follows is range checked here, one linear pass per
+// array, so a damaged file is refused instead of read out of bounds later.
+// Floats (wall boxes, BVH bounds) are taken as they are.
+
+// Cells inside the grid, in strictly row-major order (lookups binary search).
+static bool validEmptyCells(const CellCoord *cells, size_t count, int width, int height)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const CellCoord c = cells[i];
+        if (c.col < 0 || c.row < 0 || c.col >= width || c.row >= height)
+            return false;
+        if (i > 0 && (c.row < cells[i - 1].row || (c.row == cells[i - 1].row && c.col <= cells[i - 1].col)))
+            return false;
+    }
+    return true;
+}
+
+// A depth-first tree: each inner node's children come after it and have no
+// other parent, leaves stay inside the boxes, and no node is deeper than the
+// traversal stacks allow.
+static bool validBvh(const BvhNode *nodes, size_t nodeCount, const uint32_t *ids, size_t boxCount)
+{
+    constexpr uint8_t kUnreached = 0xff;
+    std::vector<uint8_t> depth(nodeCount, kUnreached);
+    depth[0] = 0;
+    for (size_t i = 0; i < nodeCount; i++)
+    {
+        const BvhNode &n = nodes[i];
+        if (depth[i] == kUnreached)
+            return false;
+        if (n.count > 0)
+        {
+            if ((uint64_t)n.offset + n.count > boxCount)
+                return false;
+            continue;
+        }
+        const size_t left = i + 1, right = n.offset;
+        if (depth[i] >= kBvhMaxDepth || right <= left || right >= nodeCount || depth[left] != kUnreached ||
+            depth[right] != kUnreached)
+            return false;
+        depth[left] = depth[right] = (uint8_t)(depth[i] + 1);
+    }
+    for (size_t i = 0; i < boxCount; i++)
+        if (ids[i] >= boxCount)
+            return false;
+    return true;
+}
+
+// regionFirst starts at 0, grows strictly (no empty regions) and ends at the
+// cell count; each region's cell list names cells labelled with it.
+static bool validRegions(const uint32_t *cellRegion, const uint32_t *regionFirst, size_t regionFirstCount,
+                         const uint32_t *regionCells, size_t cellCount)
+{
+    const size_t regions = regionFirstCount - 1;
+    if (regionFirst[0] != 0 || regionFirst[regions] != cellCount)
+        return false;
+    for (size_t r = 0; r < regions; r++)
+        if (regionFirst[r] >= regionFirst[r + 1])
+            return false;
+    for (size_t i = 0; i < cellCount; i++)
+        if (cellRegion[i] >= regions)
+            return false;
+    for (size_t r = 0; r < regions; r++)
+        for (uint32_t k = regionFirst[r]; k < regionFirst[r + 1]; k++)
+            if (regionCells[k] >= cellCount || cellRegion[regionCells[k]] != r)
+                return false;
+    return true;
+}
+
+// Offsets that start at 0, never decrease and end at total.
+static bool validOffsets(const uint32_t *first, size_t count, uint64_t total)
+{
+    if (first[0] != 0 || first[count - 1] != total)
+        return false;
+    for (size_t i = 1; i < count; i++)
+        if (first[i] < first[i - 1])
+            return false;
+    return true;
+}
+
+// One offset per cluster of the grid (plus the end), nodes inside their own
+// cluster, one edge offset per node (plus the end) and edges to real nodes.
+static bool validPathGraph(const MapHeader &h, const CellCoord *nodes, size_t nodeCount, const uint32_t *clusterFirst,
+                           size_t clusterFirstCount, const uint32_t *edgeFirst, size_t edgeFirstCount, const PathGraph::Edge *edges,
+                           size_t edgeCount)
+{
+    const int size = (int)h.pathClusterSize;
+    if (h.pathClusterSize < 2 || h.pathClusterSize > 256)
+        return false;
+    const int clustersX = (h.gridWidth + size - 1) / size, clustersY = (h.gridHeight + size - 1) / size;
+    if (clusterFirstCount != (size_t)clustersX * clustersY + 1 || edgeFirstCount != nodeCount + 1)
+        return false;
+    if (!validOffsets(clusterFirst, clusterFirstCount, nodeCount) || !validOffsets(edgeFirst, edgeFirstCount, edgeCount))
+        return false;
+    for (size_t c = 0; c + 1 < clusterFirstCount; c++)
+        for (uint32_t n = clusterFirst[c]; n < clusterFirst[c + 1]; n++)
+        {
+            const CellCoord cell = nodes[n];
+            if (cell.col < 0 || cell.row < 0 || cell.col >= h.gridWidth || cell.row >= h.gridHeight ||
+                (size_t)(cell.row / size) * clustersX + cell.col / size != c)
+                return false;
+        }
+    for (size_t i = 0; i < edgeCount; i++)
+        if (edges[i].to >= nodeCount)
+            return false;
+    return true;
+}
+
+bool MapFile::validate()
+{
+    const MapHeader &h = header();
+    if (std::memcmp(h.magic, kMagic, 4) != 0 || h.version != kMapVersion || h.byteOrder != kMapByteOrder)
+        return false;
+    if (h.fileSize != size || h.gridWidth < 0 || h.gridHeight < 0 || h.gridWidth > kMaxGridSide || h.gridHeight > kMaxGridSide)
+        return false;
+    if (!(h.cellSize > 0.0f) || !(h.wallHeight > 0.0f) || !std::isfinite(h.cellSize) || !std::isfinite(h.wallHeight))
+        return false;
+    const uint64_t tableEnd = sizeof(MapHeader) + (uint64_t)h.sectionCount * sizeof(MapSection);
+    if (tableEnd > size)
+        return false;
+
+    const auto *sections = (const MapSection *)(base + sizeof(MapHeader));
+    const void *bvhBoxes = nullptr;
+    const void *bvhIds = nullptr;
+    uint64_t bvhBoxCount = 0, bvhIdCount = 0;
+    const void *cellRegion = nullptr;
+    const void *regionFirst = nullptr;
+    const void *regionCells = nullptr;
+    uint64_t cellRegionCount = 0, regionFirstCount = 0, regionCellCount = 0;
+    const void *pathNodes = nullptr;
+    const void *pathClusterFirst = nullptr;
+    const void *pathEdgeFirst = nullptr;
+    const void *pathEdges = nullptr;
+    uint64_t pathNodeCount = 0, pathClusterFirstCount = 0, pathEdgeFirstCount = 0, pathEdgeCount = 0;
+    const void *chunkSolid = nullptr;
+    const void *chunkWallFirst = nullptr;
+    const void *chunkWalls = nullptr;
+    uint64_t chunkSolidCount = 0, chunkWallFirstCount = 0, chunkWallCount = 0;
+    for (uint32_t i = 0; i < h.sectionCount; i++)
+    {
+        const MapSection &sec = sections[i];
+        if (sec.offset % kSectionAlign != 0 || sec.offset < tableEnd || sec.offset > size)
+            return false;
+        if (sec.elementSize == 0 || sec.count > (size - sec.offset) / sec.elementSize)
+            return false;
+        const void *data = base + sec.offset;
+        size_t count = (size_t)sec.count;
+
+        auto expect = [&](size_t elementSize)
+        { return sec.elementSize == elementSize; };
+        switch (sec.tag)
+        {
+        case kTagGrid:
+            if (!expect(sizeof(uint64_t)) || sec.count != BitGrid::wordsPerRowFor(h.gridWidth) * (uint64_t)h.gridHeight)
+                return false;
+            solid_ = (const uint64_t *)data;
+            break;
+        case kTagWalls:
+            if (!expect(sizeof(AABB)))
+                return false;
+            walls_ = (const AABB *)data;
+            wallCount_ = count;
+            break;
+        case kTagEmpty:
+            if (!expect(sizeof(CellCoord)))
+                return false;
+            emptyCells_ = (const CellCoord *)data;
+            emptyCellCount_ = count;
+            break;
+        case kTagBvhNodes:
+            if (!expect(sizeof(BvhNode)) || count == 0)
+                return false;
+            bvhNodes_ = (const BvhNode *)data;
+            bvhNodeCount_ = count;
+            break;
+        case kTagBvhBoxes:
+            if (!expect(sizeof(AABB)))
+                return false;
+            bvhBoxes = data;
+            bvhBoxCount = sec.count;
+            break;
+        case kTagBvhIds:
+            if (!expect(sizeof(uint32_t)))
+                return false;
+            bvhIds = data;
+            bvhIdCount = sec.count;
+            break;
+        case kTagCellRegion:
+            if (!expect(sizeof(uint32_t)))
+                return false;
+            cellRegion = data;
+            cellRegionCount = sec.count;
+            break;
+        case kTagRegionFirst:
+            if (!expect(sizeof(uint32_t)) || count == 0)
+                return false;
+            regionFirst = data;
+            regionFirstCount = sec.count;
+            break;
+        case kTagRegionCells:
+            if (!expect(sizeof(uint32_t)))
+                return false;
+            regionCells = data;
+            regionCellCount = sec.count;
+            break;
+        case kTagPathNodes:
+            if (!expect(sizeof(CellCoord)))
+                return false;
+            pathNodes = data;
+            pathNodeCount = sec.count;
+            break;
+        case kTagPathClusterFirst:
+            if (!expect(sizeof(uint32_t)) || count == 0)
+                return false;
+            pathClusterFirst = data;
+            pathClusterFirstCount = sec.count;
+            break;
+        case kTagPathEdgeFirst:
+            if (!expect(sizeof(uint32_t)) || count == 0)
+                return false;
+            pathEdgeFirst = data;
+            pathEdgeFirstCount = sec.count;
+            break;
+        case kTagPathEdges:
+            if (!expect(sizeof(PathGraph::Edge)))
+                return false;
+            pathEdges = data;
+            pathEdgeCount = sec.count;
+            break;
+        case kTagChunkSolid:
+            if (!expect(sizeof(uint64_t)))
+                return false;
+            chunkSolid = data;
+            chunkSolidCount = sec.count;
+            break;
+        case kTagChunkWallFirst:
+            if (!expect(sizeof(uint32_t)) || count == 0)
+                return false;
+            chunkWallFirst = data;
+            chunkWallFirstCount = sec.count;
+            break;
+        case kTagChunkWalls:
+            if (!expect(sizeof(AABB)))
+                return false;
+            chunkWalls = data;
+            chunkWallCount = sec.count;
+            break;
+        default:
+            // unknown sections are skipped so newer writers stay readable
+            break;
+        }
+    }
+
+    // a non-empty grid needs its occupancy, and wall cells need wall boxes;
+    // grid-less maps (walls only) have neither a grid nor a wall cell count
+    if ((!solid_ && h.gridWidth * (uint64_t)h.gridHeight != 0) || (!walls_ && h.wallCellCount != 0))
+        return false;
+    if (!validEmptyCells(emptyCells_, emptyCellCount_, h.gridWidth, h.gridHeight))
+        return false;
+    if (bvhNodes_)
+    {
+        if (!bvhBoxes || !bvhIds || bvhBoxCount != wallCount_ || bvhIdCount != wallCount_)
+            return false;
+        if (!validBvh(bvhNodes_, bvhNodeCount_, (const uint32_t *)bvhIds, wallCount_))
+            return false;
+        bvhBoxes_ = (const AABB *)bvhBoxes;
+        bvhIds_ = (const uint32_t *)bvhIds;
+    }
+    if (regionFirst)
+    {
+        if (!cellRegion || !regionCells || cellRegionCount != emptyCellCount_ || regionCellCount != emptyCellCount_)
+            return false;
+        if (!validRegions((const uint32_t *)cellRegion, (const uint32_t *)regionFirst, (size_t)regionFirstCount,
+                          (const uint32_t *)regionCells, emptyCellCount_))
+            return false;
+        cellRegion_ = (const uint32_t *)cellRegion;
+        regionFirst_ = (const uint32_t *)regionFirst;
+        regionFirstCount_ = (size_t)regionFirstCount;
+        regionCells_ = (const uint32_t *)regionCells;
+    }
+    if (h.pathClusterSize != 0)
+    {
+        if (!pathNodes || !pathClusterFirst || !pathEdgeFirst || !pathEdges)
+            return false;
+        if (!validPathGraph(h, (const CellCoord *)pathNodes, (size_t)pathNodeCount, (const uint32_t *)pathClusterFirst,
+                            (size_t)pathClusterFirstCount, (const uint32_t *)pathEdgeFirst, (size_t)pathEdgeFirstCount,
+                            (const PathGraph::Edge *)pathEdges, (size_t)pathEdgeCount))
+            return false;
+        pathNodes_ = (const CellCoord *)pathNodes;
+        pathNodeCount_ = (size_t)pathNodeCount;
+        pathClusterFirst_ = (const uint32_t *)pathClusterFirst;
+        pathClusterFirstCount_ = (size_t)pathClusterFirstCount;
+        pathEdgeFirst_ = (const uint32_t *)pathEdgeFirst;
+        pathEdges_ = (const PathGraph::Edge *)pathEdges;
+        pathEdgeCount_ = (size_t)pathEdgeCount;
+    }
+    if (h.chunkCells != 0)
+    {
+        // a block of whole words per chunk row
+        if (h.chunkCells % 64 != 0 || h.chunkCells > kMaxChunkCells || !chunkSolid || !chunkWallFirst || !chunkWalls)
+            return false;
+        const int cells = (int)h.chunkCells;
+        const int chunksX = (h.gridWidth + cells - 1) / cells, chunksY = (h.gridHeight + cells - 1) / cells;
+        const uint64_t chunks = (uint64_t)chunksX * (uint64_t)chunksY, words = (uint64_t)cells * (uint64_t)(cells / 64);
+        if (chunkSolidCount != chunks * words || chunkWallFirstCount != chunks + 1 ||
+            !validOffsets((const uint32_t *)chunkWallFirst, (size_t)chunkWallFirstCount, chunkWallCount))
+            return false;
+        chunkSolid_ = (const uint64_t *)chunkSolid;
+        chunkWords_ = (size_t)words;
+        chunksX_ = chunksX;
+        chunksY_ = chunksY;
+        chunkWallFirst_ = (const uint32_t *)chunkWallFirst;
+        chunkWalls_ = (const AABB *)chunkWalls;
+    }
+    return true;
+}
+
+namespace
+{
+    struct PendingSection
+    {
+        uint32_t tag;
+        uint32_t elementSize;
+        const void *data;
+        uint64_t count;
+    };
+} // namespace
+
+static uint64_t alignUp(uint64_t v)
+{
+    return (v + kSectionAlign - 1) / kSectionAlign * kSectionAlign;
+}
+
+bool writeMapFile(const std::string &path, const Maze &maze, bool mergedWalls, const Bvh *bvh, const PathGraph *paths, int chunkCells)
+{
+    std::vector<PendingSection> pending = {
+        {kTagGrid, sizeof(uint64_t), maze.solid.words().data(), maze.solid.words().size()},
+        {kTagWalls, sizeof(AABB), maze.walls.data(), maze.walls.size()},
+        {kTagEmpty, sizeof(CellCoord), maze.emptyCells.data(), maze.emptyCells.size()},
+    };
+    if (bvh && !bvh->nodes.empty())
+    {
+        pending.push_back({kTagBvhNodes, sizeof(BvhNode), bvh->nodes.data(), bvh->nodes.size()});
+        pending.push_back({kTagBvhBoxes, sizeof(AABB), bvh->boxes.data(), bvh->boxes.size()});
+        pending.push_back({kTagBvhIds, sizeof(uint32_t), bvh->ids.data(), bvh->ids.size()});
+    }
+    if (!maze.regionFirst.empty())
+    {
+        pending.push_back({kTagCellRegion, sizeof(uint32_t), maze.cellRegion.data(), maze.cellRegion.size()});
+        pending.push_back({kTagRegionFirst, sizeof(uint32_t), maze.regionFirst.data(), maze.regionFirst.size()});
+        pending.push_back({kTagRegionCells, sizeof(uint32_t), maze.regionCells.data(), maze.regionCells.size()});
+    }
+    // only a graph of this grid; an empty one has nothing worth storing
+    const bool withPaths = paths && paths->gridWidth == maze.gridWidth && paths->gridHeight == maze.gridHeight &&
+                           !paths->clusterFirstNode.empty() && !paths->edgeFirst.empty();
+    if (withPaths)
+    {
+        pending.push_back({kTagPathNodes, sizeof(CellCoord), paths->nodes.data(), paths->nodes.size()});
+        pending.push_back({kTagPathClusterFirst, sizeof(uint32_t), paths->clusterFirstNode.data(), paths->clusterFirstNode.size()});
+        pending.push_back({kTagPathEdgeFirst, sizeof(uint32_t), paths->edgeFirst.data(), paths->edgeFirst.size()});
+        pending.push_back({kTagPathEdges, sizeof(PathGraph::Edge), paths->edges.data(), paths->edges.size()});
+    }
+    // each chunk's rows copied out of the grid's, and its walls merged
+    const bool withChunks = chunkCells > 0 && chunkCells % 64 == 0 && (uint32_t)chunkCells <= kMaxChunkCells &&
+                            maze.gridWidth > 0 && maze.gridHeight > 0;
+    std::vector<uint64_t> chunkSolid;
+    std::vector<uint32_t> chunkWallFirst;
+    std::vector<AABB> chunkWalls;
+    if (withChunks)
+    {
+        const int chunksX = (maze.gridWidth + chunkCells - 1) / chunkCells, chunksY = (maze.gridHeight + chunkCells - 1) / chunkCells;
+        const size_t chunkRowWords = (size_t)chunkCells / 64;
+        chunkSolid.assign((size_t)chunksX * chunksY * chunkCells * chunkRowWords, 0);
+        chunkWallFirst.push_back(0);
+        uint64_t *out = chunkSolid.data();
+        for (int cy = 0; cy < chunksY; cy++)
+            for (int cx = 0; cx < chunksX; cx++, out += (size_t)chunkCells * chunkRowWords)
+            {
+                const int col0 = cx * chunkCells, row0 = cy * chunkCells;
+                const int col1 = std::min(maze.gridWidth, col0 + chunkCells), row1 = std::min(maze.gridHeight, row0 + chunkCells);
+                const size_t word0 = (size_t)col0 / 64, word1 = std::min(word0 + chunkRowWords, maze.solid.wordsPerRow());
+                for (int r = row0; r < row1; r++)
+                    std::copy(maze.solid.rowWords(r) + word0, maze.solid.rowWords(r) + word1, out + (size_t)(r - row0) * chunkRowWords);
+                mergeWallCells(maze, col0, row0, col1, row1, chunkWalls);
+                chunkWallFirst.push_back((uint32_t)chunkWalls.size());
+            }
+        pending.push_back({kTagChunkSolid, sizeof(uint64_t), chunkSolid.data(), chunkSolid.size()});
+        pending.push_back({kTagChunkWallFirst, sizeof(uint32_t), chunkWallFirst.data(), chunkWallFirst.size()});
+        pending.push_back({kTagChunkWalls, sizeof(AABB), chunkWalls.data(), chunkWalls.size()});
+    }
+
+    std::vector<MapSection> sections;
+    uint64_t offset = alignUp(sizeof(MapHeader) + pending.size() * sizeof(MapSection));
+    for (const auto &p : pending)
+    {
+        sections.push_back({p.tag, p.elementSize, offset, p.count});
+        offset = alignUp(offset + p.count * p.elementSize);
+    }
+
+    MapHeader h{};
+    std::memcpy(h.magic, kMagic, 4);
+    h.version = kMapVersion;
+    h.byteOrder = kMapByteOrder;
+    h.sectionCount = (uint32_t)sections.size();
+    h.gridWidth = maze.gridWidth;
+    h.gridHeight = maze.gridHeight;
+    h.cellSize = maze.cellSize;
+    h.wallHeight = maze.wallHeight;
+    h.wallCellCount = maze.wallCellCount;
+    h.fileSize = offset;
+    h.flags = mergedWalls ? kMapMergedWalls : 0;
+    h.pathClusterSize = withPaths ? (uint32_t)paths->clusterSize : 0;
+    h.chunkCells = withChunks ? (uint32_t)chunkCells : 0;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    static const char zeros[kSectionAlign] = {};
+    uint64_t written = 0;
+    auto put = [&](const void *data, uint64_t bytes)
+    {
+        file.write((const char *)data, (std::streamsize)bytes);
+        written += bytes;
+    };
+    put(&h, sizeof(h));
+    put(sections.data(), sections.size() * sizeof(MapSection));
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        put(zeros, sections[i].offset - written);
+        put(pending[i].data, pending[i].count * pending[i].elementSize);
+    }
+    put(zeros, offset - written);
+    return (bool)file;
+}
+
+bool mazeFromMapFile(const std::shared_ptr<const MapFile> &map, Maze &maze, Bvh *bvh)
+{
+    const MapHeader &h = map->header();
+    Maze m;
+    m.cellSize = h.cellSize;
+    m.wallHeight = h.wallHeight;
+    m.gridWidth = h.gridWidth;
+    m.gridHeight = h.gridHeight;
+    m.wallCellCount = (size_t)h.wallCellCount;
+    m.solid = BitGrid::view(h.gridWidth, h.gridHeight, map->solid());
+    m.walls = MappedArray<AABB>::view(map->walls(), map->wallCount());
+    m.emptyCells = MappedArray<CellCoord>::view(map->emptyCells(), map->emptyCellCount());
+    if (map->hasRegions())
+    {
+        m.cellRegion = MappedArray<uint32_t>::view(map->cellRegion(), map->emptyCellCount());
+        m.regionFirst = MappedArray<uint32_t>::view(map->regionFirst(), map->regionFirstCount());
+        m.regionCells = MappedArray<uint32_t>::view(map->regionCells(), map->emptyCellCount());
+    }
+    m.mapping = map;
+    maze = std::move(m);
+
+    if (!bvh || !map->hasBvh())
+        return false;
+    Bvh b;
+    b.nodes = MappedArray<BvhNode>::view(map->bvhNodes(), map->bvhNodeCount());
+    b.boxes = MappedArray<AABB>::view(map->bvhBoxes(), map->wallCount());
+    b.ids = MappedArray<uint32_t>::view(map->bvhIds(), map->wallCount());
+    b.mapping = map;
+    *bvh = std::move(b);
+    return true;
+}
+
+bool pathGraphFromMapFile(const std::shared_ptr<const MapFile> &map, PathGraph &graph)
+{
+    if (!map->hasPathGraph())
+        return false;
+    const MapHeader &h = map->header();
+    PathGraph g;
+    g.gridWidth = h.gridWidth;
+    g.gridHeight = h.gridHeight;
+    g.clusterSize = (int)h.pathClusterSize;
+    g.clustersX = (h.gridWidth + g.clusterSize - 1) / g.clusterSize;
+    g.clustersY = (h.gridHeight + g.clusterSize - 1) / g.clusterSize;
+    g.nodes = MappedArray<CellCoord>::view(map->pathNodes(), map->pathNodeCount());
+    g.clusterFirstNode = MappedArray<uint32_t>::view(map->pathClusterFirst(), map->pathClusterFirstCount());
+    g.edgeFirst = MappedArray<uint32_t>::view(map->pathEdgeFirst(), map->pathNodeCount() + 1);
+    g.edges = MappedArray<PathGraph::Edge>::view(map->pathEdges(), map->pathEdgeCount());
+    g.mapping = map;
+    graph = std::move(g);
+    return true;
+}
+
+bool loadTextGrid(const std::string &path, std::vector<std::string> &grid)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::vector<std::string> rows;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty())
+            rows.push_back(std::move(line));
+    }
+    if (rows.empty())
+        return false;
+    grid = std::move(rows);
+    return true;
+}
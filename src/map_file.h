@@ -0,0 +1,171 @@
+#pragma once
+
+#include "bvh.h"
+#include "maze.h"
+#include "pathfind.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Binary map layout (native little-endian, every section 64-byte aligned):
+//   MapHeader, then sectionCount MapSection entries, then the section data.
+// Sections hold the arrays of a built Maze exactly as they sit in memory, so
+// a mapped file is used in place: no per-cell decoding on load.
+//   GRID  u64 occupancy bits, BitGrid rows          (required)
+//   WALL  AABB wall boxes                           (required)
+//   EMPT  CellCoord empty cells                     (required)
+//   BVHN / BVHB / BVHI  cached wall BVH             (optional, all or none)
+//   REGN / RGNF / RGNC  u32 region labels           (optional, all or none)
+//   PTHN / PTHC / PTHF / PTHE  path graph nodes,      (optional, all or none;
+//         cluster and edge offsets, edges              pathClusterSize != 0)
+//   CHKG / CHKF / CHKW  per streaming chunk: u64       (optional, all or none;
+//         occupancy, u32 wall offsets, AABB walls      chunkCells != 0)
+// CHKG holds the grid again chunk by chunk (row-major chunks, chunkCells rows
+// of chunkCells / 64 words each, zero past the grid), so one chunk's cells are
+// one contiguous block. CHKW holds each chunk's wall cells merged within it.
+struct MapHeader
+{
+    char magic[4]; // "FMAP"
+    uint32_t version;
+    uint32_t byteOrder; // kMapByteOrder as written by the producing machine
+    uint32_t sectionCount;
+    int32_t gridWidth;
+    int32_t gridHeight;
+    float cellSize;
+    float wallHeight;
+    uint64_t wallCellCount;
+    uint64_t fileSize;
+    uint32_t flags;
+    uint32_t pathClusterSize; // 0 when the file stores no path graph
+    uint32_t chunkCells;      // 0 when the file stores no chunks
+    uint32_t reserved;
+};
+static_assert(sizeof(MapHeader) == 64, "MapHeader is part of the file format");
+
+struct MapSection
+{
+    uint32_t tag;
+    uint32_t elementSize;
+    uint64_t offset;
+    uint64_t count;
+};
+static_assert(sizeof(MapSection) == 24, "MapSection is part of the file format");
+
+constexpr uint32_t kMapVersion = 2;
+constexpr uint32_t kMapByteOrder = 0x01020304u;
+// MapHeader::flags
+constexpr uint32_t kMapMergedWalls = 1u << 0;
+
+// Read-only mapping of a map file. The accessors point straight into the
+// mapping and stay valid until close() or destruction.
+class MapFile
+{
+public:
+    MapFile() = default;
+    MapFile(const MapFile &) = delete;
+    MapFile &operator=(const MapFile &) = delete;
+    ~MapFile() { close(); }
+
+    // Maps the file and checks the header, the section table and every index
+    // array; false if the file is missing, truncated, from another version or
+    // byte order, or holds an index out of range.
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const { return base != nullptr; }
+
+    const MapHeader &header() const { return *(const MapHeader *)base; }
+    const uint64_t *solid() const { return solid_; }
+    const AABB *walls() const { return walls_; }
+    size_t wallCount() const { return wallCount_; }
+    const CellCoord *emptyCells() const { return emptyCells_; }
+    size_t emptyCellCount() const { return emptyCellCount_; }
+
+    bool hasBvh() const { return bvhNodes_ != nullptr; }
+    const BvhNode *bvhNodes() const { return bvhNodes_; }
+    size_t bvhNodeCount() const { return bvhNodeCount_; }
+    const AABB *bvhBoxes() const { return bvhBoxes_; }
+    const uint32_t *bvhIds() const { return bvhIds_; }
+
+    bool hasRegions() const { return regionFirst_ != nullptr; }
+    const uint32_t *cellRegion() const { return cellRegion_; }
+    const uint32_t *regionFirst() const { return regionFirst_; }
+    size_t regionFirstCount() const { return regionFirstCount_; }
+    const uint32_t *regionCells() const { return regionCells_; }
+
+    bool hasPathGraph() const { return pathNodes_ != nullptr; }
+    const CellCoord *pathNodes() const { return pathNodes_; }
+    size_t pathNodeCount() const { return pathNodeCount_; }
+    const uint32_t *pathClusterFirst() const { return pathClusterFirst_; }
+    size_t pathClusterFirstCount() const { return pathClusterFirstCount_; }
+    const uint32_t *pathEdgeFirst() const { return pathEdgeFirst_; }
+    const PathGraph::Edge *pathEdges() const { return pathEdges_; }
+    size_t pathEdgeCount() const { return pathEdgeCount_; }
+
+    bool hasChunks() const { return chunkSolid_ != nullptr; }
+    int chunkCells() const { return (int)header().chunkCells; }
+    int chunksX() const { return chunksX_; }
+    int chunksY() const { return chunksY_; }
+    // the chunkCells * chunkCells / 64 occupancy words of a chunk
+    const uint64_t *chunkSolid(uint32_t id) const { return chunkSolid_ + (size_t)id * chunkWords_; }
+    // walls of chunk id are [chunkWallFirst()[id], chunkWallFirst()[id + 1])
+    const uint32_t *chunkWallFirst() const { return chunkWallFirst_; }
+    const AABB *chunkWalls() const { return chunkWalls_; }
+
+private:
+    const unsigned char *base = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+
+    const uint64_t *solid_ = nullptr;
+    const AABB *walls_ = nullptr;
+    size_t wallCount_ = 0;
+    const CellCoord *emptyCells_ = nullptr;
+    size_t emptyCellCount_ = 0;
+    const BvhNode *bvhNodes_ = nullptr;
+    size_t bvhNodeCount_ = 0;
+    const AABB *bvhBoxes_ = nullptr;
+    const uint32_t *bvhIds_ = nullptr;
+    const uint32_t *cellRegion_ = nullptr;
+    const uint32_t *regionFirst_ = nullptr;
+    size_t regionFirstCount_ = 0;
+    const uint32_t *regionCells_ = nullptr;
+    const CellCoord *pathNodes_ = nullptr;
+    size_t pathNodeCount_ = 0;
+    const uint32_t *pathClusterFirst_ = nullptr;
+    size_t pathClusterFirstCount_ = 0;
+    const uint32_t *pathEdgeFirst_ = nullptr;
+    const PathGraph::Edge *pathEdges_ = nullptr;
+    size_t pathEdgeCount_ = 0;
+    const uint64_t *chunkSolid_ = nullptr;
+    size_t chunkWords_ = 0;
+    int chunksX_ = 0;
+    int chunksY_ = 0;
+    const uint32_t *chunkWallFirst_ = nullptr;
+    const AABB *chunkWalls_ = nullptr;
+
+    bool mapFile(const std::string &path);
+    bool validate();
+};
+
+// Writes maze (and, when given, its BVH and path graph) in the layout above.
+// A chunkCells that is a positive multiple of 64 adds the chunk sections.
+bool writeMapFile(const std::string &path, const Maze &maze, bool mergedWalls, const Bvh *bvh = nullptr,
+                  const PathGraph *paths = nullptr, int chunkCells = 0);
+
+// Points maze (and bvh, if the file caches one) at the mapped arrays, which
+// are used in place; both hold a reference that keeps the mapping open.
+// Returns whether a BVH was loaded.
+bool mazeFromMapFile(const std::shared_ptr<const MapFile> &map, Maze &maze, Bvh *bvh = nullptr);
+// Points graph at the file's path graph in place; false (graph untouched)
+// when the file has none.
+bool pathGraphFromMapFile(const std::shared_ptr<const MapFile> &map, PathGraph &graph);
+
+// Text grid format: one row per line, '#' for a wall, anything else empty.
+// Blank lines and trailing '\r' are ignored.
+bool loadTextGrid(const std::string &path, std::vector<std::string> &grid);
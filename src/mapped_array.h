@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+// Contiguous array that either owns its elements or views elements living
+// elsewhere, such as a mapped map file kept alive by the array's owner.
+// Reads go through one pointer either way. Mutating a view copies it into
+// owned storage first; there is no non-const operator[] or begin(), so
+// reading through a non-const object never triggers that copy by accident.
+template <typename T>
+class MappedArray
+{
+public:
+    MappedArray() = default;
+    MappedArray(std::initializer_list<T> init) : owned(init) {}
+    MappedArray(std::vector<T> &&v) : owned(std::move(v)) {}
+
+    static MappedArray view(const T *data, size_t count)
+    {
+        MappedArray a;
+        a.viewData = data;
+        a.viewSize = count;
+        return a;
+    }
+    bool isView() const { return viewData != nullptr; }
+
+    size_t size() const { return viewData ? viewSize : owned.size(); }
+    bool empty() const { return size() == 0; }
+    const T *data() const { return viewData ? viewData : owned.data(); }
+    const T &operator[](size_t i) const { return data()[i]; }
+    const T &front() const { return data()[0]; }
+    const T &back() const { return data()[size() - 1]; }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + size(); }
+
+    T *mutableData()
+    {
+        makeOwned();
+        return owned.data();
+    }
+    void push_back(const T &v)
+    {
+        makeOwned();
+        owned.push_back(v);
+    }
+    void reserve(size_t n)
+    {
+        makeOwned();
+        owned.reserve(n);
+    }
+    void resize(size_t n)
+    {
+        makeOwned();
+        owned.resize(n);
+    }
+    void assign(size_t n, const T &v)
+    {
+        clear();
+        owned.assign(n, v);
+    }
+    template <typename It>
+    void assign(It first, It last)
+    {
+        clear();
+        owned.assign(first, last);
+    }
+    void clear()
+    {
+        viewData = nullptr;
+        viewSize = 0;
+        owned.clear();
+    }
+
+private:
+    std::vector<T> owned;
+    const T *viewData = nullptr;
+    size_t viewSize = 0;
+
+    void makeOwned()
+    {
+        if (!viewData)
+            return;
+        owned.assign(viewData, viewData + viewSize);
+        viewData = nullptr;
+        viewSize = 0;
+    }
+};
@@ -1,42 +1,282 @@
 #include "maze.h"
 
+#include "jobs.h"
+
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
-static glm::vec3 cellCenter(const std::vector<std::string> &grid, int col, int row, float cellSize)
+static glm::vec3 cellCenter(int gridWidth, int gridHeight, int col, int row, float cellSize)
 {
-    const float w = (float)grid[0].size();
-    const float h = (float)grid.size();
+    const float w = (float)gridWidth;
+    const float h = (float)gridHeight;
     float x = ((float)col - w * 0.5f + 0.5f) * cellSize;
     float z = ((float)row - h * 0.5f + 0.5f) * cellSize;
     return {x, 0.0f, z};
 }
 
-Maze buildMazeFromGrid(const std::vector<std::string> &grid, float cellSize, float wallHeight)
+void mergeWallCells(const Maze &maze, int col0, int row0, int col1, int row1, std::vector<AABB> &out)
+{
+    const int w = col1 - col0;
+    const int h = row1 - row0;
+    if (w <= 0 || h <= 0)
+        return;
+    std::vector<unsigned char> used((size_t)w * h, 0);
+    auto freeWall = [&](int c, int r)
+    {
+        return isWallCell(maze, c, r) && !used[(size_t)(r - row0) * w + (c - col0)];
+    };
+
+    for (int r = row0; r < row1; r++)
+    {
+        for (int c = col0; c < col1; c++)
+        {
+            if (!freeWall(c, r))
+                continue;
+
+            // grow right as far as possible, then down while the whole span is free
+            int c1 = c;
+            while (c1 + 1 < col1 && freeWall(c1 + 1, r))
+                c1++;
+            int r1 = r;
+            for (bool grow = true; grow && r1 + 1 < row1;)
+            {
+                for (int k = c; k <= c1; k++)
+                    if (!freeWall(k, r1 + 1))
+                    {
+                        grow = false;
+                        break;
+                    }
+                if (grow)
+                    r1++;
+            }
+
+            for (int rr = r; rr <= r1; rr++)
+                for (int cc = c; cc <= c1; cc++)
+                    used[(size_t)(rr - row0) * w + (cc - col0)] = 1;
+
+            AABB box;
+            box.min = cellBox(maze, c, r).min;
+            box.max = cellBox(maze, c1, r1).max;
+            out.push_back(box);
+        }
+    }
+}
+
+BitGrid gridFromText(const std::vector<std::string> &grid)
+{
+    const int h = std::min((int)grid.size(), kMaxGridSide);
+    const int w = grid.empty() ? 0 : std::min((int)grid[0].size(), kMaxGridSide);
+    BitGrid solid(w, h);
+    for (int r = 0; r < h; r++)
+    {
+        const std::string &row = grid[(size_t)r];
+        uint64_t *words = solid.mutableRowWords(r);
+        for (int c = 0; c < (int)row.size() && c < w; c++)
+            if (row[(size_t)c] == '#')
+                words[c >> 6] |= 1ull << (c & 63);
+    }
+    return solid;
+}
+
+Maze buildMazeFromGrid(const std::vector<std::string> &grid, float cellSize, float wallHeight, bool mergeWalls, JobSystem *jobs)
+{
+    return buildMazeFromGrid(gridFromText(grid), cellSize, wallHeight, mergeWalls, jobs);
+}
+
+Maze buildMazeFromGrid(const BitGrid &solid, float cellSize, float wallHeight, bool mergeWalls, JobSystem *jobs)
 {
     Maze maze;
     maze.cellSize = cellSize;
     maze.wallHeight = wallHeight;
+    maze.gridWidth = std::min(solid.width(), kMaxGridSide);
+    maze.gridHeight = std::min(solid.height(), kMaxGridSide);
+    if (maze.gridWidth == solid.width() && maze.gridHeight == solid.height())
+        maze.solid = solid;
+    else
+    {
+        maze.solid = BitGrid(maze.gridWidth, maze.gridHeight);
+        const size_t words = maze.solid.wordsPerRow();
+        const int tail = maze.gridWidth & 63;
+        for (int r = 0; r < maze.gridHeight; r++)
+        {
+            uint64_t *dst = maze.solid.mutableRowWords(r);
+            std::copy(solid.rowWords(r), solid.rowWords(r) + words, dst);
+            if (tail != 0)
+                dst[words - 1] &= (1ull << tail) - 1;
+        }
+    }
+
+    maze.wallCellCount = maze.solid.count();
+    const size_t cells = (size_t)maze.gridWidth * (size_t)maze.gridHeight;
+    if (!mergeWalls)
+        maze.walls.reserve(maze.wallCellCount);
+    maze.emptyCells.reserve(cells - maze.wallCellCount);
 
-    for (int r = 0; r < (int)grid.size(); r++)
+    // walk the set and the clear bits of each row word, both in row-major order
+    const size_t wordsPerRow = maze.solid.wordsPerRow();
+    for (int r = 0; r < maze.gridHeight; r++)
     {
-        for (int c = 0; c < (int)grid[r].size(); c++)
+        const uint64_t *words = maze.solid.rowWords(r);
+        for (size_t i = 0; i < wordsPerRow; i++)
         {
-            glm::vec3 center = cellCenter(grid, c, r, cellSize);
-            if (grid[r][c] == '#')
-            {
-                AABB box;
-                box.min = center + glm::vec3(-0.5f * cellSize, 0.0f, -0.5f * cellSize);
-                box.max = center + glm::vec3(0.5f * cellSize, wallHeight, 0.5f * cellSize);
-                maze.walls.push_back(box);
-            }
-            else
+            const int base = (int)(i * 64);
+            const int valid = std::min(64, maze.gridWidth - base);
+            const uint64_t inRow = valid == 64 ? ~0ull : (1ull << valid) - 1;
+            if (!mergeWalls)
+                for (uint64_t bits = words[i]; bits; bits &= bits - 1)
+                    maze.walls.push_back(cellBox(maze, base + lowestBit64(bits), r));
+            for (uint64_t bits = ~words[i] & inRow; bits; bits &= bits - 1)
+                maze.emptyCells.push_back({(int16_t)(base + lowestBit64(bits)), (int16_t)r});
+        }
+    }
+
+    if (mergeWalls)
+    {
+        std::vector<AABB> merged;
+        mergeWallCells(maze, 0, 0, maze.gridWidth, maze.gridHeight, merged);
+        maze.walls = std::move(merged);
+    }
+
+    labelRegions(maze, jobs);
+    return maze;
+}
+
+// rows per union-find stripe
+static constexpr int kRegionStripeRows = 64;
+
+// Union-find over empty-cell indices where every root is the smallest index
+// of its set, so parent[i] <= i always holds.
+static uint32_t findRoot(std::vector<uint32_t> &parent, uint32_t i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static void unite(std::vector<uint32_t> &parent, uint32_t a, uint32_t b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b)
+        parent[b] = a;
+    else if (b < a)
+        parent[a] = b;
+}
+
+// Joins every empty cell of row r with the one above it, walking both rows'
+// runs of emptyCells side by side.
+static void uniteWithRowAbove(const Maze &maze, const std::vector<uint32_t> &rowFirst, int r, std::vector<uint32_t> &parent)
+{
+    uint32_t above = rowFirst[(size_t)r - 1];
+    const uint32_t aboveEnd = rowFirst[(size_t)r];
+    for (uint32_t i = rowFirst[(size_t)r]; i < rowFirst[(size_t)r + 1]; i++)
+    {
+        const int16_t col = maze.emptyCells[i].col;
+        while (above < aboveEnd && maze.emptyCells[above].col < col)
+            above++;
+        if (above == aboveEnd)
+            break;
+        if (maze.emptyCells[above].col == col)
+            unite(parent, above, i);
+    }
+}
+
+void labelRegions(Maze &maze, JobSystem *jobs)
+{
+    const size_t n = maze.emptyCells.size();
+    maze.cellRegion.clear();
+    maze.regionFirst.assign(1, 0u);
+    maze.regionCells.clear();
+    if (n == 0)
+        return;
+
+    // emptyCells is row-major; rowFirst[r] is the first of row r
+    const int h = maze.gridHeight;
+    std::vector<uint32_t> rowFirst((size_t)h + 1, 0);
+    for (int r = 0; r < h; r++)
+        rowFirst[(size_t)r + 1] = rowFirst[(size_t)r] + (uint32_t)((size_t)maze.gridWidth - maze.solid.countRow(r, 0, maze.gridWidth));
+
+    // each stripe only links its own cells, so stripes run side by side
+    std::vector<uint32_t> parent(n);
+    const size_t stripes = ((size_t)h + kRegionStripeRows - 1) / kRegionStripeRows;
+    auto labelStripes = [&](size_t begin, size_t end)
+    {
+        for (size_t s = begin; s < end; s++)
+        {
+            const int r0 = (int)s * kRegionStripeRows, r1 = std::min(h, r0 + kRegionStripeRows);
+            for (uint32_t i = rowFirst[(size_t)r0]; i < rowFirst[(size_t)r1]; i++)
+                parent[i] = i;
+            for (int r = r0; r < r1; r++)
             {
-                maze.emptyCells.push_back(center);
+                for (uint32_t i = rowFirst[(size_t)r] + 1; i < rowFirst[(size_t)r + 1]; i++)
+                    if (maze.emptyCells[i - 1].col + 1 == maze.emptyCells[i].col)
+                        unite(parent, i - 1, i);
+                if (r > r0)
+                    uniteWithRowAbove(maze, rowFirst, r, parent);
             }
         }
+    };
+    if (jobs)
+        jobs->parallelFor(stripes, 1, labelStripes);
+    else
+        labelStripes(0, stripes);
+    for (size_t s = 1; s < stripes; s++)
+        uniteWithRowAbove(maze, rowFirst, (int)s * kRegionStripeRows, parent);
+
+    // parents precede their children, so one ascending pass numbers the
+    // roots and hands every other cell its parent's region
+    std::vector<uint32_t> region(n);
+    std::vector<uint32_t> first(1, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (parent[i] == i)
+        {
+            region[i] = (uint32_t)first.size() - 1;
+            first.push_back(0);
+        }
+        else
+            region[i] = region[parent[i]];
+        first[region[i] + 1]++;
     }
+    for (size_t r = 1; r < first.size(); r++)
+        first[r] += first[r - 1];
+    std::vector<uint32_t> cells(n);
+    std::vector<uint32_t> next(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < n; i++)
+        cells[next[region[i]]++] = (uint32_t)i;
 
-    return maze;
+    maze.cellRegion = std::move(region);
+    maze.regionFirst = std::move(first);
+    maze.regionCells = std::move(cells);
+}
+
+long emptyCellIndex(const Maze &maze, int col, int row)
+{
+    if (!maze.solid.contains(col, row) || maze.solid.get(col, row))
+        return -1;
+    auto it = std::lower_bound(maze.emptyCells.begin(), maze.emptyCells.end(), CellCoord{(int16_t)col, (int16_t)row},
+                               [](CellCoord a, CellCoord b)
+                               { return a.row != b.row ? a.row < b.row : a.col < b.col; });
+    if (it == maze.emptyCells.end() || it->col != col || it->row != row)
+        return -1;
+    return (long)(it - maze.emptyCells.begin());
+}
+
+uint32_t regionAt(const Maze &maze, int col, int row)
+{
+    long i = emptyCellIndex(maze, col, row);
+    return i < 0 || maze.cellRegion.empty() ? kNoRegion : maze.cellRegion[(size_t)i];
+}
+
+CellCoord randomRegionCell(const Maze &maze, uint32_t region, std::mt19937 &rng)
+{
+    const uint32_t first = maze.regionFirst[region], last = maze.regionFirst[(size_t)region + 1];
+    std::uniform_int_distribution<uint32_t> pick(first, last - 1);
+    return maze.emptyCells[maze.regionCells[pick(rng)]];
 }
 
 glm::vec3 randomEmptyCell(const Maze &maze, std::mt19937 &rng)
@@ -44,5 +284,46 @@ glm::vec3 randomEmptyCell(const Maze &maze, std::mt19937 &rng)
     if (maze.emptyCells.empty())
         return {0.0f, 0.0f, 0.0f};
     std::uniform_int_distribution<size_t> dist(0, maze.emptyCells.size() - 1);
-    return maze.emptyCells[dist(rng)];
+    return cellCenter(maze, maze.emptyCells[dist(rng)]);
+}
+
+bool isWallCell(const Maze &maze, int col, int row)
+{
+    if (col < 0 || row < 0 || col >= maze.gridWidth || row >= maze.gridHeight)
+        return false;
+    return maze.solid.get(col, row);
+}
+
+AABB cellBox(const Maze &maze, int col, int row)
+{
+    const float cs = maze.cellSize;
+    glm::vec3 center = cellCenter(maze.gridWidth, maze.gridHeight, col, row, cs);
+    AABB box;
+    box.min = center + glm::vec3(-0.5f * cs, 0.0f, -0.5f * cs);
+    box.max = center + glm::vec3(0.5f * cs, maze.wallHeight, 0.5f * cs);
+    return box;
+}
+
+glm::vec3 cellCenter(const Maze &maze, CellCoord cell)
+{
+    return cellCenter(maze.gridWidth, maze.gridHeight, cell.col, cell.row, maze.cellSize);
+}
+
+void worldToCell(const Maze &maze, float x, float z, int &col, int &row)
+{
+    col = (int)std::floor(x / maze.cellSize + (float)maze.gridWidth * 0.5f);
+    row = (int)std::floor(z / maze.cellSize + (float)maze.gridHeight * 0.5f);
+
+    // the division above can round across a cell edge; snap to the cell whose
+    // box (as built by cellBox) actually contains the point
+    const float half = 0.5f * maze.cellSize;
+    glm::vec3 center = cellCenter(maze.gridWidth, maze.gridHeight, col, row, maze.cellSize);
+    if (x < center.x - half)
+        col--;
+    else if (x >= center.x + half)
+        col++;
+    if (z < center.z - half)
+        row--;
+    else if (z >= center.z + half)
+        row++;
 }
@@ -1,7 +1,12 @@
 #pragma once
 
+#include "bit_grid.h"
+#include "mapped_array.h"
+
 #include <glm/glm.hpp>
 
+#include <cstdint>
+#include <memory>
 #include <random>
 #include <string>
 #include <vector>
@@ -12,13 +17,72 @@ struct AABB
     glm::vec3 max;
 };
 
+// Cell coordinates, 4 bytes instead of a 12-byte world position; grids are
+// limited to kMaxGridSide cells a side so they fit.
+struct CellCoord
+{
+    int16_t col = 0;
+    int16_t row = 0;
+};
+
+constexpr int kMaxGridSide = 32767;
+constexpr uint32_t kNoRegion = 0xffffffffu;
+
+class JobSystem;
+
 struct Maze
 {
-    std::vector<AABB> walls;
-    std::vector<glm::vec3> emptyCells;
+    MappedArray<AABB> walls;
+    // open cells, row-major; cellCenter() gives their world position
+    MappedArray<CellCoord> emptyCells;
     float cellSize = 1.0f;
     float wallHeight = 1.75f;
+
+    // 4-connected regions of open cells, numbered in the order of their first
+    // cell: cellRegion[i] is the region of emptyCells[i], and region r's
+    // cells are emptyCells[regionCells[k]] for k in [regionFirst[r], regionFirst[r + 1])
+    MappedArray<uint32_t> cellRegion;
+    MappedArray<uint32_t> regionFirst;
+    MappedArray<uint32_t> regionCells;
+
+    // occupancy, one bit per cell, set = wall
+    int gridWidth = 0;
+    int gridHeight = 0;
+    BitGrid solid;
+    // number of '#' cells; equals walls.size() unless the walls were merged
+    size_t wallCellCount = 0;
+    // keeps the map file alive while the arrays above view it
+    std::shared_ptr<const void> mapping;
 };
 
-Maze buildMazeFromGrid(const std::vector<std::string> &grid, float cellSize, float wallHeight);
+// With mergeWalls set, adjacent wall cells are greedily merged into maximal
+// rectangles, so Maze::walls covers the same area with far fewer boxes.
+// Grids larger than kMaxGridSide a side are cropped. Regions are labelled
+// with labelRegions, in parallel when a job system is given.
+Maze buildMazeFromGrid(const BitGrid &solid, float cellSize, float wallHeight, bool mergeWalls = false, JobSystem *jobs = nullptr);
+// Text rows, '#' for a wall.
+Maze buildMazeFromGrid(const std::vector<std::string> &grid, float cellSize, float wallHeight, bool mergeWalls = false,
+                       JobSystem *jobs = nullptr);
+BitGrid gridFromText(const std::vector<std::string> &grid);
 glm::vec3 randomEmptyCell(const Maze &maze, std::mt19937 &rng);
+
+// Fills the region arrays from emptyCells by union-find: stripes of rows are
+// joined on their own (one job each), then along the rows between stripes.
+void labelRegions(Maze &maze, JobSystem *jobs = nullptr);
+inline size_t regionCount(const Maze &maze) { return maze.regionFirst.empty() ? 0 : maze.regionFirst.size() - 1; }
+// Position of (col, row) in emptyCells by binary search; -1 for walls and
+// cells outside the grid.
+long emptyCellIndex(const Maze &maze, int col, int row);
+// kNoRegion for walls and cells outside the grid.
+uint32_t regionAt(const Maze &maze, int col, int row);
+// A uniformly chosen cell of the region, in O(1).
+CellCoord randomRegionCell(const Maze &maze, uint32_t region, std::mt19937 &rng);
+
+bool isWallCell(const Maze &maze, int col, int row);
+// Greedily merges the wall cells in [col0, col1) x [row0, row1) into maximal
+// rectangles and appends their boxes to out.
+void mergeWallCells(const Maze &maze, int col0, int row0, int col1, int row1, std::vector<AABB> &out);
+AABB cellBox(const Maze &maze, int col, int row);
+// centre of the cell on the floor (y = 0)
+glm::vec3 cellCenter(const Maze &maze, CellCoord cell);
+void worldToCell(const Maze &maze, float x, float z, int &col, int &row);
@@ -0,0 +1,409 @@
+#include "maze_gen.h"
+
+#include "jobs.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+namespace
+{
+    constexpr int kDx[4] = {1, -1, 0, 0};
+    constexpr int kDy[4] = {0, 0, 1, -1};
+
+    // Unbiased enough for maze carving and, unlike the std distributions,
+    // identical across standard libraries.
+    static uint32_t below(std::mt19937 &rng, uint32_t n)
+    {
+        return (uint32_t)(((uint64_t)rng() * n) >> 32);
+    }
+
+    static uint32_t mixSeed(uint32_t seed, uint64_t salt)
+    {
+        uint64_t z = ((uint64_t)seed << 32 ^ salt) + 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return (uint32_t)(z ^ (z >> 31) ^ (z >> 32));
+    }
+
+    // Rectangle of cells [x0, x1) x [y0, y1) in cell coordinates, plus the
+    // cells on its border that a door to a neighbouring tile opens onto.
+    struct Tile
+    {
+        int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        std::vector<uint32_t> doors; // local cell indices
+    };
+
+    // Carving inside one tile. Only the tile's own cells and the walls strictly
+    // between them are written, so tiles never touch the same characters.
+    class TileCarver
+    {
+    public:
+        TileCarver(std::vector<std::string> &grid, const Tile &tile, std::mt19937 &rng)
+            : grid(grid), tile(tile), rng(rng), w(tile.x1 - tile.x0), h(tile.y1 - tile.y0)
+        {
+        }
+
+        void backtracker()
+        {
+            std::vector<unsigned char> visited((size_t)w * h, 0);
+            for (uint32_t start = 0; start < (uint32_t)(w * h); start++)
+                if (!visited[start])
+                    carveTree(start, visited);
+        }
+
+        void wilson()
+        {
+            const uint32_t n = (uint32_t)(w * h);
+            std::vector<unsigned char> inMaze(n, 0);
+            std::vector<unsigned char> next(n, 0);
+            uint32_t root = below(rng, n);
+            inMaze[root] = 1;
+            open(root);
+            for (uint32_t start = 0; start < n; start++)
+            {
+                if (inMaze[start])
+                    continue;
+                // random walk until the maze is hit; overwriting next[] on a
+                // revisit is what erases the loops
+                for (uint32_t u = start; !inMaze[u];)
+                {
+                    int d = randomDirection(u);
+                    next[u] = (unsigned char)d;
+                    u = neighbour(u, d);
+                }
+                for (uint32_t u = start; !inMaze[u]; u = neighbour(u, next[u]))
+                {
+                    inMaze[u] = 1;
+                    open(u);
+                    carve(u, next[u]);
+                }
+            }
+        }
+
+        void rooms()
+        {
+            const uint32_t n = (uint32_t)(w * h);
+            std::vector<uint32_t> region(n, kNoRegion);
+            std::vector<unsigned char> isRoom(n, 0);
+            uint32_t regions = 0;
+
+            // rooms 2..5 cells a side, kept one cell apart
+            const int attempts = std::max(1, w * h / 40);
+            for (int a = 0; a < attempts; a++)
+            {
+                int rw = 2 + (int)below(rng, 4), rh = 2 + (int)below(rng, 4);
+                if (rw > w || rh > h)
+                    continue;
+                int rx = (int)below(rng, (uint32_t)(w - rw + 1)), ry = (int)below(rng, (uint32_t)(h - rh + 1));
+                bool free = true;
+                for (int y = std::max(0, ry - 1); free && y < std::min(h, ry + rh + 1); y++)
+                    for (int x = std::max(0, rx - 1); x < std::min(w, rx + rw + 1); x++)
+                        if (isRoom[(size_t)y * w + x])
+                        {
+                            free = false;
+                            break;
+                        }
+                if (!free)
+                    continue;
+                for (int y = ry; y < ry + rh; y++)
+                    for (int x = rx; x < rx + rw; x++)
+                    {
+                        uint32_t c = (uint32_t)(y * w + x);
+                        isRoom[c] = 1;
+                        region[c] = regions;
+                        open(c);
+                        if (x + 1 < rx + rw)
+                            carve(c, 0);
+                        if (y + 1 < ry + rh)
+                            carve(c, 2);
+                        if (x + 1 < rx + rw && y + 1 < ry + rh)
+                            grid[(size_t)gridRow(c) + 1][(size_t)gridCol(c) + 1] = '.';
+                    }
+                regions++;
+            }
+
+            // corridors fill everything else, one tree per enclosed region
+            std::vector<unsigned char> visited(isRoom);
+            for (uint32_t start = 0; start < n; start++)
+                if (!visited[start])
+                {
+                    for (uint32_t c : carveTree(start, visited))
+                        region[c] = regions;
+                    regions++;
+                }
+
+            // Kruskal over the walls between regions joins them all; a few
+            // redundant openings add loops
+            std::vector<std::pair<uint32_t, int>> connectors;
+            for (uint32_t c = 0; c < n; c++)
+            {
+                int x = (int)(c % (uint32_t)w), y = (int)(c / (uint32_t)w);
+                if (x + 1 < w && region[c] != region[c + 1])
+                    connectors.push_back({c, 0});
+                if (y + 1 < h && region[c] != region[c + (uint32_t)w])
+                    connectors.push_back({c, 2});
+            }
+            for (size_t i = connectors.size(); i > 1; i--)
+                std::swap(connectors[i - 1], connectors[below(rng, (uint32_t)i)]);
+            std::vector<uint32_t> parent(regions);
+            std::iota(parent.begin(), parent.end(), 0u);
+            auto find = [&](uint32_t r)
+            {
+                while (parent[r] != r)
+                    r = parent[r] = parent[parent[r]];
+                return r;
+            };
+            for (const auto &e : connectors)
+            {
+                uint32_t a = find(region[e.first]), b = find(region[neighbour(e.first, e.second)]);
+                if (a != b)
+                    parent[a] = b;
+                else if (below(rng, 64) != 0)
+                    continue;
+                carve(e.first, e.second);
+            }
+
+            if (regions > 0 && std::find(isRoom.begin(), isRoom.end(), 1) != isRoom.end())
+                pruneDeadEnds(isRoom);
+        }
+
+    private:
+        static constexpr uint32_t kNoRegion = 0xffffffffu;
+
+        std::vector<std::string> &grid;
+        const Tile &tile;
+        std::mt19937 &rng;
+        const int w, h;
+
+        int gridCol(uint32_t c) const { return 2 * (tile.x0 + (int)(c % (uint32_t)w)) + 1; }
+        int gridRow(uint32_t c) const { return 2 * (tile.y0 + (int)(c / (uint32_t)w)) + 1; }
+        void open(uint32_t c) { grid[(size_t)gridRow(c)][(size_t)gridCol(c)] = '.'; }
+        void carve(uint32_t c, int d) { grid[(size_t)(gridRow(c) + kDy[d])][(size_t)(gridCol(c) + kDx[d])] = '.'; }
+        void fill(uint32_t c, int d) { grid[(size_t)(gridRow(c) + kDy[d])][(size_t)(gridCol(c) + kDx[d])] = '#'; }
+        bool isOpen(uint32_t c, int d) const { return grid[(size_t)(gridRow(c) + kDy[d])][(size_t)(gridCol(c) + kDx[d])] == '.'; }
+
+        bool inside(uint32_t c, int d) const
+        {
+            int x = (int)(c % (uint32_t)w) + kDx[d], y = (int)(c / (uint32_t)w) + kDy[d];
+            return x >= 0 && y >= 0 && x < w && y < h;
+        }
+        uint32_t neighbour(uint32_t c, int d) const { return (uint32_t)((int)c + kDy[d] * w + kDx[d]); }
+
+        int randomDirection(uint32_t c)
+        {
+            for (;;)
+            {
+                int d = (int)below(rng, 4);
+                if (inside(c, d))
+                    return d;
+            }
+        }
+
+        // Randomized depth-first search over the cells not yet visited.
+        // Returns the cells it reached.
+        std::vector<uint32_t> carveTree(uint32_t start, std::vector<unsigned char> &visited)
+        {
+            std::vector<uint32_t> reached{start};
+            std::vector<uint32_t> stack{start};
+            visited[start] = 1;
+            open(start);
+            while (!stack.empty())
+            {
+                uint32_t c = stack.back();
+                int options[4];
+                int count = 0;
+                for (int d = 0; d < 4; d++)
+                    if (inside(c, d) && !visited[neighbour(c, d)])
+                        options[count++] = d;
+                if (count == 0)
+                {
+                    stack.pop_back();
+                    continue;
+                }
+                int d = options[below(rng, (uint32_t)count)];
+                uint32_t next = neighbour(c, d);
+                visited[next] = 1;
+                open(next);
+                carve(c, d);
+                stack.push_back(next);
+                reached.push_back(next);
+            }
+            return reached;
+        }
+
+        // Fills corridor cells with a single opening until none are left;
+        // rooms and door cells are kept, so connectivity is preserved.
+        void pruneDeadEnds(const std::vector<unsigned char> &keep)
+        {
+            std::vector<unsigned char> locked(keep);
+            for (uint32_t c : tile.doors)
+                locked[c] = 1;
+            auto exits = [&](uint32_t c, int &last)
+            {
+                int count = 0;
+                for (int d = 0; d < 4; d++)
+                    if (inside(c, d) && isOpen(c, d))
+                    {
+                        count++;
+                        last = d;
+                    }
+                return count;
+            };
+            std::vector<uint32_t> queue((size_t)w * h);
+            std::iota(queue.begin(), queue.end(), 0u);
+            while (!queue.empty())
+            {
+                uint32_t c = queue.back();
+                queue.pop_back();
+                if (locked[c] || grid[(size_t)gridRow(c)][(size_t)gridCol(c)] != '.')
+                    continue;
+                int d = 0;
+                int count = exits(c, d);
+                if (count > 1)
+                    continue;
+                grid[(size_t)gridRow(c)][(size_t)gridCol(c)] = '#';
+                if (count == 1)
+                {
+                    fill(c, d);
+                    queue.push_back(neighbour(c, d));
+                }
+            }
+        }
+    };
+
+    struct Door
+    {
+        int col, row; // the wall character that opens
+    };
+
+    // Random spanning tree over the tile grid (depth first), one door per
+    // tree edge at a random position along the shared border.
+    static std::vector<Door> planDoors(std::vector<Tile> &tiles, int tilesX, int tilesY, uint32_t seed)
+    {
+        std::mt19937 rng(mixSeed(seed, 0xd00du));
+        std::vector<Door> doors;
+        std::vector<unsigned char> visited(tiles.size(), 0);
+        std::vector<int> stack{(int)below(rng, (uint32_t)tiles.size())};
+        visited[(size_t)stack.back()] = 1;
+        while (!stack.empty())
+        {
+            int t = stack.back();
+            int tx = t % tilesX, ty = t / tilesX;
+            int options[4];
+            int count = 0;
+            for (int d = 0; d < 4; d++)
+            {
+                int nx = tx + kDx[d], ny = ty + kDy[d];
+                if (nx >= 0 && ny >= 0 && nx < tilesX && ny < tilesY && !visited[(size_t)(ny * tilesX + nx)])
+                    options[count++] = d;
+            }
+            if (count == 0)
+            {
+                stack.pop_back();
+                continue;
+            }
+            int d = options[below(rng, (uint32_t)count)];
+            int n = (ty + kDy[d]) * tilesX + tx + kDx[d];
+            visited[(size_t)n] = 1;
+            stack.push_back(n);
+
+            // a is the left/top tile, b the right/bottom one
+            Tile &a = tiles[(size_t)std::min(t, n)];
+            Tile &b = tiles[(size_t)std::max(t, n)];
+            const int aw = a.x1 - a.x0, bw = b.x1 - b.x0;
+            if (kDx[d] != 0)
+            {
+                int y = a.y0 + (int)below(rng, (uint32_t)(a.y1 - a.y0));
+                a.doors.push_back((uint32_t)((y - a.y0) * aw + aw - 1));
+                b.doors.push_back((uint32_t)((y - b.y0) * bw));
+                doors.push_back({2 * a.x1, 2 * y + 1});
+            }
+            else
+            {
+                int x = a.x0 + (int)below(rng, (uint32_t)(a.x1 - a.x0));
+                a.doors.push_back((uint32_t)((a.y1 - a.y0 - 1) * aw + (x - a.x0)));
+                b.doors.push_back((uint32_t)(x - b.x0));
+                doors.push_back({2 * x + 1, 2 * a.y1});
+            }
+        }
+        return doors;
+    }
+} // namespace
+
+std::vector<std::string> generateMaze(const MazeGenParams &params, JobSystem *jobs)
+{
+    const int width = std::max(3, params.width);
+    const int height = std::max(3, params.height);
+    std::vector<std::string> grid((size_t)height, std::string((size_t)width, '#'));
+
+    const int cellsX = (width - 1) / 2, cellsY = (height - 1) / 2;
+    const int tileSize = std::max(2, params.tileSize);
+    const int tilesX = (cellsX + tileSize - 1) / tileSize, tilesY = (cellsY + tileSize - 1) / tileSize;
+    std::vector<Tile> tiles((size_t)tilesX * tilesY);
+    for (int ty = 0; ty < tilesY; ty++)
+        for (int tx = 0; tx < tilesX; tx++)
+        {
+            Tile &t = tiles[(size_t)(ty * tilesX + tx)];
+            t.x0 = tx * tileSize;
+            t.y0 = ty * tileSize;
+            t.x1 = std::min(cellsX, t.x0 + tileSize);
+            t.y1 = std::min(cellsY, t.y0 + tileSize);
+        }
+    std::vector<Door> doors = planDoors(tiles, tilesX, tilesY, params.seed);
+
+    auto generateTiles = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            std::mt19937 rng(mixSeed(params.seed, (uint64_t)(i + 1) << 8 | (uint64_t)params.algorithm));
+            TileCarver carver(grid, tiles[i], rng);
+            switch (params.algorithm)
+            {
+            case MazeAlgorithm::Backtracker:
+                carver.backtracker();
+                break;
+            case MazeAlgorithm::Wilson:
+                carver.wilson();
+                break;
+            case MazeAlgorithm::Rooms:
+                carver.rooms();
+                break;
+            }
+        }
+    };
+    if (jobs)
+        jobs->parallelFor(tiles.size(), 1, generateTiles);
+    else
+        generateTiles(0, tiles.size());
+
+    // the stitch: border walls belong to no tile, so this is the only writer
+    for (const Door &d : doors)
+        grid[(size_t)d.row][(size_t)d.col] = '.';
+    return grid;
+}
+
+const char *mazeAlgorithmName(MazeAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+    case MazeAlgorithm::Backtracker:
+        return "backtracker";
+    case MazeAlgorithm::Wilson:
+        return "wilson";
+    case MazeAlgorithm::Rooms:
+        return "rooms";
+    }
+    return "?";
+}
+
+bool parseMazeAlgorithm(const std::string &name, MazeAlgorithm &algorithm)
+{
+    for (MazeAlgorithm a : {MazeAlgorithm::Backtracker, MazeAlgorithm::Wilson, MazeAlgorithm::Rooms})
+        if (name == mazeAlgorithmName(a))
+        {
+            algorithm = a;
+            return true;
+        }
+    return false;
+}
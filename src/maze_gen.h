@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+enum class MazeAlgorithm
+{
+    // randomized depth-first search: long winding corridors, few branches
+    Backtracker,
+    // loop-erased random walks: a uniform spanning tree within each tile
+    Wilson,
+    // rectangular rooms joined by corridors, dead ends pruned, a few loops
+    Rooms,
+};
+
+// Grid layout: cells sit at odd (col, row), the walls between them at the
+// even coordinates in between, so a width x height grid holds
+// (width - 1) / 2 x (height - 1) / 2 cells and the border is always wall.
+// An even width or height leaves the last column or row solid.
+//
+// Cells are generated in tiles of tileSize x tileSize, one job per tile.
+// The tiles are joined by a spanning tree of doors picked up front, so
+// Backtracker and Wilson give a perfect maze (exactly one path between any
+// two cells) and Rooms stays connected. Each tile's RNG is derived from the
+// seed and the tile position, so the output depends only on the parameters,
+// never on the thread count.
+struct MazeGenParams
+{
+    MazeAlgorithm algorithm = MazeAlgorithm::Backtracker;
+    int width = 63;
+    int height = 63;
+    uint32_t seed = 1;
+    int tileSize = 128;
+};
+
+// '#' walls and '.' floor, ready for buildMazeFromGrid. With jobs the tiles
+// are generated in parallel; without, on the calling thread.
+std::vector<std::string> generateMaze(const MazeGenParams &params, JobSystem *jobs = nullptr);
+
+const char *mazeAlgorithmName(MazeAlgorithm algorithm);
+bool parseMazeAlgorithm(const std::string &name, MazeAlgorithm &algorithm);
@@ -0,0 +1,638 @@
+#include "pathfind.h"
+
+#include "jobs.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+
+// runs of facing open cells up to this long get one entrance in the middle,
+// longer ones one at each end
+static constexpr int kSingleEntranceMax = 6;
+static constexpr uint32_t kUnreached = std::numeric_limits<uint32_t>::max();
+
+static const int kStepCol[4] = {1, -1, 0, 0};
+static const int kStepRow[4] = {0, 0, 1, -1};
+
+namespace
+{
+    struct CellRect
+    {
+        int col0 = 0, row0 = 0, col1 = 0, row1 = 0;
+
+        bool contains(int col, int row) const { return col >= col0 && row >= row0 && col < col1 && row < row1; }
+    };
+
+    // Breadth-first search over the open cells of one cluster. Distances live
+    // in a cluster-sized array and are valid where the stamp matches, so a
+    // search never clears anything.
+    struct ClusterBfs
+    {
+        CellRect rect;
+        std::vector<uint32_t> dist;
+        std::vector<uint32_t> stamp;
+        std::vector<uint32_t> queue;
+        uint32_t generation = 0;
+
+        void reserve(int clusterSize)
+        {
+            const size_t cells = (size_t)clusterSize * (size_t)clusterSize;
+            if (dist.size() < cells)
+            {
+                dist.resize(cells);
+                stamp.assign(cells, 0);
+                queue.resize(cells);
+                generation = 0;
+            }
+        }
+
+        size_t local(int col, int row) const { return (size_t)(row - rect.row0) * (size_t)(rect.col1 - rect.col0) + (size_t)(col - rect.col0); }
+
+        uint32_t distance(int col, int row) const
+        {
+            if (!rect.contains(col, row))
+                return kUnreached;
+            size_t i = local(col, row);
+            return stamp[i] == generation ? dist[i] : kUnreached;
+        }
+
+        // Stops as soon as `stop` is reached, when it lies inside the rect.
+        void run(const Maze &maze, const CellRect &r, CellCoord source, CellCoord stop)
+        {
+            rect = r;
+            if (++generation == 0)
+            {
+                std::fill(stamp.begin(), stamp.end(), 0u);
+                generation = 1;
+            }
+            const int w = rect.col1 - rect.col0;
+            size_t head = 0, tail = 0;
+            size_t s = local(source.col, source.row);
+            stamp[s] = generation;
+            dist[s] = 0;
+            queue[tail++] = (uint32_t)s;
+            const size_t target = rect.contains(stop.col, stop.row) ? local(stop.col, stop.row) : (size_t)-1;
+            if (s == target)
+                return;
+            while (head < tail)
+            {
+                const uint32_t i = queue[head++];
+                const int col = rect.col0 + (int)(i % (uint32_t)w), row = rect.row0 + (int)(i / (uint32_t)w);
+                for (int k = 0; k < 4; k++)
+                {
+                    const int c = col + kStepCol[k], rr = row + kStepRow[k];
+                    if (!rect.contains(c, rr) || maze.solid.get(c, rr))
+                        continue;
+                    const size_t n = local(c, rr);
+                    if (stamp[n] == generation)
+                        continue;
+                    stamp[n] = generation;
+                    dist[n] = dist[i] + 1;
+                    if (n == target)
+                        return;
+                    queue[tail++] = (uint32_t)n;
+                }
+            }
+        }
+
+        // Appends the cells after `from` down to the search source, stepping to
+        // a neighbour one closer each time; from must have been reached.
+        void walkBack(CellCoord from, std::vector<CellCoord> &out) const
+        {
+            int col = from.col, row = from.row;
+            for (uint32_t d = distance(col, row); d > 0; d--)
+            {
+                for (int k = 0; k < 4; k++)
+                    if (distance(col + kStepCol[k], row + kStepRow[k]) == d - 1)
+                    {
+                        col += kStepCol[k];
+                        row += kStepRow[k];
+                        break;
+                    }
+                out.push_back({(int16_t)col, (int16_t)row});
+            }
+        }
+    };
+
+    struct OpenEntry
+    {
+        uint32_t f;
+        uint32_t g;
+        uint32_t node;
+    };
+
+    // lowest f on top; among equal f the deepest, then the lowest node, so
+    // the result does not depend on heap internals
+    struct OpenOrder
+    {
+        bool operator()(const OpenEntry &a, const OpenEntry &b) const
+        {
+            if (a.f != b.f)
+                return a.f > b.f;
+            if (a.g != b.g)
+                return a.g < b.g;
+            return a.node > b.node;
+        }
+    };
+
+    // Per-thread query state, sized for the largest graph the thread has seen.
+    struct SearchScratch
+    {
+        ClusterBfs bfs;
+        // by node; the start and goal cells are nodes n and n + 1
+        std::vector<uint32_t> g;
+        std::vector<uint32_t> parent;
+        std::vector<uint32_t> stamp;
+        uint32_t generation = 0;
+        // by node of the goal's cluster, its distance to the goal
+        std::vector<uint32_t> goalCost;
+        std::vector<OpenEntry> open;
+        std::vector<CellCoord> segment;
+
+        void prepare(const PathGraph &graph)
+        {
+            bfs.reserve(graph.clusterSize);
+            const size_t n = graph.nodes.size() + 2;
+            if (g.size() < n)
+            {
+                g.resize(n);
+                parent.resize(n);
+                stamp.assign(n, 0);
+                generation = 0;
+            }
+            if (++generation == 0)
+            {
+                std::fill(stamp.begin(), stamp.end(), 0u);
+                generation = 1;
+            }
+        }
+    };
+
+    thread_local SearchScratch tlsScratch;
+} // namespace
+
+static bool cellBefore(CellCoord a, CellCoord b)
+{
+    return a.row != b.row ? a.row < b.row : a.col < b.col;
+}
+
+static bool sameCell(CellCoord a, CellCoord b)
+{
+    return a.col == b.col && a.row == b.row;
+}
+
+static bool isOpen(const Maze &maze, CellCoord c)
+{
+    return maze.solid.contains(c.col, c.row) && !maze.solid.get(c.col, c.row);
+}
+
+static CellRect clusterRect(const PathGraph &graph, uint32_t cluster)
+{
+    CellRect r;
+    r.col0 = (int)(cluster % (uint32_t)graph.clustersX) * graph.clusterSize;
+    r.row0 = (int)(cluster / (uint32_t)graph.clustersX) * graph.clusterSize;
+    r.col1 = std::min(graph.gridWidth, r.col0 + graph.clusterSize);
+    r.row1 = std::min(graph.gridHeight, r.row0 + graph.clusterSize);
+    return r;
+}
+
+// Entrance cells on this cluster's side of one border, scanned along len
+// cells from (col, row) by (stepCol, stepRow); (acrossCol, acrossRow) leads to
+// the facing cell. The neighbour scans the same border from its side with the
+// same rule, so both pick the same rows (or columns).
+static void borderEntrances(const Maze &maze, int col, int row, int stepCol, int stepRow, int len, int acrossCol, int acrossRow,
+                            std::vector<CellCoord> &out)
+{
+    auto facing = [&](int i)
+    {
+        const int c = col + stepCol * i, r = row + stepRow * i;
+        return !maze.solid.get(c, r) && !maze.solid.get(c + acrossCol, r + acrossRow);
+    };
+    auto add = [&](int i)
+    { out.push_back({(int16_t)(col + stepCol * i), (int16_t)(row + stepRow * i)}); };
+
+    for (int i = 0; i < len;)
+    {
+        if (!facing(i))
+        {
+            i++;
+            continue;
+        }
+        int j = i;
+        while (j + 1 < len && facing(j + 1))
+            j++;
+        if (j - i + 1 <= kSingleEntranceMax)
+            add((i + j) / 2);
+        else
+        {
+            add(i);
+            add(j);
+        }
+        i = j + 1;
+    }
+}
+
+size_t PathGraph::bytes() const
+{
+    return nodes.size() * sizeof(CellCoord) + clusterFirstNode.size() * sizeof(uint32_t) + edgeFirst.size() * sizeof(uint32_t) +
+           edges.size() * sizeof(Edge);
+}
+
+PathGraph buildPathGraph(const Maze &maze, const PathParams &params, JobSystem *jobs)
+{
+    PathGraph graph;
+    graph.gridWidth = maze.gridWidth;
+    graph.gridHeight = maze.gridHeight;
+    graph.clusterSize = std::clamp(params.clusterSize, 2, 256);
+    graph.clustersX = (maze.gridWidth + graph.clusterSize - 1) / graph.clusterSize;
+    graph.clustersY = (maze.gridHeight + graph.clusterSize - 1) / graph.clusterSize;
+    const size_t clusters = (size_t)graph.clustersX * (size_t)graph.clustersY;
+    // built as vectors, handed to the graph at the end
+    std::vector<CellCoord> nodes;
+    std::vector<uint32_t> clusterFirstNode(clusters + 1, 0);
+    std::vector<uint32_t> edgeFirst;
+    std::vector<PathGraph::Edge> edges;
+    if (clusters == 0)
+    {
+        graph.clusterFirstNode = std::move(clusterFirstNode);
+        graph.edgeFirst = {0};
+        return graph;
+    }
+    auto parallel = [&](const std::function<void(size_t, size_t)> &fn)
+    {
+        if (jobs)
+            jobs->parallelFor(clusters, 64, fn);
+        else
+            fn(0, clusters);
+    };
+
+    // entrances on all four borders of every cluster
+    std::vector<std::vector<CellCoord>> clusterNodes(clusters);
+    parallel([&](size_t begin, size_t end)
+             {
+                 for (size_t c = begin; c < end; c++)
+                 {
+                     const CellRect r = clusterRect(graph, (uint32_t)c);
+                     std::vector<CellCoord> &out = clusterNodes[c];
+                     const int w = r.col1 - r.col0, h = r.row1 - r.row0;
+                     if (r.col1 < maze.gridWidth)
+                         borderEntrances(maze, r.col1 - 1, r.row0, 0, 1, h, 1, 0, out);
+                     if (r.col0 > 0)
+                         borderEntrances(maze, r.col0, r.row0, 0, 1, h, -1, 0, out);
+                     if (r.row1 < maze.gridHeight)
+                         borderEntrances(maze, r.col0, r.row1 - 1, 1, 0, w, 0, 1, out);
+                     if (r.row0 > 0)
+                         borderEntrances(maze, r.col0, r.row0, 1, 0, w, 0, -1, out);
+                     // a corner cell can be an entrance on two borders
+                     std::sort(out.begin(), out.end(), cellBefore);
+                     out.erase(std::unique(out.begin(), out.end(), sameCell), out.end());
+                 }
+             });
+    for (size_t c = 0; c < clusters; c++)
+        clusterFirstNode[c + 1] = clusterFirstNode[c] + (uint32_t)clusterNodes[c].size();
+    nodes.resize(clusterFirstNode[clusters]);
+    for (size_t c = 0; c < clusters; c++)
+    {
+        std::copy(clusterNodes[c].begin(), clusterNodes[c].end(), nodes.begin() + clusterFirstNode[c]);
+        std::vector<CellCoord>().swap(clusterNodes[c]);
+    }
+
+    // A BFS from each node gives its edges to the rest of its cluster; a
+    // facing entrance across a border is one step away.
+    std::vector<std::vector<PathGraph::Edge>> clusterEdges(clusters);
+    std::vector<uint32_t> edgeCount(nodes.size(), 0);
+    parallel([&](size_t begin, size_t end)
+             {
+                 ClusterBfs bfs;
+                 bfs.reserve(graph.clusterSize);
+                 for (size_t c = begin; c < end; c++)
+                 {
+                     const CellRect r = clusterRect(graph, (uint32_t)c);
+                     const uint32_t first = clusterFirstNode[c], last = clusterFirstNode[c + 1];
+                     std::vector<PathGraph::Edge> &out = clusterEdges[c];
+                     for (uint32_t n = first; n < last; n++)
+                     {
+                         const size_t before = out.size();
+                         const CellCoord cell = nodes[n];
+                         bfs.run(maze, r, cell, {-1, -1});
+                         for (uint32_t m = first; m < last; m++)
+                         {
+                             uint32_t d = bfs.distance(nodes[m].col, nodes[m].row);
+                             if (m != n && d != kUnreached)
+                                 out.push_back({m, d});
+                         }
+                         for (int k = 0; k < 4; k++)
+                         {
+                             const CellCoord next{(int16_t)(cell.col + kStepCol[k]), (int16_t)(cell.row + kStepRow[k])};
+                             if (r.contains(next.col, next.row) || !isOpen(maze, next))
+                                 continue;
+                             const uint32_t other = graph.clusterOf(next.col, next.row);
+                             auto b = nodes.begin() + clusterFirstNode[other];
+                             auto e = nodes.begin() + clusterFirstNode[other + 1];
+                             auto it = std::lower_bound(b, e, next, cellBefore);
+                             if (it != e && sameCell(*it, next))
+                                 out.push_back({(uint32_t)(it - nodes.begin()), 1});
+                         }
+                         edgeCount[n] = (uint32_t)(out.size() - before);
+                     }
+                 }
+             });
+
+    edgeFirst.assign(nodes.size() + 1, 0);
+    for (size_t n = 0; n < nodes.size(); n++)
+        edgeFirst[n + 1] = edgeFirst[n] + edgeCount[n];
+    edges.reserve(edgeFirst.back());
+    for (auto &e : clusterEdges)
+    {
+        edges.insert(edges.end(), e.begin(), e.end());
+        std::vector<PathGraph::Edge>().swap(e);
+    }
+    graph.nodes = std::move(nodes);
+    graph.clusterFirstNode = std::move(clusterFirstNode);
+    graph.edgeFirst = std::move(edgeFirst);
+    graph.edges = std::move(edges);
+    return graph;
+}
+
+PathCache::PathCache(size_t capacity) : capacityPerShard(std::max<size_t>(1, capacity / kShards))
+{
+}
+
+static uint64_t segmentKey(uint32_t a, uint32_t b)
+{
+    return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+bool PathCache::get(uint32_t from, uint32_t to, std::vector<CellCoord> &out)
+{
+    const uint64_t key = segmentKey(from, to);
+    Shard &s = shards[key % kShards];
+    std::lock_guard<std::mutex> lock(s.m);
+    auto it = s.entries.find(key);
+    if (it == s.entries.end())
+    {
+        s.misses++;
+        return false;
+    }
+    s.hits++;
+    s.lru.splice(s.lru.begin(), s.lru, it->second.pos);
+    const std::vector<CellCoord> &cells = it->second.cells;
+    if (from < to)
+        out.insert(out.end(), cells.begin() + 1, cells.end());
+    else
+        out.insert(out.end(), cells.rbegin() + 1, cells.rend());
+    return true;
+}
+
+void PathCache::put(uint32_t from, uint32_t to, const CellCoord *cells, size_t count)
+{
+    const uint64_t key = segmentKey(from, to);
+    Shard &s = shards[key % kShards];
+    std::lock_guard<std::mutex> lock(s.m);
+    if (s.entries.count(key))
+        return;
+    s.lru.push_front(key);
+    Shard::Entry &e = s.entries[key];
+    e.pos = s.lru.begin();
+    if (from < to)
+        e.cells.assign(cells, cells + count);
+    else
+        e.cells.assign(std::reverse_iterator<const CellCoord *>(cells + count), std::reverse_iterator<const CellCoord *>(cells));
+    while (s.entries.size() > capacityPerShard)
+    {
+        s.entries.erase(s.lru.back());
+        s.lru.pop_back();
+    }
+}
+
+void PathCache::clear()
+{
+    for (Shard &s : shards)
+    {
+        std::lock_guard<std::mutex> lock(s.m);
+        s.lru.clear();
+        s.entries.clear();
+        s.hits = s.misses = 0;
+    }
+}
+
+size_t PathCache::size() const
+{
+    size_t n = 0;
+    for (const Shard &s : shards)
+    {
+        std::lock_guard<std::mutex> lock(s.m);
+        n += s.entries.size();
+    }
+    return n;
+}
+
+uint64_t PathCache::hits() const
+{
+    uint64_t n = 0;
+    for (const Shard &s : shards)
+    {
+        std::lock_guard<std::mutex> lock(s.m);
+        n += s.hits;
+    }
+    return n;
+}
+
+uint64_t PathCache::misses() const
+{
+    uint64_t n = 0;
+    for (const Shard &s : shards)
+    {
+        std::lock_guard<std::mutex> lock(s.m);
+        n += s.misses;
+    }
+    return n;
+}
+
+void PathPlan::clear()
+{
+    waypoints.clear();
+    waypointNodes.clear();
+    cells.clear();
+    refined = 0;
+    length = 0;
+}
+
+// Appends the cells of segment k, after its first waypoint. Segments between
+// two nodes are always searched from the higher node to the lower one, so a
+// cached segment is the same whichever direction first asked for it.
+static void refineSegment(const PathGraph &graph, const Maze &maze, PathPlan &plan, size_t k, PathCache *cache, SearchScratch &s)
+{
+    CellCoord a = plan.waypoints[k], b = plan.waypoints[k + 1];
+    const uint32_t na = plan.waypointNodes[k], nb = plan.waypointNodes[k + 1];
+    if (sameCell(a, b))
+        return;
+    if (std::abs(a.col - b.col) + std::abs(a.row - b.row) == 1)
+    {
+        plan.cells.push_back(b);
+        return;
+    }
+    const bool nodes = na != PathPlan::kNoNode && nb != PathPlan::kNoNode;
+    if (nodes && cache && cache->get(na, nb, plan.cells))
+        return;
+
+    CellCoord from = a, to = b;
+    if (nodes && na > nb)
+        std::swap(from, to);
+    s.bfs.run(maze, clusterRect(graph, graph.clusterOf(a.col, a.row)), to, from);
+    s.segment.assign(1, from);
+    s.bfs.walkBack(from, s.segment);
+    if (nodes && cache)
+        cache->put(std::min(na, nb), std::max(na, nb), s.segment.data(), s.segment.size());
+    if (sameCell(from, a))
+        plan.cells.insert(plan.cells.end(), s.segment.begin() + 1, s.segment.end());
+    else
+        plan.cells.insert(plan.cells.end(), s.segment.rbegin() + 1, s.segment.rend());
+}
+
+size_t refinePath(const PathGraph &graph, const Maze &maze, PathPlan &plan, size_t minCells, PathCache *cache)
+{
+    SearchScratch &s = tlsScratch;
+    s.bfs.reserve(graph.clusterSize);
+    while (!plan.complete() && plan.cells.size() < minCells)
+    {
+        refineSegment(graph, maze, plan, plan.refined, cache, s);
+        plan.refined++;
+    }
+    return plan.cells.size();
+}
+
+bool planPath(const PathGraph &graph, const Maze &maze, CellCoord start, CellCoord goal, PathPlan &plan, PathCache *cache)
+{
+    plan.clear();
+    if (!isOpen(maze, start) || !isOpen(maze, goal) || graph.clusterSize <= 0)
+        return false;
+    auto finish = [&]()
+    {
+        plan.cells.push_back(start);
+        refinePath(graph, maze, plan, 2, cache);
+        return true;
+    };
+    if (sameCell(start, goal))
+    {
+        plan.waypoints = {start};
+        plan.waypointNodes = {PathPlan::kNoNode};
+        return finish();
+    }
+
+    SearchScratch &s = tlsScratch;
+    s.prepare(graph);
+    const uint32_t startCluster = graph.clusterOf(start.col, start.row);
+    const uint32_t goalCluster = graph.clusterOf(goal.col, goal.row);
+    const CellRect startRect = clusterRect(graph, startCluster);
+    const CellRect goalRect = clusterRect(graph, goalCluster);
+
+    // within one cluster a local path wins when there is one
+    if (startCluster == goalCluster)
+    {
+        s.bfs.run(maze, startRect, start, goal);
+        uint32_t d = s.bfs.distance(goal.col, goal.row);
+        if (d != kUnreached)
+        {
+            plan.waypoints = {start, goal};
+            plan.waypointNodes = {PathPlan::kNoNode, PathPlan::kNoNode};
+            plan.length = d;
+            return finish();
+        }
+    }
+
+    const uint32_t startNode = (uint32_t)graph.nodes.size(), goalNode = startNode + 1;
+    auto heuristic = [&](uint32_t n)
+    {
+        if (n == goalNode)
+            return 0u;
+        return (uint32_t)(std::abs(graph.nodes[n].col - goal.col) + std::abs(graph.nodes[n].row - goal.row));
+    };
+    s.open.clear();
+    auto relax = [&](uint32_t n, uint32_t g, uint32_t from)
+    {
+        if (s.stamp[n] == s.generation && s.g[n] <= g)
+            return;
+        s.stamp[n] = s.generation;
+        s.g[n] = g;
+        s.parent[n] = from;
+        s.open.push_back({g + heuristic(n), g, n});
+        std::push_heap(s.open.begin(), s.open.end(), OpenOrder{});
+    };
+
+    // the start and goal cells join the graph through their clusters' nodes
+    s.stamp[startNode] = s.generation;
+    s.g[startNode] = 0;
+    s.bfs.run(maze, startRect, start, {-1, -1});
+    for (uint32_t n = graph.clusterFirstNode[startCluster]; n < graph.clusterFirstNode[startCluster + 1]; n++)
+    {
+        uint32_t d = s.bfs.distance(graph.nodes[n].col, graph.nodes[n].row);
+        if (d != kUnreached)
+            relax(n, d, startNode);
+    }
+    const uint32_t goalFirst = graph.clusterFirstNode[goalCluster], goalLast = graph.clusterFirstNode[goalCluster + 1];
+    s.bfs.run(maze, goalRect, goal, {-1, -1});
+    s.goalCost.resize(goalLast - goalFirst);
+    for (uint32_t n = goalFirst; n < goalLast; n++)
+        s.goalCost[n - goalFirst] = s.bfs.distance(graph.nodes[n].col, graph.nodes[n].row);
+
+    bool found = false;
+    while (!s.open.empty())
+    {
+        std::pop_heap(s.open.begin(), s.open.end(), OpenOrder{});
+        const OpenEntry e = s.open.back();
+        s.open.pop_back();
+        if (e.g != s.g[e.node])
+            continue;
+        if (e.node == goalNode)
+        {
+            found = true;
+            break;
+        }
+        if (e.node >= goalFirst && e.node < goalLast && s.goalCost[e.node - goalFirst] != kUnreached)
+            relax(goalNode, e.g + s.goalCost[e.node - goalFirst], e.node);
+        for (uint32_t i = graph.edgeFirst[e.node]; i < graph.edgeFirst[e.node + 1]; i++)
+            relax(graph.edges[i].to, e.g + graph.edges[i].cost, e.node);
+    }
+    if (!found)
+        return false;
+
+    plan.length = s.g[goalNode];
+    for (uint32_t n = goalNode; n != startNode; n = s.parent[n])
+    {
+        plan.waypoints.push_back(n == goalNode ? goal : graph.nodes[n]);
+        plan.waypointNodes.push_back(n == goalNode ? PathPlan::kNoNode : n);
+    }
+    plan.waypoints.push_back(start);
+    plan.waypointNodes.push_back(PathPlan::kNoNode);
+    std::reverse(plan.waypoints.begin(), plan.waypoints.end());
+    std::reverse(plan.waypointNodes.begin(), plan.waypointNodes.end());
+    return finish();
+}
+
+bool findPath(const PathGraph &graph, const Maze &maze, CellCoord start, CellCoord goal, std::vector<CellCoord> &out, PathCache *cache)
+{
+    PathPlan plan;
+    if (!planPath(graph, maze, start, goal, plan, cache))
+        return false;
+    refinePath(graph, maze, plan, std::numeric_limits<size_t>::max(), cache);
+    out = std::move(plan.cells);
+    return true;
+}
+
+void planPaths(const PathGraph &graph, const Maze &maze, const std::vector<PathRequest> &requests, std::vector<PathPlan> &plans,
+               size_t minCells, JobSystem *jobs, PathCache *cache)
+{
+    plans.resize(requests.size());
+    auto planRange = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            if (planPath(graph, maze, requests[i].start, requests[i].goal, plans[i], cache))
+                refinePath(graph, maze, plans[i], minCells, cache);
+    };
+    if (jobs)
+        jobs->parallelFor(requests.size(), 8, planRange);
+    else
+        planRange(0, requests.size());
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "maze.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class JobSystem;
+
+struct PathParams
+{
+    // cells per cluster side, at most 256
+    int clusterSize = 32;
+};
+
+// Hierarchical (HPA*) abstraction of the maze grid. The grid is cut into
+// square clusters; wherever a run of open cells faces another open run across
+// a cluster border, one or two entrance cells on each side become nodes. Nodes
+// of the same cluster are joined by their shortest path inside the cluster,
+// and facing entrance cells by a single step. Movement is 4-connected at unit
+// cost per cell, so every edge cost is a path length in cells.
+//
+// Nodes are grouped by cluster (row-major clusters, row-major cells within
+// one) and edges are stored per node, both as offset arrays. A map file can
+// store the arrays, which are then used in place (see map_file.h).
+struct PathGraph
+{
+    struct Edge
+    {
+        uint32_t to = 0;
+        uint32_t cost = 0;
+    };
+
+    int gridWidth = 0;
+    int gridHeight = 0;
+    int clusterSize = 0;
+    int clustersX = 0;
+    int clustersY = 0;
+    MappedArray<CellCoord> nodes;
+    // nodes of cluster c are [clusterFirstNode[c], clusterFirstNode[c + 1])
+    MappedArray<uint32_t> clusterFirstNode;
+    // edges of node n are edges[edgeFirst[n]] .. edges[edgeFirst[n + 1] - 1]
+    MappedArray<uint32_t> edgeFirst;
+    MappedArray<Edge> edges;
+    // keeps the map file alive while the arrays above view it
+    std::shared_ptr<const void> mapping;
+
+    uint32_t clusterOf(int col, int row) const { return (uint32_t)((row / clusterSize) * clustersX + col / clusterSize); }
+    size_t bytes() const;
+};
+
+// Clusters are processed in parallel when a job system is given.
+PathGraph buildPathGraph(const Maze &maze, const PathParams &params = {}, JobSystem *jobs = nullptr);
+
+// Refined cells between two nodes of the same cluster, shared by every query
+// on one graph. A segment is stored once for both directions. Bounded: past
+// the capacity the least recently used segment is dropped. Thread-safe; the
+// map is split into shards with a lock each so batched queries rarely contend.
+class PathCache
+{
+public:
+    explicit PathCache(size_t capacity = 1 << 16);
+    PathCache(const PathCache &) = delete;
+    PathCache &operator=(const PathCache &) = delete;
+
+    // Appends the cells after `from` up to and including `to`.
+    bool get(uint32_t from, uint32_t to, std::vector<CellCoord> &out);
+    // cells run from `from`'s cell to `to`'s cell, both included
+    void put(uint32_t from, uint32_t to, const CellCoord *cells, size_t count);
+    void clear();
+
+    size_t size() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    static constexpr size_t kShards = 16;
+
+    struct Shard
+    {
+        mutable std::mutex m;
+        // most recently used first; the key is (low node << 32 | high node)
+        std::list<uint64_t> lru;
+        struct Entry
+        {
+            std::list<uint64_t>::iterator pos;
+            std::vector<CellCoord> cells; // from the low node to the high one
+        };
+        std::unordered_map<uint64_t, Entry> entries;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    size_t capacityPerShard;
+    Shard shards[kShards];
+};
+
+// A path on the abstract graph, turned into cells a segment at a time.
+// waypoints runs start, entrance nodes..., goal; cells holds the refined
+// prefix, starting with the start cell, and ends at waypoints[refined].
+struct PathPlan
+{
+    static constexpr uint32_t kNoNode = 0xffffffffu;
+
+    std::vector<CellCoord> waypoints;
+    // graph node of each waypoint; kNoNode for the start and goal cells
+    std::vector<uint32_t> waypointNodes;
+    std::vector<CellCoord> cells;
+    size_t refined = 0;
+    // length in steps of the whole path
+    uint32_t length = 0;
+
+    bool found() const { return !waypoints.empty(); }
+    bool complete() const { return refined + 1 >= waypoints.size(); }
+    void clear();
+};
+
+// Finds the abstract path from start to goal and refines its first segment.
+// Returns false (and leaves plan empty) if either cell is a wall or outside
+// the grid, or the goal cannot be reached.
+bool planPath(const PathGraph &graph, const Maze &maze, CellCoord start, CellCoord goal, PathPlan &plan, PathCache *cache = nullptr);
+
+// Refines further segments until plan.cells holds at least minCells cells
+// or the path is complete; agents call it as they walk instead of paying for
+// the whole path up front. Returns plan.cells.size().
+size_t refinePath(const PathGraph &graph, const Maze &maze, PathPlan &plan, size_t minCells, PathCache *cache = nullptr);
+
+// planPath and a full refinement; out gets every cell from start to goal.
+bool findPath(const PathGraph &graph, const Maze &maze, CellCoord start, CellCoord goal, std::vector<CellCoord> &out,
+              PathCache *cache = nullptr);
+
+struct PathRequest
+{
+    CellCoord start;
+    CellCoord goal;
+};
+
+// Plans every request, spread over the job system when one is given, and
+// refines each plan to at least minCells cells. plans is resized to match.
+void planPaths(const PathGraph &graph, const Maze &maze, const std::vector<PathRequest> &requests, std::vector<PathPlan> &plans,
+               size_t minCells, JobSystem *jobs = nullptr, PathCache *cache = nullptr);
@@ -0,0 +1,292 @@
+#include "pvs.h"
+
+#include "jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+static const char kMagic[4] = {'F', 'P', 'V', 'S'};
+static constexpr uint32_t kVersion = 2;
+
+static void hashBytes(uint64_t &h, const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+}
+
+uint64_t pvsKey(const Maze &maze, const PvsParams &params)
+{
+    uint64_t h = 14695981039346656037ull;
+    hashBytes(h, &kVersion, sizeof(kVersion));
+    hashBytes(h, &params.originsPerAxis, sizeof(params.originsPerAxis));
+    hashBytes(h, &params.directions, sizeof(params.directions));
+    hashBytes(h, &maze.gridWidth, sizeof(maze.gridWidth));
+    hashBytes(h, &maze.gridHeight, sizeof(maze.gridHeight));
+    hashBytes(h, &maze.cellSize, sizeof(maze.cellSize));
+    hashBytes(h, maze.solid.words().data(), maze.solid.bytes());
+    return h;
+}
+
+static void putVarint(std::vector<uint8_t> &out, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static uint32_t getVarint(const uint8_t *&p)
+{
+    uint32_t v = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        uint8_t b = *p++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+}
+
+// Walks the grid from (ox, oy) in grid units along (dx, dy) and returns the
+// first solid cell as row * width + col, or -1 if the ray leaves the grid.
+static long firstWallHit(const Maze &maze, float ox, float oy, float dx, float dy)
+{
+    int c = (int)ox, r = (int)oy;
+    const float inf = std::numeric_limits<float>::infinity();
+    int stepX = dx > 0.0f ? 1 : -1;
+    int stepY = dy > 0.0f ? 1 : -1;
+    float tDeltaX = dx != 0.0f ? 1.0f / std::fabs(dx) : inf;
+    float tDeltaY = dy != 0.0f ? 1.0f / std::fabs(dy) : inf;
+    float tMaxX = dx != 0.0f ? (dx > 0.0f ? (float)(c + 1) - ox : ox - (float)c) * tDeltaX : inf;
+    float tMaxY = dy != 0.0f ? (dy > 0.0f ? (float)(r + 1) - oy : oy - (float)r) * tDeltaY : inf;
+
+    for (;;)
+    {
+        if (tMaxX < tMaxY)
+        {
+            c += stepX;
+            tMaxX += tDeltaX;
+        }
+        else
+        {
+            r += stepY;
+            tMaxY += tDeltaY;
+        }
+        if (c < 0 || r < 0 || c >= maze.gridWidth || r >= maze.gridHeight)
+            return -1;
+        if (maze.solid.get(c, r))
+            return (long)r * maze.gridWidth + c;
+    }
+}
+
+namespace
+{
+    // Per-thread marks of the walls already hit from the current cell. A new
+    // generation per cell makes every old mark stale, so nothing is cleared.
+    struct HitScratch
+    {
+        std::vector<uint32_t> stamp;
+        uint32_t generation = 0;
+    };
+
+    thread_local HitScratch tlsHits;
+} // namespace
+
+// Encodes ascending, distinct wall indices as a pair count followed by
+// (gap, run) pairs.
+static void encodeRuns(const std::vector<uint32_t> &walls, std::vector<uint8_t> &out)
+{
+    std::vector<uint32_t> pairs;
+    uint32_t pos = 0;
+    for (size_t i = 0; i < walls.size();)
+    {
+        size_t j = i + 1;
+        while (j < walls.size() && walls[j] == walls[j - 1] + 1)
+            j++;
+        pairs.push_back(walls[i] - pos);
+        pairs.push_back((uint32_t)(j - i));
+        pos = walls[j - 1] + 1;
+        i = j;
+    }
+    putVarint(out, (uint32_t)(pairs.size() / 2));
+    for (uint32_t v : pairs)
+        putVarint(out, v);
+}
+
+Pvs buildPvs(const Maze &maze, const PvsParams &params, JobSystem *jobs)
+{
+    Pvs pvs;
+    pvs.gridWidth = maze.gridWidth;
+    pvs.gridHeight = maze.gridHeight;
+    pvs.key = pvsKey(maze, params);
+
+    const size_t cells = (size_t)maze.gridWidth * (size_t)maze.gridHeight;
+    // wall-cell numbering in row-major order
+    std::vector<uint32_t> wallIndex(cells, Pvs::kNone);
+    for (size_t i = 0; i < cells; i++)
+        if (maze.solid.get((int)(i % (size_t)maze.gridWidth), (int)(i / (size_t)maze.gridWidth)))
+            wallIndex[i] = pvs.wallCount++;
+
+    std::vector<glm::vec2> dirs((size_t)params.directions);
+    for (int k = 0; k < params.directions; k++)
+    {
+        // half-step offset keeps the rays off the exact grid axes
+        double a = (k + 0.5) * 6.283185307179586 / params.directions;
+        dirs[(size_t)k] = {(float)std::cos(a), (float)std::sin(a)};
+    }
+
+    // each cell's distinct hits are gathered in a list rather than a bitset
+    // over all walls, so a cell costs what it sees, not the size of the map
+    std::vector<std::vector<uint8_t>> encoded(cells);
+    auto buildRange = [&](size_t begin, size_t end)
+    {
+        HitScratch &scratch = tlsHits;
+        if (scratch.stamp.size() < pvs.wallCount)
+            scratch.stamp.resize(pvs.wallCount, 0);
+        std::vector<uint32_t> hits;
+        for (size_t cell = begin; cell < end; cell++)
+        {
+            const int c = (int)(cell % (size_t)maze.gridWidth);
+            const int r = (int)(cell / (size_t)maze.gridWidth);
+            if (maze.solid.get(c, r))
+                continue;
+            hits.clear();
+            if (++scratch.generation == 0)
+            {
+                std::fill(scratch.stamp.begin(), scratch.stamp.end(), 0u);
+                scratch.generation = 1;
+            }
+            for (int oy = 0; oy < params.originsPerAxis; oy++)
+                for (int ox = 0; ox < params.originsPerAxis; ox++)
+                {
+                    float x = (float)c + ((float)ox + 0.5f) / (float)params.originsPerAxis;
+                    float y = (float)r + ((float)oy + 0.5f) / (float)params.originsPerAxis;
+                    for (const auto &d : dirs)
+                    {
+                        long hit = firstWallHit(maze, x, y, d.x, d.y);
+                        if (hit < 0)
+                            continue;
+                        const uint32_t wall = wallIndex[(size_t)hit];
+                        if (scratch.stamp[wall] != scratch.generation)
+                        {
+                            scratch.stamp[wall] = scratch.generation;
+                            hits.push_back(wall);
+                        }
+                    }
+                }
+            std::sort(hits.begin(), hits.end());
+            encodeRuns(hits, encoded[cell]);
+        }
+    };
+    if (jobs)
+        jobs->parallelFor(cells, 16, buildRange);
+    else
+        buildRange(0, cells);
+
+    pvs.offsets.assign(cells, Pvs::kNone);
+    for (size_t cell = 0; cell < cells; cell++)
+    {
+        if (wallIndex[cell] != Pvs::kNone)
+            continue;
+        pvs.offsets[cell] = (uint32_t)pvs.data.size();
+        pvs.data.insert(pvs.data.end(), encoded[cell].begin(), encoded[cell].end());
+    }
+    return pvs;
+}
+
+bool pvsVisibleWalls(const Pvs &pvs, int col, int row, std::vector<uint32_t> &out)
+{
+    if (col < 0 || row < 0 || col >= pvs.gridWidth || row >= pvs.gridHeight)
+        return false;
+    uint32_t offset = pvs.offsets[(size_t)row * (size_t)pvs.gridWidth + (size_t)col];
+    if (offset == Pvs::kNone)
+        return false;
+
+    const uint8_t *p = pvs.data.data() + offset;
+    uint32_t pairs = getVarint(p);
+    uint32_t pos = 0;
+    for (uint32_t k = 0; k < pairs; k++)
+    {
+        pos += getVarint(p);
+        uint32_t run = getVarint(p);
+        for (uint32_t i = 0; i < run; i++)
+            out.push_back(pos++);
+    }
+    return true;
+}
+
+static void putU32(std::ostream &o, uint32_t v)
+{
+    char b[4] = {(char)(v & 0xff), (char)((v >> 8) & 0xff), (char)((v >> 16) & 0xff), (char)(v >> 24)};
+    o.write(b, 4);
+}
+
+static bool getU32(std::istream &i, uint32_t &v)
+{
+    unsigned char b[4];
+    if (!i.read((char *)b, 4))
+        return false;
+    v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+    return true;
+}
+
+// magic, version, key (2 x u32), width, height, wall count, data size,
+// then one u32 offset per cell and the run data
+bool savePvs(const Pvs &pvs, const std::string &path)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    file.write(kMagic, 4);
+    putU32(file, kVersion);
+    putU32(file, (uint32_t)(pvs.key & 0xffffffffu));
+    putU32(file, (uint32_t)(pvs.key >> 32));
+    putU32(file, (uint32_t)pvs.gridWidth);
+    putU32(file, (uint32_t)pvs.gridHeight);
+    putU32(file, pvs.wallCount);
+    putU32(file, (uint32_t)pvs.data.size());
+    for (uint32_t offset : pvs.offsets)
+        putU32(file, offset);
+    file.write((const char *)pvs.data.data(), (std::streamsize)pvs.data.size());
+    return (bool)file;
+}
+
+bool loadPvs(Pvs &pvs, const std::string &path, uint64_t expectedKey)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[4];
+    if (!file.read(magic, 4) || std::memcmp(magic, kMagic, 4) != 0)
+        return false;
+    uint32_t version, keyLo, keyHi, width, height, wallCount, dataSize;
+    if (!getU32(file, version) || version != kVersion || !getU32(file, keyLo) || !getU32(file, keyHi))
+        return false;
+    uint64_t key = ((uint64_t)keyHi << 32) | keyLo;
+    if (key != expectedKey)
+        return false;
+    if (!getU32(file, width) || !getU32(file, height) || !getU32(file, wallCount) || !getU32(file, dataSize))
+        return false;
+
+    Pvs loaded;
+    loaded.gridWidth = (int)width;
+    loaded.gridHeight = (int)height;
+    loaded.wallCount = wallCount;
+    loaded.key = key;
+    loaded.offsets.resize((size_t)width * height);
+    for (auto &offset : loaded.offsets)
+        if (!getU32(file, offset) || (offset != Pvs::kNone && offset >= dataSize))
+            return false;
+    loaded.data.resize(dataSize);
+    if (!file.read((char *)loaded.data.data(), (std::streamsize)dataSize))
+        return false;
+    pvs = std::move(loaded);
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "maze.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Sampling density of the PVS build: rays are cast from an
+// originsPerAxis x originsPerAxis lattice inside each empty cell, in
+// `directions` evenly spaced horizontal directions. Walls are taller than the
+// eye, so visibility is decided on the grid in 2D.
+struct PvsParams
+{
+    int originsPerAxis = 4;
+    int directions = 720;
+};
+
+// Potentially visible set: for every empty cell, the wall cells a sampled ray
+// from inside it reaches first. Wall cells are numbered in row-major order,
+// the same order bakeWallMesh emits their index ranges in. Each cell's set is
+// stored as varint (gap, run) pairs over that numbering.
+struct Pvs
+{
+    static constexpr uint32_t kNone = 0xffffffffu;
+
+    int gridWidth = 0;
+    int gridHeight = 0;
+    uint32_t wallCount = 0;
+    // identifies the grid and parameters the set was built for
+    uint64_t key = 0;
+    // per grid cell, offset of its run list in data; kNone for wall cells
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t> data;
+};
+
+// FNV-1a over the occupancy grid, cell size and sampling parameters.
+uint64_t pvsKey(const Maze &maze, const PvsParams &params);
+// Cells are processed in parallel when a job system is given.
+Pvs buildPvs(const Maze &maze, const PvsParams &params = {}, JobSystem *jobs = nullptr);
+
+// Appends the wall-cell indices visible from (col, row) to out in ascending
+// order. Returns false (and appends nothing) for wall or out-of-grid cells.
+bool pvsVisibleWalls(const Pvs &pvs, int col, int row, std::vector<uint32_t> &out);
+
+bool savePvs(const Pvs &pvs, const std::string &path);
+// Fails if the file is missing, damaged or was built for a different key.
+bool loadPvs(Pvs &pvs, const std::string &path, uint64_t expectedKey);
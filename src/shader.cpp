@@ -2,6 +2,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
 
 static std::string readFile(const char* path) {
     std::ifstream file(path);
@@ -31,6 +32,78 @@ Shader::Shader(const char* vert, const char* frag) {
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    GLuint cameraBlock = glGetUniformBlockIndex(ID, "Camera");
+    if (cameraBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, cameraBlock, kCameraBlockBinding);
+
+    cacheUniforms();
+}
+
+void Shader::cacheUniforms() {
+    GLint count = 0, maxLen = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLen);
+    std::vector<GLchar> buf((size_t)maxLen + 1);
+
+    for (GLint i = 0; i < count; i++) {
+        GLsizei len = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)buf.size(), &len, &size, &type, buf.data());
+        std::string name(buf.data(), (size_t)len);
+
+        // uniform block members have no location
+        GLint loc = glGetUniformLocation(ID, name.c_str());
+        if (loc < 0)
+            continue;
+        // arrays are reported as "name[0]"
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            name.resize(name.size() - 3);
+
+        Uniform u;
+        u.location = loc;
+        handles[name] = (int)uniforms.size();
+        uniforms.push_back(u);
+    }
+}
+
+int Shader::uniform(const char* name) const {
+    auto it = handles.find(name);
+    return it == handles.end() ? -1 : it->second;
+}
+
+bool Shader::changed(int handle, const void* data, size_t size) {
+    Uniform& u = uniforms[(size_t)handle];
+    if (u.cached && std::memcmp(u.value, data, size) == 0)
+        return false;
+    std::memcpy(u.value, data, size);
+    u.cached = true;
+    return true;
+}
+
+void Shader::setMat4(int handle, const glm::mat4& m) {
+    if (handle < 0 || !changed(handle, &m[0][0], 16 * sizeof(float)))
+        return;
+    glUniformMatrix4fv(uniforms[(size_t)handle].location, 1, GL_FALSE, &m[0][0]);
+}
+
+void Shader::setVec3(int handle, const glm::vec3& v) {
+    if (handle < 0 || !changed(handle, &v[0], 3 * sizeof(float)))
+        return;
+    glUniform3f(uniforms[(size_t)handle].location, v.x, v.y, v.z);
+}
+
+void Shader::setVec2(int handle, const glm::vec2& v) {
+    if (handle < 0 || !changed(handle, &v[0], 2 * sizeof(float)))
+        return;
+    glUniform2f(uniforms[(size_t)handle].location, v.x, v.y);
+}
+
+void Shader::setInt(int handle, int v) {
+    if (handle < 0 || !changed(handle, &v, sizeof(int)))
+        return;
+    glUniform1i(uniforms[(size_t)handle].location, v);
 }
 
 void Shader::use() {
@@ -1,10 +1,38 @@
 #pragma once
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Uniform buffer binding point of the shared "Camera" block.
+static constexpr GLuint kCameraBlockBinding = 0;
 
 class Shader {
 public:
     GLuint ID;
     Shader(const char* vert, const char* frag);
     void use();
+
+    // Handle of an active uniform, looked up once after linking; -1 if the
+    // program has no such uniform (setters ignore -1).
+    int uniform(const char* name) const;
+
+    // The program must be in use. Values equal to the last upload are skipped.
+    void setMat4(int handle, const glm::mat4& m);
+    void setVec3(int handle, const glm::vec3& v);
+    void setVec2(int handle, const glm::vec2& v);
+    void setInt(int handle, int v);
+
+private:
+    struct Uniform {
+        GLint location = -1;
+        bool cached = false;
+        float value[16];
+    };
+    std::unordered_map<std::string, int> handles;
+    std::vector<Uniform> uniforms;
+
+    void cacheUniforms();
+    bool changed(int handle, const void* data, size_t size);
 };
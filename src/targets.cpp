@@ -0,0 +1,210 @@
+#include "targets.h"
+
+#include "collision.h"
+
+#include <cassert>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TARGETS_SSE2 1
+#endif
+
+void TargetPool::setPosition(size_t i, const glm::vec3 &p)
+{
+    x[i] = p.x;
+    y[i] = p.y;
+    z[i] = p.z;
+}
+
+size_t TargetPool::add(const glm::vec3 &pos, float r)
+{
+    x.push_back(pos.x);
+    y.push_back(pos.y);
+    z.push_back(pos.z);
+    radius.push_back(r);
+    prevPos.push_back(pos);
+    // keep dead targets behind the live range
+    swap(liveCount, x.size() - 1);
+    return liveCount++;
+}
+
+void TargetPool::swap(size_t a, size_t b)
+{
+    if (a == b)
+        return;
+    std::swap(x[a], x[b]);
+    std::swap(y[a], y[b]);
+    std::swap(z[a], z[b]);
+    std::swap(radius[a], radius[b]);
+    std::swap(prevPos[a], prevPos[b]);
+}
+
+void TargetPool::kill(size_t i)
+{
+    assert(i < liveCount);
+    swap(i, --liveCount);
+}
+
+bool TargetPool::respawn(const glm::vec3 &pos)
+{
+    if (!hasDead())
+        return false;
+    setPosition(liveCount, pos);
+    prevPos[liveCount] = pos;
+    liveCount++;
+    return true;
+}
+
+void TargetPool::clear()
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+    prevPos.clear();
+    liveCount = 0;
+}
+
+static void scalarRange(const TargetPool &pool, size_t begin, const glm::vec3 &origin, const glm::vec3 &dir, float &best, int &bestIdx)
+{
+    for (size_t i = begin; i < pool.liveCount; i++)
+    {
+        float t = 0.0f;
+        if (raySphere(origin, dir, pool.position(i), pool.radius[i], t) && t < best)
+        {
+            best = t;
+            bestIdx = (int)i;
+        }
+    }
+}
+
+int raycastTargetsScalar(const TargetPool &pool, const glm::vec3 &origin, const glm::vec3 &dir, float maxT, float &tHit)
+{
+    float best = maxT;
+    int bestIdx = -1;
+    scalarRange(pool, 0, origin, dir, best, bestIdx);
+    if (bestIdx >= 0)
+        tHit = best;
+    return bestIdx;
+}
+
+// Lane-wise minimum reduction: smallest t, lowest index on ties.
+static void reduceLanes(const float *t, const int *idx, int lanes, float &best, int &bestIdx)
+{
+    for (int l = 0; l < lanes; l++)
+    {
+        if (idx[l] < 0)
+            continue;
+        if (t[l] < best || (t[l] == best && idx[l] < bestIdx))
+        {
+            best = t[l];
+            bestIdx = idx[l];
+        }
+    }
+}
+
+int raycastTargets(const TargetPool &pool, const glm::vec3 &origin, const glm::vec3 &dir, float maxT, float &tHit)
+{
+    size_t i = 0;
+    float best = maxT;
+    int bestIdx = -1;
+
+    // Same arithmetic as raySphere, in the same order and without FMA, so
+    // every lane produces bit-identical t values.
+#if defined(__AVX2__)
+    const size_t n = pool.liveCount;
+    const __m256 ox = _mm256_set1_ps(origin.x), oy = _mm256_set1_ps(origin.y), oz = _mm256_set1_ps(origin.z);
+    const __m256 dx = _mm256_set1_ps(dir.x), dy = _mm256_set1_ps(dir.y), dz = _mm256_set1_ps(dir.z);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 vbest = _mm256_set1_ps(maxT);
+    __m256i vidx = _mm256_set1_epi32(-1);
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(8);
+
+    for (; i + 8 <= n; i += 8, lane = _mm256_add_epi32(lane, step))
+    {
+        __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(&pool.x[i]));
+        __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(&pool.y[i]));
+        __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(&pool.z[i]));
+        __m256 r = _mm256_loadu_ps(&pool.radius[i]);
+
+        __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+        __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz)),
+                                 _mm256_mul_ps(r, r));
+        __m256 h = _mm256_sub_ps(_mm256_mul_ps(b, b), c);
+        __m256 valid = _mm256_cmp_ps(h, zero, _CMP_GE_OQ);
+        h = _mm256_sqrt_ps(_mm256_max_ps(h, zero));
+
+        __m256 nb = _mm256_xor_ps(b, sign);
+        __m256 t0 = _mm256_sub_ps(nb, h);
+        __m256 t1 = _mm256_add_ps(nb, h);
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(t1, zero, _CMP_GE_OQ));
+        __m256 t = _mm256_blendv_ps(t1, t0, _mm256_cmp_ps(t0, zero, _CMP_GE_OQ));
+
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, vbest, _CMP_LT_OQ));
+
+        vbest = _mm256_blendv_ps(vbest, t, valid);
+        vidx = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(vidx), _mm256_castsi256_ps(lane), valid));
+    }
+
+    alignas(32) float lt[8];
+    alignas(32) int li[8];
+    _mm256_store_ps(lt, vbest);
+    _mm256_store_si256((__m256i *)li, vidx);
+    reduceLanes(lt, li, 8, best, bestIdx);
+#elif defined(TARGETS_SSE2)
+    const size_t n = pool.liveCount;
+    const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+    const __m128 dx = _mm_set1_ps(dir.x), dy = _mm_set1_ps(dir.y), dz = _mm_set1_ps(dir.z);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 vbest = _mm_set1_ps(maxT);
+    __m128i vidx = _mm_set1_epi32(-1);
+    __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i step = _mm_set1_epi32(4);
+
+    for (; i + 4 <= n; i += 4, lane = _mm_add_epi32(lane, step))
+    {
+        __m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(&pool.x[i]));
+        __m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(&pool.y[i]));
+        __m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(&pool.z[i]));
+        __m128 r = _mm_loadu_ps(&pool.radius[i]);
+
+        __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+        __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)), _mm_mul_ps(r, r));
+        __m128 h = _mm_sub_ps(_mm_mul_ps(b, b), c);
+        __m128 valid = _mm_cmpge_ps(h, zero);
+        h = _mm_sqrt_ps(_mm_max_ps(h, zero));
+
+        __m128 nb = _mm_xor_ps(b, sign);
+        __m128 t0 = _mm_sub_ps(nb, h);
+        __m128 t1 = _mm_add_ps(nb, h);
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(t1, zero));
+        __m128 pick0 = _mm_cmpge_ps(t0, zero);
+        __m128 t = _mm_or_ps(_mm_and_ps(pick0, t0), _mm_andnot_ps(pick0, t1));
+
+        valid = _mm_and_ps(valid, _mm_cmplt_ps(t, vbest));
+
+        vbest = _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, vbest));
+        __m128i vi = _mm_castps_si128(valid);
+        vidx = _mm_or_si128(_mm_and_si128(vi, lane), _mm_andnot_si128(vi, vidx));
+    }
+
+    alignas(16) float lt[4];
+    alignas(16) int li[4];
+    _mm_store_ps(lt, vbest);
+    _mm_store_si128((__m128i *)li, vidx);
+    reduceLanes(lt, li, 4, best, bestIdx);
+#endif
+
+    // remainder (or everything without SIMD); only strictly closer hits win,
+    // and these indices are all higher than the SIMD ones
+    scalarRange(pool, i, origin, dir, best, bestIdx);
+    if (bestIdx >= 0)
+        tHit = best;
+    return bestIdx;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Targets stored as a structure of arrays: the hitscan kernel streams the
+// position/radius arrays and tests 4 (SSE2) or 8 (AVX2) targets per step.
+//
+// The pool is kept densely packed: live targets occupy [0, liveCount) and dead
+// ones follow, so every loop walks only live targets. Killing swaps a target to
+// the end of the live range; respawning revives the first dead slot. Both are
+// O(1) and move indices around, so an index is only valid until the next
+// kill/respawn.
+struct TargetPool
+{
+    std::vector<float> x, y, z;
+    std::vector<float> radius;
+    // previous-tick positions, only read when interpolating for rendering
+    std::vector<glm::vec3> prevPos;
+    size_t liveCount = 0;
+
+    size_t size() const { return x.size(); }
+    bool hasDead() const { return liveCount < x.size(); }
+    glm::vec3 position(size_t i) const { return {x[i], y[i], z[i]}; }
+    void setPosition(size_t i, const glm::vec3 &p);
+    // adds a live target and returns its index
+    size_t add(const glm::vec3 &pos, float r);
+    void kill(size_t i);
+    // revives the most recently killed target at pos; returns false if none is dead
+    bool respawn(const glm::vec3 &pos);
+    void clear();
+
+private:
+    void swap(size_t a, size_t b);
+};
+
+// Closest live target whose sphere the ray enters before maxT.
+// Returns its index and sets tHit, or returns -1. Ties go to the lower index,
+// so the result matches a front-to-back scalar loop over raySphere exactly.
+int raycastTargets(const TargetPool &pool, const glm::vec3 &origin, const glm::vec3 &dir, float maxT, float &tHit);
+// Scalar reference path (also the fallback on non-x86 builds).
+int raycastTargetsScalar(const TargetPool &pool, const glm::vec3 &origin, const glm::vec3 &dir, float maxT, float &tHit);
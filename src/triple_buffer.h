@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer triple buffer. The producer fills
+// writeBuffer() and publishes it; the consumer always gets the newest
+// published value. Neither side ever waits: the producer may publish any
+// number of times between reads, and the consumer keeps its current slot
+// until something newer arrives. Slots are reused, so containers inside T keep
+// their capacity.
+template <typename T>
+class TripleBuffer
+{
+public:
+    T &writeBuffer() { return slots[back]; }
+
+    void publish()
+    {
+        back = middle.exchange((uint8_t)(back | kFresh), std::memory_order_acq_rel) & kIndex;
+    }
+
+    // Newest published value; *updated tells whether it changed since the last read.
+    const T &read(bool *updated = nullptr)
+    {
+        bool fresh = (middle.load(std::memory_order_relaxed) & kFresh) != 0;
+        if (fresh)
+            front = middle.exchange(front, std::memory_order_acq_rel) & kIndex;
+        if (updated)
+            *updated = fresh;
+        return slots[front];
+    }
+
+private:
+    static constexpr uint8_t kIndex = 3;
+    static constexpr uint8_t kFresh = 4;
+
+    T slots[3];
+    // back is owned by the producer, front by the consumer, middle is shared
+    uint8_t back = 0;
+    uint8_t front = 1;
+    std::atomic<uint8_t> middle{2};
+};
@@ -0,0 +1,104 @@
+#include "wall_mesh.h"
+
+#include <algorithm>
+
+static void addQuad(WallMeshData &m, const glm::vec3 (&p)[4], const glm::vec2 (&uv)[4])
+{
+    unsigned int base = (unsigned int)(m.vertices.size() / 5);
+    for (int i = 0; i < 4; i++)
+    {
+        m.vertices.push_back(p[i].x);
+        m.vertices.push_back(p[i].y);
+        m.vertices.push_back(p[i].z);
+        m.vertices.push_back(uv[i].x);
+        m.vertices.push_back(uv[i].y);
+    }
+    const unsigned int idx[] = {0, 1, 2, 2, 3, 0};
+    for (unsigned int i : idx)
+        m.indices.push_back(base + i);
+}
+
+WallMeshData bakeWallMesh(const Maze &maze)
+{
+    return bakeWallMesh(maze, 0, 0, maze.gridWidth, maze.gridHeight);
+}
+
+WallMeshData bakeWallMesh(const Maze &maze, int col0, int row0, int col1, int row1)
+{
+    return bakeWallMesh(maze, maze.solid, 0, 0, col0, row0, col1, row1);
+}
+
+WallMeshData bakeWallMesh(const Maze &maze, const BitGrid &solid, int solidCol0, int solidRow0, int col0, int row0, int col1, int row1)
+{
+    WallMeshData m;
+    col0 = std::max(col0, 0);
+    row0 = std::max(row0, 0);
+    col1 = std::min(col1, maze.gridWidth);
+    row1 = std::min(row1, maze.gridHeight);
+    if (col0 >= col1 || row0 >= row1)
+        return m;
+
+    // per row, which cells have a wall on each side; a face is emitted where
+    // a wall cell's neighbour bit is clear. Only the region's words are
+    // masked, so a chunk costs the same on any map width. Words and rows
+    // below are solid's own.
+    const int wordOffset = solidCol0 / 64;
+    const size_t word0 = (size_t)((col0 >> 6) - wordOffset), word1 = (size_t)(((col1 - 1) >> 6) - wordOffset) + 1;
+    const size_t words = word1 - word0;
+    std::vector<uint64_t> side(4 * words);
+    uint64_t *posX = side.data(), *negX = posX + words, *posZ = negX + words, *negZ = posZ + words;
+    for (int r = row0; r < row1; r++)
+    {
+        const int sr = r - solidRow0;
+        neighbourMask(solid, sr, GridSide::PosX, posX, word0, word1);
+        neighbourMask(solid, sr, GridSide::NegX, negX, word0, word1);
+        neighbourMask(solid, sr, GridSide::PosZ, posZ, word0, word1);
+        neighbourMask(solid, sr, GridSide::NegZ, negZ, word0, word1);
+        const uint64_t *row = solid.rowWords(sr);
+        for (int i = (int)word0; i < (int)word1; i++)
+        {
+            // the region's part of this word
+            const int wordCol = (i + wordOffset) * 64;
+            const int from = std::max(col0 - wordCol, 0), to = std::min(col1 - wordCol, 64);
+            const uint64_t region = (to == 64 ? ~0ull : (1ull << to) - 1) & ~((1ull << from) - 1);
+            for (uint64_t bits = row[i] & region; bits; bits &= bits - 1)
+            {
+                const int bit = lowestBit64(bits);
+                const int c = wordCol + bit;
+                auto open = [&](const uint64_t *mask)
+                { return !((mask[(size_t)i - word0] >> bit) & 1u); };
+
+                AABB b = cellBox(maze, c, r);
+                const glm::vec3 &lo = b.min;
+                const glm::vec3 &hi = b.max;
+                WallMeshRange range;
+                range.box = b;
+                range.firstIndex = (unsigned int)m.indices.size();
+
+                // +X
+                if (open(posX))
+                    addQuad(m, {{hi.x, lo.y, hi.z}, {hi.x, lo.y, lo.z}, {hi.x, hi.y, lo.z}, {hi.x, hi.y, hi.z}},
+                            {{-hi.z, lo.y}, {-lo.z, lo.y}, {-lo.z, hi.y}, {-hi.z, hi.y}});
+                // -X
+                if (open(negX))
+                    addQuad(m, {{lo.x, lo.y, lo.z}, {lo.x, lo.y, hi.z}, {lo.x, hi.y, hi.z}, {lo.x, hi.y, lo.z}},
+                            {{lo.z, lo.y}, {hi.z, lo.y}, {hi.z, hi.y}, {lo.z, hi.y}});
+                // +Z
+                if (open(posZ))
+                    addQuad(m, {{lo.x, lo.y, hi.z}, {hi.x, lo.y, hi.z}, {hi.x, hi.y, hi.z}, {lo.x, hi.y, hi.z}},
+                            {{lo.x, lo.y}, {hi.x, lo.y}, {hi.x, hi.y}, {lo.x, hi.y}});
+                // -Z
+                if (open(negZ))
+                    addQuad(m, {{hi.x, lo.y, lo.z}, {lo.x, lo.y, lo.z}, {lo.x, hi.y, lo.z}, {hi.x, hi.y, lo.z}},
+                            {{-hi.x, lo.y}, {-lo.x, lo.y}, {-lo.x, hi.y}, {-hi.x, hi.y}});
+                // top, always visible from above
+                addQuad(m, {{lo.x, hi.y, hi.z}, {hi.x, hi.y, hi.z}, {hi.x, hi.y, lo.z}, {lo.x, hi.y, lo.z}},
+                        {{lo.x, hi.z}, {hi.x, hi.z}, {hi.x, lo.z}, {lo.x, lo.z}});
+
+                range.indexCount = (unsigned int)m.indices.size() - range.firstIndex;
+                m.ranges.push_back(range);
+            }
+        }
+    }
+    return m;
+}
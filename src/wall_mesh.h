@@ -0,0 +1,36 @@
+#pragma once
+
+#include "maze.h"
+
+#include <vector>
+
+// Index range holding one wall cell's faces, for per-cell culling. Ranges
+// follow the index buffer order, so neighbouring visible cells can be merged
+// into one draw.
+struct WallMeshRange
+{
+    AABB box;
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+};
+
+struct WallMeshData
+{
+    std::vector<float> vertices; // pos(3) + uv(2)
+    std::vector<unsigned int> indices;
+    std::vector<WallMeshRange> ranges;
+};
+
+// Static wall geometry baked from the maze occupancy grid: only faces that
+// border an open cell (or the outside of the grid) are emitted, plus the top
+// faces; bottom faces and faces shared by two walls are dropped. UVs are in
+// world units, so the texture repeats once per unit without a uvScale.
+WallMeshData bakeWallMesh(const Maze &maze);
+// Only the wall cells in [col0, col1) x [row0, row1); faces are still culled
+// against the neighbours outside the region, so regions tile without seams.
+WallMeshData bakeWallMesh(const Maze &maze, int col0, int row0, int col1, int row1);
+// The same, reading occupancy from solid, whose cell (0, 0) is maze cell
+// (solidCol0, solidRow0), instead of Maze::solid; maze only places the boxes.
+// solidCol0 is a multiple of 64, and solid must reach one cell past the
+// region on every side that is not the edge of the maze.
+WallMeshData bakeWallMesh(const Maze &maze, const BitGrid &solid, int solidCol0, int solidRow0, int col0, int row0, int col1, int row1);
@@ -0,0 +1,95 @@
+// SimpleFPS_mapconv: converts a text grid into the binary map format.
+//
+//   SimpleFPS_mapconv <grid.txt> <out.fmap> [--merge] [--no-bvh] [--no-paths] [--no-chunks]
+//                     [--cell-size f] [--wall-height f]
+#include "bench.h"
+#include "bvh.h"
+#include "chunk_stream.h"
+#include "jobs.h"
+#include "map_file.h"
+#include "maze.h"
+#include "pathfind.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    std::string inPath, outPath;
+    bool merge = false;
+    bool withBvh = true;
+    bool withPaths = true;
+    bool withChunks = true;
+    float cellSize = 1.0f;
+    float wallHeight = 1.75f;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--merge") == 0)
+            merge = true;
+        else if (std::strcmp(argv[i], "--no-bvh") == 0)
+            withBvh = false;
+        else if (std::strcmp(argv[i], "--no-paths") == 0)
+            withPaths = false;
+        else if (std::strcmp(argv[i], "--no-chunks") == 0)
+            withChunks = false;
+        else if (std::strcmp(argv[i], "--cell-size") == 0 && i + 1 < argc)
+            cellSize = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--wall-height") == 0 && i + 1 < argc)
+            wallHeight = (float)std::atof(argv[++i]);
+        else if (argv[i][0] != '-' && inPath.empty())
+            inPath = argv[i];
+        else if (argv[i][0] != '-' && outPath.empty())
+            outPath = argv[i];
+        else
+        {
+            inPath.clear();
+            break;
+        }
+    }
+    if (inPath.empty() || outPath.empty() || cellSize <= 0.0f || wallHeight <= 0.0f)
+    {
+        std::printf("usage: %s <grid.txt> <out.fmap> [--merge] [--no-bvh] [--no-paths] [--no-chunks]\n"
+                    "       [--cell-size f] [--wall-height f]\n",
+                    argv[0]);
+        return 2;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::string> grid;
+    if (!loadTextGrid(inPath, grid))
+    {
+        std::printf("cannot read %s\n", inPath.c_str());
+        return 1;
+    }
+    double readSeconds = secondsSince(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    JobSystem jobs;
+    Maze maze = buildMazeFromGrid(grid, cellSize, wallHeight, merge, &jobs);
+    Bvh bvh;
+    if (withBvh)
+        bvh = buildBvh(maze.walls);
+    PathGraph paths;
+    if (withPaths)
+        paths = buildPathGraph(maze, {}, &jobs);
+    double buildSeconds = secondsSince(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    if (!writeMapFile(outPath, maze, merge, withBvh ? &bvh : nullptr, withPaths ? &paths : nullptr,
+                     withChunks ? ChunkStreamParams{}.chunkCells : 0))
+    {
+        std::printf("cannot write %s\n", outPath.c_str());
+        return 1;
+    }
+    double writeSeconds = secondsSince(t0);
+
+    std::printf("%s: %dx%d, %zu wall boxes, %zu empty cells in %zu regions, %zu BVH nodes, %zu path nodes\n", outPath.c_str(),
+                maze.gridWidth, maze.gridHeight, maze.walls.size(), maze.emptyCells.size(), regionCount(maze), bvh.nodes.size(),
+                paths.nodes.size());
+    std::printf("read %.1f ms, build %.1f ms, write %.1f ms\n", readSeconds * 1e3, buildSeconds * 1e3, writeSeconds * 1e3);
+    return 0;
+}
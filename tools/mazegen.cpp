@@ -0,0 +1,120 @@
+// SimpleFPS_mazegen: generates a maze and reports the generation rate.
+//
+//   SimpleFPS_mazegen [--algo backtracker|wilson|rooms] [--size n | --width w --height h]
+//                     [--seed s] [--tile n] [--threads n] [--out file.txt|file.fmap]
+//                     [--merge] [--no-bvh] [--no-paths] [--no-chunks]
+// A .fmap output is built and written in the binary map format, anything else
+// as a text grid.
+#include "bench.h"
+#include "bvh.h"
+#include "chunk_stream.h"
+#include "jobs.h"
+#include "map_file.h"
+#include "maze.h"
+#include "maze_gen.h"
+#include "pathfind.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static bool endsWith(const std::string &s, const char *suffix)
+{
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    MazeGenParams params;
+    params.width = params.height = 1025;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string outPath;
+    bool merge = false;
+    bool withBvh = true;
+    bool withPaths = true;
+    bool withChunks = true;
+    bool ok = true;
+    for (int i = 1; i < argc && ok; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--algo") == 0 && hasValue)
+            ok = parseMazeAlgorithm(argv[++i], params.algorithm);
+        else if (std::strcmp(argv[i], "--size") == 0 && hasValue)
+            params.width = params.height = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--width") == 0 && hasValue)
+            params.width = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--height") == 0 && hasValue)
+            params.height = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+            params.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--tile") == 0 && hasValue)
+            params.tileSize = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+            threads = (unsigned)std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--out") == 0 && hasValue)
+            outPath = argv[++i];
+        else if (std::strcmp(argv[i], "--merge") == 0)
+            merge = true;
+        else if (std::strcmp(argv[i], "--no-bvh") == 0)
+            withBvh = false;
+        else if (std::strcmp(argv[i], "--no-paths") == 0)
+            withPaths = false;
+        else if (std::strcmp(argv[i], "--no-chunks") == 0)
+            withChunks = false;
+        else
+            ok = false;
+    }
+    if (!ok || params.width < 3 || params.height < 3 || params.tileSize < 2)
+    {
+        std::printf("usage: %s [--algo backtracker|wilson|rooms] [--size n | --width w --height h] [--seed s]\n"
+                    "       [--tile n] [--threads n] [--out file.txt|file.fmap] [--merge] [--no-bvh] [--no-paths] [--no-chunks]\n",
+                    argv[0]);
+        return 2;
+    }
+
+    JobSystem jobs(threads - 1);
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::string> grid = generateMaze(params, threads > 1 ? &jobs : nullptr);
+    double seconds = secondsSince(t0);
+    const double cells = (double)params.width * (double)params.height;
+    std::printf("%s %dx%d seed %u, %u threads, tile %d: %.1f ms, %.1f Mcells/s\n", mazeAlgorithmName(params.algorithm), params.width,
+                params.height, params.seed, threads, params.tileSize, seconds * 1e3, cells / seconds * 1e-6);
+
+    if (outPath.empty())
+        return 0;
+    t0 = std::chrono::steady_clock::now();
+    if (endsWith(outPath, ".fmap"))
+    {
+        Maze maze = buildMazeFromGrid(grid, 1.0f, 1.75f, merge, threads > 1 ? &jobs : nullptr);
+        Bvh bvh;
+        if (withBvh)
+            bvh = buildBvh(maze.walls);
+        PathGraph paths;
+        if (withPaths)
+            paths = buildPathGraph(maze, {}, threads > 1 ? &jobs : nullptr);
+        ok = writeMapFile(outPath, maze, merge, withBvh ? &bvh : nullptr, withPaths ? &paths : nullptr,
+                          withChunks ? ChunkStreamParams{}.chunkCells : 0);
+    }
+    else
+    {
+        std::ofstream file(outPath, std::ios::trunc);
+        for (const auto &row : grid)
+            file << row << '\n';
+        ok = (bool)file;
+    }
+    if (!ok)
+    {
+        std::printf("cannot write %s\n", outPath.c_str());
+        return 1;
+    }
+    std::printf("wrote %s in %.1f ms\n", outPath.c_str(), secondsSince(t0) * 1e3);
+    return 0;
+}